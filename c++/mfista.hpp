@@ -9,10 +9,12 @@
 #include <iostream>
 #include <vector>
 #include <complex>
+#include <functional>
 #include <Eigen/Core>
 #include <Eigen/Dense>
 
 #include <cstdlib>
+#include <cstddef>
 #include <cmath>
 
 #include <fftw3.h>
@@ -20,16 +22,66 @@
 #define MAXITER   50000
 #define MINITER   100
 #define FGPITER   100
+#define FGPCHECK  5
+#define FGPTOL    1.0e-4
+#define ANISOITER 100
+#define ANISOTOL  1.0e-6
+#define PDPOWITER 20
+#define PDLIPSAFE 1.05
+#define PDSIGMA   0.0625
+#define TSVITER   100
+#define TSVTOL    1.0e-6
+#define LBFGSM    10
+#define LBFGSTD   5
+#define LBFGSLS   30
+#define LBFGSARMIJO 1.0e-4
+#define NEWTONCG  50
+#define NEWTONCGTOL 0.1
+#define NEWTONLS  30
+#define NEWTONARMIJO 1.0e-4
+#define NEWTONWARM 1.0e4
+#define SCREENITER 10
+#define SCREENCOLTOL 1.0e-2
+#define SCREENACTIVE 0.5
+#define GAPITER   10
+#define CHI2TOL   1.0e-2
+#define DEADLINEITER 10
+#define CKPTSEC   300
 #define TD        50 
 #define ETA       1.1
 #define EPS       1.0e-5
 
-#define NU_SIGN -1
-// for high precision
-// #define MSP 12
+// smallest image (Nx*Ny) for each thread of the anisotropic TV prox
+#define TV_NN_PER_THREAD (128*128)
+
+// relative cost resolution of the single precision transforms
+#define FLOAT_NOISE 1.0e-6
+
+// stopping rule that ended the iterations (RESULT.stop_rule, -1 if not recorded)
+#define STOP_MAXITER 0
+#define STOP_COST    1
+#define STOP_ZERO    2
+#define STOP_GAP     3
+#define STOP_RESID   4
+#define STOP_CHI2    5
+#define STOP_DEADLINE 6
+
+// phases of the cumulative timers in RESULT.prof (compiled out with -DNO_PROF)
+#define PROF_SETUP   0
+#define PROF_FWD     1
+#define PROF_ADJ     2
+#define PROF_GRID    3
+#define PROF_PROX    4
+#define PROF_REG     5
+#define PROF_BT      6
+#define PROF_N       7
 
-// for low precision
+#define NU_SIGN -1
+// half width of the gridding kernel; 12 for high precision, 6 for low
+// precision. Build with -DMSP=12 to override (check with mfista_nufft_check).
+#ifndef MSP
 #define MSP 6
+#endif
 
 using namespace std;
 using namespace Eigen;
@@ -38,6 +90,18 @@ using namespace Eigen;
 extern "C" {
 #endif
 
+struct PROF{
+  double time[PROF_N];
+  long n_fwd;
+  long n_adj;
+  long n_trial;
+};
+
+// The fields up to Lip_const are the layout of the first version,
+// which the callers of mfista_imaging_core_fft and _nufft allocate;
+// those entry points write only RESULT_LEGACY bytes. The later fields
+// are filled through the _opt entry points.
+
 struct RESULT{
   int M;
   int N;
@@ -59,6 +123,37 @@ struct RESULT{
   double comp_time;
   double *residual;
   double Lip_const;
+  int ITER_float;
+  double lambda_t;
+  double tcost;
+  int tv_aniso;
+  int stop_rule;
+  struct PROF prof;
+  int M_raw;
+  int M_cell;
+};
+
+#define RESULT_LEGACY offsetof(struct RESULT, ITER_float)
+
+struct MFISTA_OPT{
+  int mixed;
+  int verbose;
+  int tv_aniso;
+  int primal_dual;
+  int tsv_prox;
+  int lbfgs;
+  int newton;
+  int screen;
+  double gap;
+  double chi2;
+  double deadline;
+  struct timespec t_start;
+  char *ckpt_fname;
+  double ckpt_sec;
+  int resume;
+  char *trace_fname;
+  void (*trace_func)(const char *line, void *arg);
+  void *trace_arg;
 };
 
 #ifdef __cplusplus
@@ -74,6 +169,102 @@ struct IO_FNAMES{
   char *out_fname;
 };
 
+// fftw interface for single and double precision
+
+template <typename T> struct FFTW_T;
+
+template <> struct FFTW_T<double>{
+  typedef fftw_complex cpx;
+  typedef fftw_plan    plan;
+  static void execute(plan p){ fftw_execute(p); }
+  static void execute_r2c(plan p, double *in, cpx *out){ fftw_execute_dft_r2c(p, in, out); }
+  static void execute_c2r(plan p, cpx *in, double *out){ fftw_execute_dft_c2r(p, in, out); }
+};
+
+template <> struct FFTW_T<float>{
+  typedef fftwf_complex cpx;
+  typedef fftwf_plan    plan;
+  static void execute(plan p){ fftwf_execute(p); }
+  static void execute_r2c(plan p, float *in, cpx *out){ fftwf_execute_dft_r2c(p, in, out); }
+  static void execute_c2r(plan p, cpx *in, float *out){ fftwf_execute_dft_c2r(p, in, out); }
+};
+
+// fftw buffers and plans of the 2Nx x 2Ny nufft grid. The plans can be
+// shared by several solves running at once; each solve needs its own
+// (fftw_malloc'ed) rvec and cvec.
+
+struct NUFFT_FFTW{
+  double *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_c2r;
+  fftw_plan fftwplan_r2c;
+};
+
+// dual variables of the TV prox kept across outer iterations
+
+struct FGP_DUAL{
+  VectorXd pmat;
+  VectorXd qmat;
+  VectorXd rmat;
+  VectorXd smat;
+  VectorXd npmat;
+  VectorXd nqmat;
+  int ncall;
+  long iter_sum;
+};
+
+// column dual and buffers of the anisotropic TV prox kept across outer iterations
+
+struct TV_ANISO{
+  VectorXd yvec;
+  VectorXd zvec;
+  VectorXd vvec;
+  VectorXd dvec;
+  VectorXd diff;
+  VectorXd norm;
+  double lambda;
+  int ncall;
+  long iter_sum;
+};
+
+// DCT plans, dual and buffers of the TSV prox kept across outer iterations
+
+struct TSV_DCT{
+  VectorXd yvec;
+  VectorXd zvec;
+  VectorXd vvec;
+  VectorXd eig;
+  double *rvec;
+  fftw_plan plan_dct;
+  fftw_plan plan_idct;
+  double lambda;
+  int ncall;
+  long iter_sum;
+};
+
+// solver state saved to a memory mapped file. Each field is a double
+// or int variable or a VectorXd registered by ckpt_add before ckpt_open.
+// The parameters of the run are given by ckpt_key and their hash is
+// kept in the header.
+
+struct CKPT_FIELD{
+  double *dptr;
+  int *iptr;
+  VectorXd *vptr;
+  long n;
+};
+
+struct MFISTA_CKPT{
+  vector<struct CKPT_FIELD> field;
+  string key;
+  long n;
+  size_t size;
+  int fd;
+  double *map;
+  double interval;
+  struct timespec t_last;
+};
+
 // mfista_io
 
 void init_result(struct IO_FNAMES *mfista_io,
@@ -86,6 +277,41 @@ void cout_result(char *fname,
 void write_result(ostream *ofs, char *fname, struct IO_FNAMES *mfista_io,
 		  struct RESULT *mfista_result);
 
+void read_fft_data(string fname, int *M, int *Nx, int *Ny,
+		   int **u_idx, int **v_idx,
+		   double **vis_r, double **vis_i, double **vis_std);
+
+void read_nufft_data(string fname, int *M, int *Nx, int *Ny,
+		     double **u_dx, double **v_dy,
+		     double **vis_r, double **vis_i, double **vis_std);
+
+// binary visibility file (mfista_vis_lib); u and v are int* for fft
+// data and double* for nufft data, map is NULL unless mapped
+
+#define VISNCOL 5
+
+struct VIS_DATA{
+  int fft;
+  int M;
+  int Nx;
+  int Ny;
+  void *u;
+  void *v;
+  double *vis_r;
+  double *vis_i;
+  double *vis_std;
+  void *map;
+  size_t size;
+};
+
+int vis_is_bin(string fname);
+
+void vis_map(string fname, struct VIS_DATA *vis);
+
+void vis_unmap(struct VIS_DATA *vis);
+
+int vis_write(string fname, struct VIS_DATA *vis);
+
 // soft thresholding
 
 double calc_Q_part(VectorXd &xvec1, VectorXd &xvec2,
@@ -98,12 +324,221 @@ void soft_threshold_box(VectorXd &nvec, VectorXd &vec, double eta,
 void soft_threshold_nonneg_box(VectorXd &nvec, VectorXd &vec, double eta,
 			       int box_flag, VectorXd &box);
 
+double dual_gap(VectorXd &xvec, VectorXd &mdfdx, double fval,
+		double F0, VectorXd &g0, double lambda_l1, int nonneg_flag,
+		int box_flag, VectorXd &box, double *scale, vector<int> *active);
+
+int gap_safe_screen(VectorXd &box, VectorXd &xvec, VectorXd &mdfdx,
+		    double fval, double F0, VectorXd &g0, double colnorm,
+		    double lambda_l1, int nonneg_flag, vector<int> *active);
+
 double TSV(int Nx, int Ny, VectorXd &xvec, VectorXd &buf_diff);
 
 void d_TSV(VectorXd &dvec, int Nx, int Ny, VectorXd &xvec);
 
+// the same restricted to the pixels not screened out
+
+void active_set(VectorXd &box, VectorXd &boxa, vector<int> &active);
+
+double calc_Q_part_active(VectorXd &xvec1, VectorXd &xvec2,
+			  double c, VectorXd &AyAz, vector<int> &active);
+
+void soft_threshold_active(VectorXd &nvec, VectorXd &vec, double eta,
+			   int nonneg_flag, VectorXd &box, vector<int> &active);
+
+double l1_active(VectorXd &xvec, vector<int> &active);
+
+double TSV_active(int Nx, int Ny, VectorXd &xvec, VectorXd &boxa,
+		  vector<int> &active);
+
+void d_TSV_active(VectorXd &dvec, int Nx, int Ny, VectorXd &xvec,
+		  vector<int> &active);
+
 void get_current_time(struct timespec *t);
 
+int past_deadline(struct MFISTA_OPT *mfista_opt);
+
+int opt_mfista_only(struct MFISTA_OPT *mfista_opt, const char *solver, int mixed);
+
+// per-phase timers and counters of the solver running in this thread
+
+extern thread_local struct PROF mfista_prof;
+
+void prof_reset(void);
+
+void prof_lap(int phase, struct timespec *t);
+
+#ifndef NO_PROF
+#define PROF_BEGIN(t)    struct timespec t; get_current_time(&t)
+#define PROF_LAP(k, t)   prof_lap(k, &t)
+#define PROF_COUNT(n)    (mfista_prof.n++)
+#else
+#define PROF_BEGIN(t)
+#define PROF_LAP(k, t)
+#define PROF_COUNT(n)
+#endif
+
+// TV
+
+double TV(int Nx, int Ny, VectorXd &xvec);
+
+void Lx(int Nx, int Ny, VectorXd &xvec, VectorXd &pmat, VectorXd &qmat);
+
+void Lpq(int Nx, int Ny, VectorXd &pmat, VectorXd &qmat, VectorXd &xvec);
+
+void P_pqiso(int Nx, int Ny, VectorXd &pmat, VectorXd &qmat,
+	     VectorXd &rmat, VectorXd &smat);
+
+void init_fgp_dual(int Nx, int Ny, struct FGP_DUAL *dual);
+
+int FGP_L1_box(VectorXd &xvec, VectorXd &bvec,
+	       double lambda_l1, double lambda_tv, int ITER,
+	       int Nx, int Ny, int nonneg_flag, int box_flag, VectorXd &box,
+	       struct FGP_DUAL *dual);
+
+double TV_aniso(int Nx, int Ny, VectorXd &xvec);
+
+void init_tv_aniso(int Nx, int Ny, struct TV_ANISO *aniso);
+
+int prox_TV_aniso(VectorXd &xvec, VectorXd &bvec,
+		  double lambda_l1, double lambda_tv, int ITER,
+		  int Nx, int Ny, int nonneg_flag, int box_flag, VectorXd &box,
+		  struct TV_ANISO *aniso);
+
+// TSV prox
+
+void init_tsv_dct(int Nx, int Ny, unsigned int fftw_plan_flag, struct TSV_DCT *dct);
+
+void free_tsv_dct(struct TSV_DCT *dct);
+
+int prox_TSV_L1_box(VectorXd &xvec, VectorXd &bvec,
+		    double lambda_l1, double lambda_tsv, int ITER,
+		    int nonneg_flag, int box_flag, VectorXd &box,
+		    struct TSV_DCT *dct);
+
+// checkpoint
+
+void ckpt_add(struct MFISTA_CKPT *ckpt, double *dptr);
+
+void ckpt_add(struct MFISTA_CKPT *ckpt, int *iptr);
+
+void ckpt_add(struct MFISTA_CKPT *ckpt, VectorXd &vec);
+
+void ckpt_key(struct MFISTA_CKPT *ckpt, double val);
+
+void ckpt_key(struct MFISTA_CKPT *ckpt, int val);
+
+void ckpt_key(struct MFISTA_CKPT *ckpt, const char *str);
+
+void ckpt_key(struct MFISTA_CKPT *ckpt, struct MFISTA_OPT *mfista_opt);
+
+int ckpt_open(struct MFISTA_CKPT *ckpt, char *fname, double interval, int resume);
+
+int ckpt_due(struct MFISTA_CKPT *ckpt);
+
+void ckpt_save(struct MFISTA_CKPT *ckpt);
+
+void ckpt_close(struct MFISTA_CKPT *ckpt);
+
+// trace of the iterations in JSON lines (a NULL trace does nothing)
+
+struct MFISTA_TRACE;
+
+struct MFISTA_TRACE *trace_open(struct MFISTA_OPT *mfista_opt, const char *solver, int iter);
+
+void trace_iter(struct MFISTA_TRACE *trace, int iter, double cost, double data,
+		double l1cost, const char *reg, double regcost, double c,
+		int trials, int restart);
+
+void trace_event(struct MFISTA_TRACE *trace, const char *event, int iter);
+
+void trace_close(struct MFISTA_TRACE *trace, int stop_rule, int iter);
+
+// primal-dual
+
+double est_Lip_pd(int NN, function<double(VectorXd&, VectorXd&)> F_dF);
+
+int L1_TV_primal_dual(VectorXd &xvec, int Nx, int Ny, int maxiter, double eps,
+		      double lambda_l1, double lambda_tv,
+		      int nonneg_flag, int box_flag, VectorXd &box,
+		      function<double(VectorXd&, VectorXd&)> F_dF,
+		      double *Lip, struct MFISTA_OPT *mfista_opt,
+		      struct RESULT *mfista_result);
+
+// L-BFGS for lambda_l1 = 0
+
+int TSV_lbfgs_box(VectorXd &xvec, int Nx, int Ny, int maxiter, double eps,
+		  double lambda_tsv, int nonneg_flag, int box_flag, VectorXd &box,
+		  function<double(VectorXd&, VectorXd&)> F_dF,
+		  function<void(VectorXd&)> precond,
+		  double c, struct MFISTA_OPT *mfista_opt,
+		  struct RESULT *mfista_result);
+
+// Newton polish of L1+TSV
+
+int L1_TSV_newton(VectorXd &xvec, int Nx, int Ny, int maxiter, double eps,
+		  double lambda_l1, double lambda_tsv,
+		  int nonneg_flag, int box_flag, VectorXd &box,
+		  function<double(VectorXd&, VectorXd&)> F_dF,
+		  double *cinit, int iter_start, struct MFISTA_OPT *mfista_opt,
+		  struct RESULT *mfista_result);
+
+// nufft
+
+int idx_fftw(int m, int Mr);
+
+int m2mr(int id, int N);
+
+void preNUFFT(VectorXd &u, VectorXd &v,
+	      VectorXd &E1, MatrixXd &E2x, MatrixXd &E2y,
+	      MatrixXd &E4mat, VectorXi &mx, VectorXi &my);
+
+// transform kernels, exported for mfista_bench (double) and
+// mfista_nufft_check (double and float)
+
+template <typename T>
+void NUFFT2d1(VectorXd &Xout,
+	      Matrix<T,Dynamic,1> &E1, Matrix<T,Dynamic,Dynamic> &E2x, Matrix<T,Dynamic,Dynamic> &E2y,
+	      Matrix<T,Dynamic,Dynamic> &E4mat, VectorXi &mx, VectorXi &my,
+	      typename FFTW_T<T>::cpx *in, T *out, typename FFTW_T<T>::plan *fftwplan_c2r,
+	      VectorXcd &Fin);
+
+template <typename T>
+void NUFFT2d2(VectorXcd &Fout, Matrix<T,Dynamic,1> &E1,
+	      Matrix<T,Dynamic,Dynamic> &E2x, Matrix<T,Dynamic,Dynamic> &E2y,
+	      Matrix<T,Dynamic,Dynamic> &E4mat, VectorXi &mx, VectorXi &my,
+	      T *in, typename FFTW_T<T>::cpx *out, typename FFTW_T<T>::plan *fftwplan_r2c,
+	      VectorXd &Xin);
+
+template <typename T>
+double calc_F_part_fft(int Nx, int Ny,
+		       Matrix<complex<T>,Dynamic,1> &vis_h, Matrix<T,Dynamic,1> &mask_h,
+		       typename FFTW_T<T>::plan *fftwplan, VectorXd &xvec,
+		       typename FFTW_T<T>::cpx *cvec, T *rvec);
+
+template <typename T>
+void dF_dx_fft(VectorXd &dfdx, int Nx, int Ny,
+	       typename FFTW_T<T>::cpx *yAx_fh, Matrix<T,Dynamic,1> &mask_h, VectorXd &xvec,
+	       typename FFTW_T<T>::plan *ifftwplan, T *rvec);
+
+int mfista_L1_TSV_core_nufft(double *xout,
+			     int M, int Nx, int Ny, double *u_dx, double *v_dy,
+			     int maxiter, double eps,
+			     double *vis_r, double *vis_i, double *vis_std,
+			     double lambda_l1, double lambda_tsv,
+			     double *cinit, double *xinit, 
+			     int nonneg_flag, int box_flag, float *cl_box,
+			     struct NUFFT_FFTW *nufft_fftw,
+			     struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result);
+
+void calc_result_nufft(struct RESULT *mfista_result,
+		       int M, int Nx, int Ny, double *u_dx, double *v_dy,
+		       double *vis_r, double *vis_i, double *vis_std,
+		       double lambda_l1, double lambda_tv, double lambda_tsv, 
+		       double *xvec, struct NUFFT_FFTW *nufft_fftw);
+
+void init_opt(struct MFISTA_OPT *mfista_opt);
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -118,8 +553,61 @@ void mfista_imaging_core_nufft(double *u_dx, double *v_dy,
 			       int nonneg_flag, int box_flag, float *cl_box,
 			       struct RESULT *mfista_result);
 
+void mfista_imaging_core_nufft_opt(double *u_dx, double *v_dy, 
+				   double *vis_r, double *vis_i, double *vis_std,
+				   int M, int Nx, int Ny, int maxiter, double eps,
+				   double lambda_l1, double lambda_tv, double lambda_tsv,
+				   double cinit, double *xinit, double *xout,
+				   int nonneg_flag, int box_flag, float *cl_box,
+				   struct MFISTA_OPT *mfista_opt,
+				   struct RESULT *mfista_result);
+
+// mfista_nufft_batch_lib
+
+void mfista_imaging_core_nufft_batch(double *u_dx, double *v_dy, int K,
+				     double *vis_r, double *vis_i, double *vis_std,
+				     int M, int Nx, int Ny, int maxiter, double eps,
+				     double lambda_l1, double lambda_tv, double lambda_tsv,
+				     double cinit, double *xinit, double *xout,
+				     int nonneg_flag, int box_flag, float *cl_box,
+				     struct MFISTA_OPT *mfista_opt,
+				     struct RESULT *mfista_result);
+
+// mfista_nufft_cube_lib
+
+void mfista_imaging_core_nufft_cube(int Nch, int *M, double **u_dx, double **v_dy,
+				    double **vis_r, double **vis_i, double **vis_std,
+				    int Nx, int Ny, int maxiter, double eps,
+				    double lambda_l1, double lambda_tv, double lambda_tsv,
+				    double cinit, double *xinit, double *xout,
+				    int nonneg_flag, int box_flag, float *cl_box,
+				    void (*write_channel)(int ch, double *x, struct RESULT *res, void *arg),
+				    void *write_arg,
+				    struct MFISTA_OPT *mfista_opt,
+				    struct RESULT *mfista_result);
+
+// mfista_nufft_movie_lib
+
+void mfista_imaging_core_nufft_movie(int Nt, int *M, double *t_frame,
+				     double *u_dx, double *v_dy,
+				     double *vis_r, double *vis_i, double *vis_std,
+				     int Nx, int Ny, int maxiter, double eps,
+				     double lambda_l1, double lambda_tv, double lambda_tsv,
+				     double lambda_t, double cinit, double *xinit, double *xout,
+				     int nonneg_flag, int box_flag, float *cl_box,
+				     struct RESULT *mfista_result);
+
 // mfista_fft_lib
 
+int merge_fft_data(int M, int Nx, int Ny,
+		   int *u_idx, int *v_idx, double *y_r, double *y_i, double *noise_stdev,
+		   int *u_out, int *v_out, double *y_r_out, double *y_i_out,
+		   double *noise_out);
+
+int grid_nufft_data(int M, int Nx, int Ny,
+		    double *u_dx, double *v_dy, double *vis_r, double *vis_i, double *vis_std,
+		    int *u_idx, int *v_idx, double *y_r, double *y_i, double *noise_stdev);
+
 void mfista_imaging_core_fft(int *u_idx, int *v_idx, 
 			     double *y_r, double *y_i, double *noise_stdev,
 			     int M, int Nx, int Ny, int maxiter, double eps,
@@ -129,6 +617,16 @@ void mfista_imaging_core_fft(int *u_idx, int *v_idx,
 			     int box_flag, float *cl_box,
 			     struct RESULT *mfista_result);
 
+void mfista_imaging_core_fft_opt(int *u_idx, int *v_idx, 
+				 double *y_r, double *y_i, double *noise_stdev,
+				 int M, int Nx, int Ny, int maxiter, double eps,
+				 double lambda_l1, double lambda_tv, double lambda_tsv,
+				 double cinit, double *xinit, double *xout,
+				 int nonneg_flag, unsigned int fftw_plan_flag,
+				 int box_flag, float *cl_box,
+				 struct MFISTA_OPT *mfista_opt,
+				 struct RESULT *mfista_result);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,127 @@
+#include "mfista.hpp"
+
+// mfista_TSV_lib
+//
+// Prox of TSV. TSV(x) = x'Lx, where L is the Laplacian with Neumann
+// boundaries, and L is diagonalized by the 2-D DCT-II with the
+// eigenvalues
+//
+//   4 sin^2(pi k/(2 Nx)) + 4 sin^2(pi l/(2 Ny)).
+//
+// Hence argmin |x-b|^2/2 + lambda_tsv TSV(x) = (I + 2 lambda_tsv L)^{-1} b
+// costs one REDFT10 and one REDFT01. With the l1 term, nonnegativity or
+// the CLEAN box, the two proxes are combined by the Dykstra-like
+// algorithm as in prox_TV_aniso,
+//
+//   y = prox_TSV(b - v)
+//   x = P(y + v),      v = y + v - x
+//
+// with v of the previous call (scaled to the new c) as the starting point.
+
+void init_tsv_dct(int Nx, int Ny, unsigned int fftw_plan_flag, struct TSV_DCT *dct)
+{
+  int i, j;
+
+  dct->yvec = VectorXd::Zero(Nx*Ny);
+  dct->zvec = VectorXd::Zero(Nx*Ny);
+  dct->vvec = VectorXd::Zero(Nx*Ny);
+  dct->eig  = VectorXd::Zero(Nx*Ny);
+
+  for(j = 0; j < Ny; ++j) for(i = 0; i < Nx; ++i)
+      dct->eig(Nx*j+i) = 4*pow(sin(M_PI*i/(2.0*Nx)),2.0) + 4*pow(sin(M_PI*j/(2.0*Ny)),2.0);
+
+  dct->rvec = (double*) fftw_malloc(Nx*Ny*sizeof(double));
+
+  // x(Nx*j+i) is row major with Ny rows of Nx
+
+  dct->plan_dct  = fftw_plan_r2r_2d(Ny, Nx, dct->rvec, dct->rvec,
+				    FFTW_REDFT10, FFTW_REDFT10, fftw_plan_flag);
+  dct->plan_idct = fftw_plan_r2r_2d(Ny, Nx, dct->rvec, dct->rvec,
+				    FFTW_REDFT01, FFTW_REDFT01, fftw_plan_flag);
+
+  dct->lambda   = 0;
+  dct->ncall    = 0;
+  dct->iter_sum = 0;
+}
+
+void free_tsv_dct(struct TSV_DCT *dct)
+{
+  fftw_destroy_plan(dct->plan_dct);
+  fftw_destroy_plan(dct->plan_idct);
+  fftw_free(dct->rvec);
+}
+
+// y = (I + 2 lambda_tsv L)^{-1} b
+
+static void solve_TSV_dct(VectorXd &yvec, VectorXd &bvec, double lambda_tsv,
+			  struct TSV_DCT *dct)
+{
+  int i, NN = (int)bvec.size();
+  double scale = 1/(4.0*NN);
+
+  for(i = 0; i < NN; ++i) dct->rvec[i] = bvec(i);
+
+  fftw_execute(dct->plan_dct);
+
+  for(i = 0; i < NN; ++i) dct->rvec[i] *= scale/(1 + 2*lambda_tsv*dct->eig(i));
+
+  fftw_execute(dct->plan_idct);
+
+  for(i = 0; i < NN; ++i) yvec(i) = dct->rvec[i];
+}
+
+// x = argmin |x-b|^2/2 + lambda_l1 |x|_1 + lambda_tsv TSV(x) (+ nonneg, box)
+//
+// Stops when |x - x_old| <= TSVTOL |x| or after ITER passes.
+// Returns the number of passes.
+
+int prox_TSV_L1_box(VectorXd &xvec, VectorXd &bvec,
+		    double lambda_l1, double lambda_tsv, int ITER,
+		    int nonneg_flag, int box_flag, VectorXd &box,
+		    struct TSV_DCT *dct)
+{
+  int iter;
+  double diff;
+  VectorXd &yvec = dct->yvec, &zvec = dct->zvec, &vvec = dct->vvec;
+
+  void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
+
+  if(nonneg_flag == 1) soft_th_box = soft_threshold_nonneg_box;
+  else                 soft_th_box = soft_threshold_box;
+
+  dct->ncall += 1;
+
+  // nothing to combine
+
+  if(lambda_l1 == 0 && nonneg_flag == 0 && box_flag == 0){
+    solve_TSV_dct(xvec, bvec, lambda_tsv, dct);
+    dct->iter_sum += 1;
+    return(1);
+  }
+
+  if(dct->lambda > 0) vvec *= lambda_tsv/dct->lambda;
+
+  dct->lambda = lambda_tsv;
+
+  for(iter = 0; iter < ITER; ++iter){
+
+    yvec = bvec - vvec;
+    solve_TSV_dct(yvec, yvec, lambda_tsv, dct);
+
+    vvec += yvec;
+    soft_th_box(xvec, vvec, lambda_l1, box_flag, box);
+    vvec -= xvec;
+
+    diff = (xvec - zvec).squaredNorm();
+    zvec = xvec;
+
+    if(diff <= TSVTOL*TSVTOL*xvec.squaredNorm()){
+      ++iter;
+      break;
+    }
+  }
+
+  dct->iter_sum += iter;
+
+  return(iter);
+}
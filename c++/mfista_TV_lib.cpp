@@ -0,0 +1,494 @@
+#include "mfista.hpp"
+
+#ifdef PTHREAD
+#include <thread>
+#endif
+
+// mfista_TV_lib
+//
+// Isotropic TV and its proximal operator by FGP (Beck and Teboulle 2009).
+// Pixels are stored as x(Nx*j + i); the dual variables are
+// p((Nx-1)*j + i) for x(i,j)-x(i+1,j) and q(Nx*j + i) for x(i,j)-x(i,j+1).
+
+double TV(int Nx, int Ny, VectorXd &xvec)
+{
+  int i, j;
+  double tv = 0, *x = xvec.data();
+
+  for(j = 0; j < Ny-1; ++j) for(i = 0; i < Nx-1; ++i)
+      tv += sqrt(pow((x[Nx*j+i]-x[Nx*j+i+1]),2.0)
+		 +pow((x[Nx*j+i]-x[Nx*(j+1)+i]),2.0));
+
+  for(i = 0; i < Nx-1; ++i)
+    tv += fabs(x[Nx*(Ny-1)+i] - x[Nx*(Ny-1)+i+1]);
+
+  for(j = 0; j < Ny-1; ++j)
+    tv += fabs(x[Nx*j+Nx-1] - x[Nx*(j+1)+Nx-1]);
+
+  return(tv);
+}
+
+void Lx(int Nx, int Ny, VectorXd &xvec, VectorXd &pmat, VectorXd &qmat)
+{
+  int i, j;
+  double *x = xvec.data(), *p = pmat.data(), *q = qmat.data();
+
+  for(j = 0; j < Ny; ++j) for(i = 0; i < Nx-1; ++i)
+      p[(Nx-1)*j+i] = x[Nx*j+i]-x[Nx*j+i+1];
+
+  for(j = 0; j < Ny-1; ++j) for(i = 0; i < Nx; ++i)
+      q[Nx*j+i] = x[Nx*j+i]-x[Nx*(j+1)+i];
+}
+
+void Lpq(int Nx, int Ny, VectorXd &pmat, VectorXd &qmat, VectorXd &xvec)
+{
+  int i, j;
+  double *x = xvec.data(), *p = pmat.data(), *q = qmat.data();
+
+  xvec.setZero();
+
+  for(j = 0; j < Ny; ++j) for(i = 0; i < Nx-1; ++i){
+      x[Nx*j+i]   += p[(Nx-1)*j+i];
+      x[Nx*j+i+1] -= p[(Nx-1)*j+i];
+    }
+
+  for(j = 0; j < Ny-1; ++j) for(i = 0; i < Nx; ++i){
+      x[Nx*j+i]     += q[Nx*j+i];
+      x[Nx*(j+1)+i] -= q[Nx*j+i];
+    }
+}
+
+void P_pqiso(int Nx, int Ny, VectorXd &pmat, VectorXd &qmat,
+	     VectorXd &rmat, VectorXd &smat)
+{
+  int i, j;
+  double tmp, *p = pmat.data(), *q = qmat.data(), *r = rmat.data(), *s = smat.data();
+
+  for(j = 0; j < Ny-1; ++j) for(i = 0; i < Nx-1; ++i){
+      tmp = sqrt(pow(p[(Nx-1)*j+i],2.0) + pow(q[Nx*j+i],2.0));
+
+      if(tmp<1) tmp = 1;
+
+      r[(Nx-1)*j+i] = p[(Nx-1)*j+i]/tmp;
+      s[Nx*j+i]     = q[Nx*j+i]/tmp;
+    }
+
+  for(i = 0; i < Nx-1; ++i){
+    tmp = fabs(p[(Nx-1)*(Ny-1)+i]);
+    if(tmp<1) tmp = 1;
+    r[(Nx-1)*(Ny-1)+i] = p[(Nx-1)*(Ny-1)+i]/tmp;
+  }
+
+  for(j = 0; j < Ny-1; ++j){
+    tmp = fabs(q[Nx*j+Nx-1]);
+    if(tmp<1) tmp = 1;
+    s[Nx*j+Nx-1] = q[Nx*j+Nx-1]/tmp;
+  }
+}
+
+void init_fgp_dual(int Nx, int Ny, struct FGP_DUAL *dual)
+{
+  dual->pmat  = VectorXd::Zero((Nx-1)*Ny);
+  dual->qmat  = VectorXd::Zero(Nx*(Ny-1));
+  dual->rmat  = VectorXd::Zero((Nx-1)*Ny);
+  dual->smat  = VectorXd::Zero(Nx*(Ny-1));
+  dual->npmat = VectorXd::Zero((Nx-1)*Ny);
+  dual->nqmat = VectorXd::Zero(Nx*(Ny-1));
+
+  dual->ncall    = 0;
+  dual->iter_sum = 0;
+}
+
+// x = argmin |x-b|^2/2 + lambda_l1 |x|_1 + lambda_tv TV(x) (+ nonneg, box)
+//
+// The dual (p,q) of the previous call is the starting point, so when b
+// moves little between outer MFISTA steps only a few iterations are
+// needed. Every FGPCHECK iterations the primal x(p,q) is formed and the
+// iteration stops when the duality gap
+//
+//   lambda_tv (TV(x) - <(p,q), Lx(x)>)
+//
+// is below FGPTOL lambda_tv TV(x). Returns the number of iterations.
+
+int FGP_L1_box(VectorXd &xvec, VectorXd &bvec,
+	       double lambda_l1, double lambda_tv, int ITER,
+	       int Nx, int Ny, int nonneg_flag, int box_flag, VectorXd &box,
+	       struct FGP_DUAL *dual)
+{
+  int iter;
+  double t = 1, tnew, beta, tv, gap;
+  VectorXd &pmat = dual->pmat, &qmat = dual->qmat,
+    &rmat = dual->rmat, &smat = dual->smat,
+    &npmat = dual->npmat, &nqmat = dual->nqmat;
+  VectorXd tmp;
+
+  void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
+
+  if(nonneg_flag == 1) soft_th_box = soft_threshold_nonneg_box;
+  else                 soft_th_box = soft_threshold_box;
+
+  rmat = pmat;
+  smat = qmat;
+
+  for(iter = 0; iter < ITER; ++iter){
+
+    // duality gap at the current dual (p,q)
+
+    if(iter % FGPCHECK == 0){
+      Lpq(Nx, Ny, pmat, qmat, xvec);
+      tmp = bvec - lambda_tv*xvec;
+      soft_th_box(xvec, tmp, lambda_l1, box_flag, box);
+
+      Lx(Nx, Ny, xvec, npmat, nqmat);
+      tv  = TV(Nx, Ny, xvec);
+      gap = tv - pmat.dot(npmat) - qmat.dot(nqmat);
+
+      if(gap <= FGPTOL*tv) break;
+    }
+
+    tnew = (1+sqrt(1+4*t*t))/2;
+
+    // P(b - lambda_tv L(r,s))
+
+    Lpq(Nx, Ny, rmat, smat, xvec);
+    tmp = bvec - lambda_tv*xvec;
+    soft_th_box(xvec, tmp, lambda_l1, box_flag, box);
+
+    // (p,q)new = P_pqiso((r,s) + Lx/(8 lambda_tv))
+
+    Lx(Nx, Ny, xvec, npmat, nqmat);
+
+    rmat += npmat/(8*lambda_tv);
+    smat += nqmat/(8*lambda_tv);
+
+    P_pqiso(Nx, Ny, rmat, smat, npmat, nqmat);
+
+    beta = (t-1)/tnew;
+
+    rmat = (1+beta)*npmat - beta*pmat;
+    smat = (1+beta)*nqmat - beta*qmat;
+
+    t = tnew;
+    pmat.swap(npmat);
+    qmat.swap(nqmat);
+  }
+
+  if(iter == ITER){
+    Lpq(Nx, Ny, pmat, qmat, xvec);
+    tmp = bvec - lambda_tv*xvec;
+    soft_th_box(xvec, tmp, lambda_l1, box_flag, box);
+  }
+
+  dual->ncall    += 1;
+  dual->iter_sum += iter;
+
+  return(iter);
+}
+
+// anisotropic TV
+//
+// TV_aniso(x) = sum |x(i,j)-x(i+1,j)| + |x(i,j)-x(i,j+1)| is the sum of
+// the 1-D TV of the rows and of the columns. The prox of each 1-D TV is
+// computed exactly by the taut string algorithm, and the two are
+// combined by the Dykstra-like proximal algorithm (Bauschke and
+// Combettes 2008)
+//
+//   y = prox_rows(b - v)
+//   x = prox_cols(y + v),    v = y + v - x
+//
+// which is block coordinate descent on the dual, so that it converges
+// from any v. v of the previous call (scaled to the new lambda_tv) is
+// the starting point. The l1 term and nonnegativity commute with the
+// prox of TV and are applied to the result.
+//
+// The CLEAN box does not commute with it, so with the box it is a third
+// block of the parallel Dykstra-like algorithm (Combettes and Pesquet
+// 2011, Proximal splitting methods in signal processing, Alg. 10.31)
+//
+//   p1 = prox_rows,3lambda(b + d1),  p2 = prox_cols,3lambda(b + d2),
+//   p3 = P_box(b + d3),  x = (p1 + p2 + p3)/3,  d_k = d_k + x - p_k
+//
+// with d1 + d2 + d3 = 0, kept across calls like v.
+
+double TV_aniso(int Nx, int Ny, VectorXd &xvec)
+{
+  int i, j;
+  double tv = 0, *x = xvec.data();
+
+  for(j = 0; j < Ny; ++j) for(i = 0; i < Nx-1; ++i)
+      tv += fabs(x[Nx*j+i] - x[Nx*j+i+1]);
+
+  for(j = 0; j < Ny-1; ++j) for(i = 0; i < Nx; ++i)
+      tv += fabs(x[Nx*j+i] - x[Nx*(j+1)+i]);
+
+  return(tv);
+}
+
+// argmin_x |x-y|^2/2 + lambda sum_k |x(k+1)-x(k)| in O(n)
+// (Condat 2013, IEEE Signal Processing Letters 20, 1054)
+
+static void TV1D_denoise(const double *y, double *x, int n, double lambda)
+{
+  int k = 0, k0 = 0, kplus = 0, kminus = 0;
+  double umin = lambda, umax = -lambda,
+    vmin = y[0]-lambda, vmax = y[0]+lambda;
+
+  if(n < 1) return;
+
+  for(;;){
+    while(k == n-1){
+      if(umin < 0){
+	do x[k0++] = vmin; while(k0 <= kminus);
+	k = kminus = k0;
+	vmin = y[k];
+	umin = lambda;
+	umax = vmin + umin - vmax;
+      }
+      else if(umax > 0){
+	do x[k0++] = vmax; while(k0 <= kplus);
+	k = kplus = k0;
+	vmax = y[k];
+	umax = -lambda;
+	umin = vmax + umax - vmin;
+      }
+      else{
+	vmin += umin/(k-k0+1);
+	do x[k0++] = vmin; while(k0 <= k);
+	return;
+      }
+    }
+
+    if((umin += y[k+1]-vmin) < -lambda){
+      do x[k0++] = vmin; while(k0 <= kminus);
+      k = kplus = kminus = k0;
+      vmin = y[k];
+      vmax = vmin + 2*lambda;
+      umin = lambda;
+      umax = -lambda;
+    }
+    else if((umax += y[k+1]-vmax) > lambda){
+      do x[k0++] = vmax; while(k0 <= kplus);
+      k = kplus = kminus = k0;
+      vmax = y[k];
+      vmin = vmax - 2*lambda;
+      umin = lambda;
+      umax = -lambda;
+    }
+    else{
+      k++;
+      if(umin >= lambda){
+	kminus = k;
+	vmin += (umin-lambda)/(kminus-k0+1);
+	umin = lambda;
+      }
+      if(umax <= -lambda){
+	kplus = k;
+	vmax += (umax+lambda)/(kplus-k0+1);
+	umax = -lambda;
+      }
+    }
+  }
+}
+
+// run func(l_s, l_e) over the lines 0 <= l < n split into bands
+
+template <typename F>
+static void for_each_band(int n, int NN, F func)
+{
+#ifdef PTHREAD
+  int w, n_thread = NN/TV_NN_PER_THREAD;
+  vector<thread> workers;
+
+  if(n_thread > THREAD_NUM) n_thread = THREAD_NUM;
+  if(n_thread > n)          n_thread = n;
+
+  if(n_thread > 1){
+    for(w = 0; w < n_thread; w++)
+      workers.push_back(thread(func, (n*w)/n_thread, (n*(w+1))/n_thread));
+
+    for(w = 0; w < n_thread; w++) workers[w].join();
+
+    return;
+  }
+#endif
+  func(0, n);
+}
+
+void init_tv_aniso(int Nx, int Ny, struct TV_ANISO *aniso)
+{
+  aniso->yvec = VectorXd::Zero(Nx*Ny);
+  aniso->zvec = VectorXd::Zero(Nx*Ny);
+  aniso->vvec = VectorXd::Zero(Nx*Ny);
+  aniso->dvec = VectorXd::Zero(0);
+  aniso->diff = VectorXd::Zero(Nx);
+  aniso->norm = VectorXd::Zero(Nx);
+
+  aniso->lambda   = 0;
+  aniso->ncall    = 0;
+  aniso->iter_sum = 0;
+}
+
+// the prox of TV_aniso with the CLEAN box, by the three block iteration
+// above; the result is in aniso->zvec
+
+static int prox_TV_aniso_box(VectorXd &bvec, double lambda_tv, int ITER,
+			     int Nx, int Ny, VectorXd &box, struct TV_ANISO *aniso)
+{
+  int iter, NN = Nx*Ny;
+  double *b = bvec.data(), *z = aniso->zvec.data(), *y = aniso->yvec.data(),
+    *bx = box.data(), *diff = aniso->diff.data(), *norm = aniso->norm.data(), *d1, *d2, *d3;
+
+  if(aniso->dvec.size() != 3*NN) aniso->dvec = VectorXd::Zero(3*NN);
+
+  d1 = aniso->dvec.data();
+  d2 = d1 + NN;
+  d3 = d2 + NN;
+
+  // d1 and d2 are dual variables of the TV blocks
+
+  if(aniso->lambda > 0){
+    aniso->dvec.head(2*NN) *= lambda_tv/aniso->lambda;
+    aniso->dvec.tail(NN) = -aniso->dvec.head(NN) - aniso->dvec.segment(NN, NN);
+  }
+
+  aniso->lambda = lambda_tv;
+
+  for(iter = 0; iter < ITER; ++iter){
+
+    // rows
+
+    for_each_band(Ny, NN, [&](int j_s, int j_e){
+	vector<double> tmp(Nx);
+
+	for(int j = j_s; j < j_e; ++j){
+	  for(int i = 0; i < Nx; ++i) tmp[i] = b[Nx*j+i] + d1[Nx*j+i];
+
+	  TV1D_denoise(tmp.data(), y+Nx*j, Nx, 3*lambda_tv);
+	}
+      });
+
+    // columns, box and the average
+
+    for_each_band(Nx, NN, [&](int i_s, int i_e){
+	vector<double> tmp(Ny), out(Ny);
+	double p3, x;
+
+	for(int i = i_s; i < i_e; ++i){
+	  for(int j = 0; j < Ny; ++j) tmp[j] = b[Nx*j+i] + d2[Nx*j+i];
+
+	  TV1D_denoise(tmp.data(), out.data(), Ny, 3*lambda_tv);
+
+	  diff[i] = 0;
+	  norm[i] = 0;
+
+	  for(int j = 0; j < Ny; ++j){
+	    int k = Nx*j+i;
+
+	    p3 = (bx[k] == 0) ? 0 : b[k] + d3[k];
+	    x  = (y[k] + out[j] + p3)/3;
+
+	    d1[k] += x - y[k];
+	    d2[k] += x - out[j];
+	    d3[k] += x - p3;
+
+	    diff[i] += pow(x - z[k], 2.0);
+	    norm[i] += pow(x, 2.0);
+
+	    z[k] = x;
+	  }
+	}
+      });
+
+    if(aniso->diff.sum() <= ANISOTOL*ANISOTOL*aniso->norm.sum()){
+      ++iter;
+      break;
+    }
+  }
+
+  return(iter);
+}
+
+// x = argmin |x-b|^2/2 + lambda_l1 |x|_1 + lambda_tv TV_aniso(x) (+ nonneg, box)
+//
+// Stops when |x - x_old| <= ANISOTOL |x| or after ITER passes.
+// Returns the number of passes.
+
+int prox_TV_aniso(VectorXd &xvec, VectorXd &bvec,
+		  double lambda_l1, double lambda_tv, int ITER,
+		  int Nx, int Ny, int nonneg_flag, int box_flag, VectorXd &box,
+		  struct TV_ANISO *aniso)
+{
+  int iter, NN = Nx*Ny;
+  double *b = bvec.data(), *z = aniso->zvec.data(), *y = aniso->yvec.data(),
+    *v = aniso->vvec.data(), *diff = aniso->diff.data(), *norm = aniso->norm.data();
+
+  void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
+
+  if(nonneg_flag == 1) soft_th_box = soft_threshold_nonneg_box;
+  else                 soft_th_box = soft_threshold_box;
+
+  if(box_flag == 1){
+    iter = prox_TV_aniso_box(bvec, lambda_tv, ITER, Nx, Ny, box, aniso);
+
+    soft_th_box(xvec, aniso->zvec, lambda_l1, box_flag, box);
+
+    aniso->ncall    += 1;
+    aniso->iter_sum += iter;
+
+    return(iter);
+  }
+
+  if(aniso->lambda > 0) aniso->vvec *= lambda_tv/aniso->lambda;
+
+  aniso->lambda = lambda_tv;
+
+  for(iter = 0; iter < ITER; ++iter){
+
+    // rows
+
+    for_each_band(Ny, NN, [&](int j_s, int j_e){
+	vector<double> tmp(Nx);
+
+	for(int j = j_s; j < j_e; ++j){
+	  for(int i = 0; i < Nx; ++i) tmp[i] = b[Nx*j+i] - v[Nx*j+i];
+
+	  TV1D_denoise(tmp.data(), y+Nx*j, Nx, lambda_tv);
+	}
+      });
+
+    // columns
+
+    for_each_band(Nx, NN, [&](int i_s, int i_e){
+	vector<double> tmp(Ny), out(Ny);
+
+	for(int i = i_s; i < i_e; ++i){
+	  for(int j = 0; j < Ny; ++j) tmp[j] = y[Nx*j+i] + v[Nx*j+i];
+
+	  TV1D_denoise(tmp.data(), out.data(), Ny, lambda_tv);
+
+	  diff[i] = 0;
+	  norm[i] = 0;
+
+	  for(int j = 0; j < Ny; ++j){
+	    diff[i] += pow(out[j] - z[Nx*j+i], 2.0);
+	    norm[i] += pow(out[j], 2.0);
+
+	    v[Nx*j+i] = tmp[j] - out[j];
+	    z[Nx*j+i] = out[j];
+	  }
+	}
+      });
+
+    if(aniso->diff.sum() <= ANISOTOL*ANISOTOL*aniso->norm.sum()){
+      ++iter;
+      break;
+    }
+  }
+
+  soft_th_box(xvec, aniso->zvec, lambda_l1, box_flag, box);
+
+  aniso->ncall    += 1;
+  aniso->iter_sum += iter;
+
+  return(iter);
+}
@@ -0,0 +1,526 @@
+#include "mfista.hpp"
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <ctime>
+
+// Benchmarks of the imaging kernels and of full solves.
+//
+// The micro-benchmarks time one call of each kernel on random data,
+// swept over the image size, the number of visibilities and the number
+// of fftw threads. The macro-benchmarks run MFISTA for a fixed number
+// of iterations (eps = 0) on the bundled data and on synthetic data
+// scaled up from them. All results go to one JSON file; files written
+// by two commits can be compared entry by entry.
+
+// minimum time spent on one micro-benchmark
+#define BENCHSEC  0.2
+#define QUICKSEC  0.05
+
+// iterations of the macro-benchmarks
+#define BENCHITER 200
+#define QUICKITER 20
+
+// initial c of the macro-benchmarks, above the Lipschitz constants of the
+// data so that the backtracking (also limited by maxiter) always succeeds
+#define FFTC      1.0e5
+#define NUFFTC    1.0e10
+
+void usage(char *s)
+{
+  cerr << s
+       << " {-quick} {-json fname} {-tag label} {-fft fft_data} {-nufft nufft_data}"
+       << "\n\n";
+
+  cerr << " Options." << "\n\n";
+
+  cerr << "  {-quick}:            small sweep and short solves." << endl;
+  cerr << "  {-json fname}:       result file (default mfista_bench.json)." << endl;
+  cerr << "  {-tag label}:        label of the run, e.g. the commit." << endl;
+  cerr << "  {-fft fft_data}:     FFT data for the macro-benchmarks." << endl;
+  cerr << "  {-nufft nufft_data}: NUFFT data for the macro-benchmarks." << "\n\n";
+
+  cerr << " The defaults of the data are ../c/fft_data.txt and ../c/nufft_data.txt." << endl;
+  cerr << " The macro-benchmark of a data file that cannot be opened is skipped." << "\n\n";
+
+  exit(1);
+}
+
+static double elapsed(struct timespec *t0)
+{
+  struct timespec t1;
+
+  get_current_time(&t1);
+
+  return((double)(t1.tv_sec - t0->tv_sec) + 1.0e-9*(double)(t1.tv_nsec - t0->tv_nsec));
+}
+
+// seconds per call of func, repeated until min_sec has passed
+
+static double time_call(function<void()> func, double min_sec, long *reps)
+{
+  struct timespec t0;
+  double sec;
+  long n = 0;
+
+  func();
+
+  get_current_time(&t0);
+  do{
+    func();
+    n++;
+  } while((sec = elapsed(&t0)) < min_sec);
+
+  *reps = n;
+  return(sec/n);
+}
+
+static int set_threads(int n_thread)
+{
+#ifdef PTHREAD
+  fftw_plan_with_nthreads(n_thread);
+  return(n_thread);
+#else
+  return(1);
+#endif
+}
+
+struct BENCH_OUT{
+  ostream *ofs;
+  int n;
+};
+
+static void json_micro(struct BENCH_OUT *out, const char *kernel,
+		       int Nx, int Ny, int M, int n_thread, double sec, long reps)
+{
+  *out->ofs << ((out->n++ == 0) ? "\n" : ",\n")
+	    << "    {\"kernel\": \"" << kernel << "\", \"Nx\": " << Nx << ", \"Ny\": " << Ny
+	    << ", \"M\": " << M << ", \"threads\": " << n_thread
+	    << ", \"sec\": " << sec << ", \"reps\": " << reps << "}";
+
+  cout << kernel << " " << Nx << "x" << Ny << " M = " << M
+       << " threads = " << n_thread << ": " << sec << " sec" << endl;
+}
+
+static void json_macro(struct BENCH_OUT *out, const char *name, const char *solver,
+		       int M, struct RESULT *res)
+{
+  int k;
+
+  *out->ofs << ((out->n++ == 0) ? "\n" : ",\n")
+	    << "    {\"data\": \"" << name << "\", \"solver\": \"" << solver
+	    << "\", \"M\": " << M << ", \"Nx\": " << res->NX << ", \"Ny\": " << res->NY
+	    << ", \"iter\": " << res->ITER << ", \"sec\": " << res->comp_time
+	    << ", \"sec_per_iter\": " << res->comp_time/(res->ITER > 0 ? res->ITER : 1)
+	    << ", \"cost\": " << res->finalcost
+	    << ", \"n_fwd\": " << res->prof.n_fwd << ", \"n_adj\": " << res->prof.n_adj
+	    << ", \"n_trial\": " << res->prof.n_trial << ", \"phase_sec\": [";
+
+  for(k = 0; k < PROF_N; k++)
+    *out->ofs << ((k == 0) ? "" : ", ") << res->prof.time[k];
+
+  *out->ofs << "]}";
+
+  cout << name << " " << solver << ": " << res->ITER << " iterations, "
+       << res->comp_time << " sec" << endl;
+}
+
+// micro-benchmarks
+
+static void bench_nufft(struct BENCH_OUT *out, int Nx, int Ny, int M, int n_thread,
+			double min_sec, mt19937_64 &gen)
+{
+  int i, NN = Nx*Ny, MMh = 2*Nx*(Ny+1);
+  long reps;
+  double sec, *rvec;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_c2r, fftwplan_r2c;
+  uniform_real_distribution<double> uni(-1, 1);
+  VectorXi mx, my;
+  VectorXd E1, u, v, xvec, xout;
+  VectorXcd vis, yAx;
+  MatrixXd E2x, E2y, E4mat;
+
+  u = VectorXd::Zero(M);
+  v = VectorXd::Zero(M);
+  vis = VectorXcd::Zero(M);
+
+  for(i = 0; i < M; i++){
+    u(i) = uni(gen);
+    v(i) = uni(gen);
+    vis(i) = complex<double>(uni(gen), uni(gen));
+  }
+
+  xvec = VectorXd::Zero(NN);
+  for(i = 0; i < NN; i++) xvec(i) = uni(gen);
+
+  mx    = VectorXi::Zero(M);
+  my    = VectorXi::Zero(M);
+  E1    = VectorXd::Zero(M);
+  E2x   = MatrixXd::Zero(M,2*MSP);
+  E2y   = MatrixXd::Zero(M,2*MSP);
+  E4mat = MatrixXd::Zero(Nx,Ny);
+  xout  = VectorXd::Zero(NN);
+
+  sec = time_call([&]{preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);}, min_sec, &reps);
+  if(n_thread == 1) json_micro(out, "preNUFFT", Nx, Ny, M, 1, sec, reps);
+
+  rvec = (double*) fftw_malloc(4*NN*sizeof(double));
+  cvec = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
+
+  set_threads(n_thread);
+  fftwplan_c2r = fftw_plan_dft_c2r_2d(2*Nx, 2*Ny, cvec, rvec, fftw_plan_flag);
+  fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx, 2*Ny, rvec, cvec, fftw_plan_flag);
+
+  sec = time_call([&]{NUFFT2d2(yAx, E1, E2x, E2y, E4mat, mx, my,
+			       rvec, cvec, &fftwplan_r2c, xvec);}, min_sec, &reps);
+  json_micro(out, "NUFFT2d2", Nx, Ny, M, n_thread, sec, reps);
+
+  sec = time_call([&]{NUFFT2d1(xout, E1, E2x, E2y, E4mat, mx, my,
+			       cvec, rvec, &fftwplan_c2r, vis);}, min_sec, &reps);
+  json_micro(out, "NUFFT2d1", Nx, Ny, M, n_thread, sec, reps);
+
+  fftw_destroy_plan(fftwplan_c2r);
+  fftw_destroy_plan(fftwplan_r2c);
+  fftw_free(rvec);
+  fftw_free(cvec);
+}
+
+static void bench_fft(struct BENCH_OUT *out, int Nx, int Ny, int n_thread,
+		      double min_sec, mt19937_64 &gen)
+{
+  int i, NN = Nx*Ny, Ny_h = Ny/2+1;
+  long reps;
+  double sec, *rvec;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+  fftw_complex *cvec;
+  fftw_plan fftwplan, ifftwplan;
+  uniform_real_distribution<double> uni(-1, 1);
+  VectorXd xvec, dfdx, mask_h;
+  VectorXcd vis_h;
+
+  xvec   = VectorXd::Zero(NN);
+  dfdx   = VectorXd::Zero(NN);
+  mask_h = VectorXd::Zero(Nx*Ny_h);
+  vis_h  = VectorXcd::Zero(Nx*Ny_h);
+
+  for(i = 0; i < NN; i++) xvec(i) = uni(gen);
+  for(i = 0; i < Nx*Ny_h; i++){
+    mask_h(i) = (uni(gen) > 0.6) ? 1 : 0;
+    vis_h(i)  = mask_h(i)*complex<double>(uni(gen), uni(gen));
+  }
+
+  rvec = (double*) fftw_malloc(NN*sizeof(double));
+  cvec = (fftw_complex*) fftw_malloc(Nx*Ny_h*sizeof(fftw_complex));
+
+  set_threads(n_thread);
+  fftwplan  = fftw_plan_dft_r2c_2d(Nx, Ny, rvec, cvec, fftw_plan_flag);
+  ifftwplan = fftw_plan_dft_c2r_2d(Nx, Ny, cvec, rvec, fftw_plan_flag);
+
+  sec = time_call([&]{calc_F_part_fft(Nx, Ny, vis_h, mask_h, &fftwplan,
+				      xvec, cvec, rvec);}, min_sec, &reps);
+  json_micro(out, "calc_F_part_fft", Nx, Ny, 0, n_thread, sec, reps);
+
+  // dF_dx_fft works on the residual left in cvec by calc_F_part_fft
+
+  sec = time_call([&]{calc_F_part_fft(Nx, Ny, vis_h, mask_h, &fftwplan,
+				      xvec, cvec, rvec);
+      dF_dx_fft(dfdx, Nx, Ny, cvec, mask_h, xvec, &ifftwplan, rvec);}, min_sec, &reps);
+  json_micro(out, "calc_F_part_fft+dF_dx_fft", Nx, Ny, 0, n_thread, sec, reps);
+
+  fftw_destroy_plan(fftwplan);
+  fftw_destroy_plan(ifftwplan);
+  fftw_free(rvec);
+  fftw_free(cvec);
+}
+
+static void bench_reg(struct BENCH_OUT *out, int Nx, int Ny, double min_sec, mt19937_64 &gen)
+{
+  int i, NN = Nx*Ny;
+  long reps;
+  double sec;
+  uniform_real_distribution<double> uni(-1, 1);
+  VectorXd xvec, xnew, dvec, box, buf_diff;
+  struct FGP_DUAL fgp_dual;
+  struct TV_ANISO tv_aniso;
+
+  xvec = VectorXd::Zero(NN);
+  xnew = VectorXd::Zero(NN);
+  dvec = VectorXd::Zero(NN);
+  box  = VectorXd::Ones(NN);
+  buf_diff = VectorXd::Zero(Nx-1);
+
+  for(i = 0; i < NN; i++) xvec(i) = uni(gen);
+
+  sec = time_call([&]{TSV(Nx, Ny, xvec, buf_diff);}, min_sec, &reps);
+  json_micro(out, "TSV", Nx, Ny, 0, 1, sec, reps);
+
+  sec = time_call([&]{d_TSV(dvec, Nx, Ny, xvec);}, min_sec, &reps);
+  json_micro(out, "d_TSV", Nx, Ny, 0, 1, sec, reps);
+
+  sec = time_call([&]{soft_threshold_box(xnew, xvec, 0.5, 0, box);}, min_sec, &reps);
+  json_micro(out, "soft_threshold_box", Nx, Ny, 0, 1, sec, reps);
+
+  sec = time_call([&]{soft_threshold_nonneg_box(xnew, xvec, 0.5, 1, box);}, min_sec, &reps);
+  json_micro(out, "soft_threshold_nonneg_box", Nx, Ny, 0, 1, sec, reps);
+
+  // the duals start from 0 in every call to time the full FGPITER / ANISOITER passes
+
+  sec = time_call([&]{init_fgp_dual(Nx, Ny, &fgp_dual);
+      FGP_L1_box(xnew, xvec, 0.1, 0.1, FGPITER, Nx, Ny, 0, 0, box, &fgp_dual);},
+    min_sec, &reps);
+  json_micro(out, "FGP_L1_box", Nx, Ny, 0, 1, sec, reps);
+
+  sec = time_call([&]{init_tv_aniso(Nx, Ny, &tv_aniso);
+      prox_TV_aniso(xnew, xvec, 0.1, 0.1, ANISOITER, Nx, Ny, 0, 0, box, &tv_aniso);},
+    min_sec, &reps);
+  json_micro(out, "prox_TV_aniso", Nx, Ny, 0, 1, sec, reps);
+}
+
+// synthetic data: scale copies of the uv points of the bundled data,
+// scattered by a small jitter, observing three point sources with noise
+
+static void synth_nufft(int M, int scale, double *u, double *v, double *vis_std,
+			int Nx, int Ny, double **su, double **sv,
+			double **s_r, double **s_i, double **s_std)
+{
+  int i, k, s, n;
+  double phase, x_s[3], y_s[3], f_s[3] = {1.0, 0.5, 0.25};
+  mt19937_64 gen(M);
+  normal_distribution<double> jitter(0, 0.01), noise(0, 1);
+
+  for(s = 0; s < 3; s++){
+    x_s[s] = (s - 1)*Nx/8.0;
+    y_s[s] = (1 - s)*Ny/16.0;
+  }
+
+  *su    = new double[M*scale];
+  *sv    = new double[M*scale];
+  *s_r   = new double[M*scale];
+  *s_i   = new double[M*scale];
+  *s_std = new double[M*scale];
+
+  for(k = 0; k < scale; k++)
+    for(i = 0; i < M; i++){
+      n = k*M + i;
+
+      (*su)[n]    = u[i] + ((k > 0) ? jitter(gen) : 0);
+      (*sv)[n]    = v[i] + ((k > 0) ? jitter(gen) : 0);
+      (*s_std)[n] = vis_std[i];
+      (*s_r)[n]   = noise(gen)*vis_std[i];
+      (*s_i)[n]   = noise(gen)*vis_std[i];
+
+      for(s = 0; s < 3; s++){
+	phase = NU_SIGN*((*su)[n]*x_s[s] + (*sv)[n]*y_s[s]);
+	(*s_r)[n] += f_s[s]*cos(phase);
+	(*s_i)[n] += f_s[s]*sin(phase);
+      }
+    }
+}
+
+// the FFT data on a 2Nx x 2Ny grid (same pixel size, twice the field):
+// each uv cell k goes to 2k and is copied to its 3 finer neighbours
+
+static void scale_fft(int M, int *u_idx, int *v_idx, double *vis_r, double *vis_i,
+		      double *vis_std, int Nx, int Ny,
+		      int **su, int **sv, double **s_r, double **s_i, double **s_std)
+{
+  int i, d, ku, kv, n = 0, du[4] = {0, 1, 0, 1}, dv[4] = {0, 0, 1, 1};
+
+  *su    = new int[4*M];
+  *sv    = new int[4*M];
+  *s_r   = new double[4*M];
+  *s_i   = new double[4*M];
+  *s_std = new double[4*M];
+
+  for(i = 0; i < M; i++){
+    ku = (u_idx[i] < Nx/2) ? u_idx[i] : u_idx[i] - Nx;
+    kv = (v_idx[i] < Ny/2) ? v_idx[i] : v_idx[i] - Ny;
+
+    for(d = 0; d < 4; d++, n++){
+      (*su)[n]    = (2*ku + du[d] + 2*Nx) % (2*Nx);
+      (*sv)[n]    = (2*kv + dv[d] + 2*Ny) % (2*Ny);
+      (*s_r)[n]   = vis_r[i];
+      (*s_i)[n]   = vis_i[i];
+      (*s_std)[n] = vis_std[i];
+    }
+  }
+}
+
+// macro-benchmarks
+
+static void macro_nufft(struct BENCH_OUT *out, const char *name, int M, int Nx, int Ny,
+			double *u, double *v, double *vis_r, double *vis_i, double *vis_std,
+			int maxiter, int tv)
+{
+  int i;
+  double *xinit, *xout;
+  struct RESULT res;
+  struct MFISTA_OPT opt;
+  struct IO_FNAMES io;
+  streambuf *cout_buf = cout.rdbuf();
+  ostringstream sink;
+
+  xinit = new double[Nx*Ny];
+  xout  = new double[Nx*Ny];
+  for(i = 0; i < Nx*Ny; i++) xinit[i] = 0;
+
+  init_result(&io, &res);
+  init_opt(&opt);
+
+  cout.rdbuf(sink.rdbuf());
+  mfista_imaging_core_nufft_opt(u, v, vis_r, vis_i, vis_std, M, Nx, Ny, maxiter, 0,
+				1, (tv ? 1 : 0), (tv ? 0 : 10), NUFFTC, xinit, xout,
+				0, 0, NULL, &opt, &res);
+  cout.rdbuf(cout_buf);
+
+  json_macro(out, name, tv ? "L1_TV_nufft" : "L1_TSV_nufft", M, &res);
+
+  delete [] xinit;
+  delete [] xout;
+}
+
+static void macro_fft(struct BENCH_OUT *out, const char *name, int M, int Nx, int Ny,
+		      int *u_idx, int *v_idx, double *vis_r, double *vis_i, double *vis_std,
+		      int maxiter, int tv)
+{
+  int i;
+  double *xinit, *xout;
+  struct RESULT res;
+  struct MFISTA_OPT opt;
+  struct IO_FNAMES io;
+  streambuf *cout_buf = cout.rdbuf();
+  ostringstream sink;
+
+  xinit = new double[Nx*Ny];
+  xout  = new double[Nx*Ny];
+  for(i = 0; i < Nx*Ny; i++) xinit[i] = 0;
+
+  init_result(&io, &res);
+  init_opt(&opt);
+
+  cout.rdbuf(sink.rdbuf());
+  mfista_imaging_core_fft_opt(u_idx, v_idx, vis_r, vis_i, vis_std, M, Nx, Ny, maxiter, 0,
+			      1, (tv ? 1 : 0), (tv ? 0 : 10), FFTC, xinit, xout,
+			      0, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, 0, NULL, &opt, &res);
+  cout.rdbuf(cout_buf);
+
+  json_macro(out, name, tv ? "L1_TV_fft" : "L1_TSV_fft", M, &res);
+
+  delete [] xinit;
+  delete [] xout;
+}
+
+int main(int argc, char *argv[]){
+
+  string json_fname = "mfista_bench.json", tag = "", fft_fname = "../c/fft_data.txt",
+    nufft_fname = "../c/nufft_data.txt";
+  int i, quick = 0, maxiter, M, Nx, Ny, *u_idx, *v_idx, *su_idx, *sv_idx,
+    n_thread, max_thread = 1, scale;
+  double min_sec, *u, *v, *vis_r, *vis_i, *vis_std, *su, *sv, *s_r, *s_i, *s_std;
+  char stamp[64];
+  time_t now = time(NULL);
+  mt19937_64 gen(1);
+  struct BENCH_OUT out;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i],"-quick") == 0)
+      quick = 1;
+    else if(strcmp(argv[i],"-json") == 0 && i+1 < argc)
+      json_fname = argv[++i];
+    else if(strcmp(argv[i],"-tag") == 0 && i+1 < argc)
+      tag = argv[++i];
+    else if(strcmp(argv[i],"-fft") == 0 && i+1 < argc)
+      fft_fname = argv[++i];
+    else if(strcmp(argv[i],"-nufft") == 0 && i+1 < argc)
+      nufft_fname = argv[++i];
+    else
+      usage(argv[0]);
+  }
+
+  vector<int> sizes  = quick ? vector<int>{64, 128} : vector<int>{64, 128, 256, 512};
+  vector<int> n_vis  = quick ? vector<int>{10000} : vector<int>{10000, 100000, 1000000};
+
+  scale   = quick ? 4 : 32;
+  min_sec = quick ? QUICKSEC : BENCHSEC;
+  maxiter = quick ? QUICKITER : BENCHITER;
+
+#ifdef PTHREAD
+  max_thread = THREAD_NUM;
+  if(fftw_init_threads() == 0)
+    cout << "Could not initialize multi threads for fftw3." << endl;
+#endif
+
+  ofstream json_fs(json_fname.data(), ios::out);
+  if(json_fs.fail()){
+    cerr << "Cannot open \"" << json_fname << ".\"\n";
+    exit(0);
+  }
+
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+  json_fs << "{\n  \"tag\": \"" << tag << "\", \"date\": \"" << stamp
+	  << "\", \"quick\": " << quick << ", \"max_threads\": " << max_thread
+	  << ", \"MSP\": " << MSP << ",\n  \"micro\": [";
+
+  out.ofs = &json_fs;
+  out.n   = 0;
+
+  // micro-benchmarks
+
+  for(int N : sizes){
+    for(n_thread = 1; n_thread <= max_thread; n_thread *= 2){
+      bench_fft(&out, N, N, n_thread, min_sec, gen);
+      for(int m : n_vis) bench_nufft(&out, N, N, m, n_thread, min_sec, gen);
+    }
+    bench_reg(&out, N, N, min_sec, gen);
+  }
+
+  json_fs << "\n  ],\n  \"macro\": [";
+  out.n = 0;
+
+  // macro-benchmarks
+
+  ifstream nufft_fs(nufft_fname.data());
+  if(!nufft_fs.fail()){
+    nufft_fs.close();
+    read_nufft_data(nufft_fname, &M, &Nx, &Ny, &u, &v, &vis_r, &vis_i, &vis_std);
+
+    macro_nufft(&out, "nufft_data", M, Nx, Ny, u, v, vis_r, vis_i, vis_std, maxiter, 0);
+    macro_nufft(&out, "nufft_data", M, Nx, Ny, u, v, vis_r, vis_i, vis_std, maxiter, 1);
+
+    synth_nufft(M, scale, u, v, vis_std, Nx, Ny, &su, &sv, &s_r, &s_i, &s_std);
+    macro_nufft(&out, "nufft_data_scaled", M*scale, Nx, Ny,
+		su, sv, s_r, s_i, s_std, maxiter, 0);
+
+    delete [] u; delete [] v; delete [] vis_r; delete [] vis_i; delete [] vis_std;
+    delete [] su; delete [] sv; delete [] s_r; delete [] s_i; delete [] s_std;
+  }
+  else
+    cout << "skip the macro-benchmarks of " << nufft_fname << "." << endl;
+
+  ifstream fft_fs(fft_fname.data());
+  if(!fft_fs.fail()){
+    fft_fs.close();
+    read_fft_data(fft_fname, &M, &Nx, &Ny, &u_idx, &v_idx, &vis_r, &vis_i, &vis_std);
+
+    macro_fft(&out, "fft_data", M, Nx, Ny, u_idx, v_idx, vis_r, vis_i, vis_std, maxiter, 0);
+    macro_fft(&out, "fft_data", M, Nx, Ny, u_idx, v_idx, vis_r, vis_i, vis_std, maxiter, 1);
+
+    scale_fft(M, u_idx, v_idx, vis_r, vis_i, vis_std, Nx, Ny,
+	      &su_idx, &sv_idx, &s_r, &s_i, &s_std);
+    macro_fft(&out, "fft_data_scaled", 4*M, 2*Nx, 2*Ny,
+	      su_idx, sv_idx, s_r, s_i, s_std, maxiter, 0);
+
+    delete [] u_idx; delete [] v_idx; delete [] vis_r; delete [] vis_i; delete [] vis_std;
+    delete [] su_idx; delete [] sv_idx; delete [] s_r; delete [] s_i; delete [] s_std;
+  }
+  else
+    cout << "skip the macro-benchmarks of " << fft_fname << "." << endl;
+
+  json_fs << "\n  ]\n}\n";
+  json_fs.close();
+
+  cout << "results are written to \"" << json_fname << ".\"" << endl;
+}
@@ -0,0 +1,211 @@
+#include "mfista.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+// mfista_ckpt_lib
+//
+// Checkpoint of the solver state in a memory mapped file of doubles,
+//
+//   header (CKPTHEAD): magic, version, n, slot, number of saves, key
+//   slot 0 (n):        fields in the order of ckpt_add
+//   slot 1 (n):        same
+//
+// A save fills the slot not named in the header and then switches the
+// header to it, so a run killed during a save leaves the previous state
+// readable. The state is copied as it is, and a resumed run continues
+// bit by bit as the uninterrupted one (with the same FFTW plans).
+//
+// key is the 64 bit FNV-1a hash of the values given by ckpt_key (the
+// solver, lambdas, eps, number of data and options), stored bit by bit
+// in a double. A file with another key is not loaded, since its state
+// belongs to another problem even when the number of fields matches.
+
+#define CKPTMAGIC 20240601
+#define CKPTVER   2
+#define CKPTHEAD  8
+#define CKPTKEY   5
+
+void ckpt_add(struct MFISTA_CKPT *ckpt, double *dptr)
+{
+  ckpt->field.push_back({dptr, NULL, NULL, 1});
+}
+
+void ckpt_add(struct MFISTA_CKPT *ckpt, int *iptr)
+{
+  ckpt->field.push_back({NULL, iptr, NULL, 1});
+}
+
+void ckpt_add(struct MFISTA_CKPT *ckpt, VectorXd &vec)
+{
+  ckpt->field.push_back({NULL, NULL, &vec, (long)vec.size()});
+}
+
+void ckpt_key(struct MFISTA_CKPT *ckpt, double val)
+{
+  ckpt->key.append((const char*)&val, sizeof(double));
+}
+
+void ckpt_key(struct MFISTA_CKPT *ckpt, int val)
+{
+  ckpt->key.append((const char*)&val, sizeof(int));
+}
+
+void ckpt_key(struct MFISTA_CKPT *ckpt, const char *str)
+{
+  ckpt->key.append(str, strlen(str)+1);
+}
+
+// the options that change the iterations
+
+void ckpt_key(struct MFISTA_CKPT *ckpt, struct MFISTA_OPT *mfista_opt)
+{
+  ckpt_key(ckpt, mfista_opt->mixed);
+  ckpt_key(ckpt, mfista_opt->tv_aniso);
+  ckpt_key(ckpt, mfista_opt->tsv_prox);
+  ckpt_key(ckpt, mfista_opt->screen);
+  ckpt_key(ckpt, mfista_opt->gap);
+  ckpt_key(ckpt, mfista_opt->chi2);
+}
+
+static double ckpt_hash(struct MFISTA_CKPT *ckpt)
+{
+  unsigned long h = 14695981039346656037UL;
+  double d;
+
+  for(unsigned char b : ckpt->key){
+    h ^= b;
+    h *= 1099511628211UL;
+  }
+
+  memcpy(&d, &h, sizeof(double));
+
+  return(d);
+}
+
+static void ckpt_copy(struct MFISTA_CKPT *ckpt, double *slot, int save)
+{
+  for(auto &f : ckpt->field){
+    if(f.dptr != NULL){
+      if(save) *slot = *f.dptr; else *f.dptr = *slot;
+    }
+    else if(f.iptr != NULL){
+      if(save) *slot = (double)*f.iptr; else *f.iptr = (int)*slot;
+    }
+    else{
+      if(save) memcpy(slot, f.vptr->data(), f.n*sizeof(double));
+      else     memcpy(f.vptr->data(), slot, f.n*sizeof(double));
+    }
+    slot += f.n;
+  }
+}
+
+// Maps fname. With resume, the fields are loaded from the last saved
+// slot if the file matches them. Returns 1 if the state was loaded,
+// 0 if not, and -1 if the file cannot be used.
+
+int ckpt_open(struct MFISTA_CKPT *ckpt, char *fname, double interval, int resume)
+{
+  int loaded = 0;
+  double key;
+  struct stat st;
+
+  ckpt->n = 0;
+  for(auto &f : ckpt->field) ckpt->n += f.n;
+
+  ckpt->size     = (CKPTHEAD + 2*ckpt->n)*sizeof(double);
+  ckpt->interval = interval;
+  ckpt->map      = NULL;
+
+  key = ckpt_hash(ckpt);
+
+  ckpt->fd = open(fname, O_RDWR | O_CREAT, 0644);
+  if(ckpt->fd < 0 || fstat(ckpt->fd, &st) != 0){
+    cout << "cannot open checkpoint file " << fname << "." << endl;
+    return(-1);
+  }
+
+  if((size_t)st.st_size != ckpt->size && ftruncate(ckpt->fd, ckpt->size) != 0){
+    cout << "cannot resize checkpoint file " << fname << "." << endl;
+    close(ckpt->fd);
+    return(-1);
+  }
+
+  ckpt->map = (double*) mmap(NULL, ckpt->size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED, ckpt->fd, 0);
+  if(ckpt->map == MAP_FAILED){
+    cout << "cannot map checkpoint file " << fname << "." << endl;
+    ckpt->map = NULL;
+    close(ckpt->fd);
+    return(-1);
+  }
+
+  if(resume == 1){
+    if(ckpt->map[0] == CKPTMAGIC && ckpt->map[1] == CKPTVER &&
+       ckpt->map[2] == (double)ckpt->n && ckpt->map[4] > 0 &&
+       memcmp(ckpt->map + CKPTKEY, &key, sizeof(double)) == 0){
+      ckpt_copy(ckpt, ckpt->map + CKPTHEAD + (long)ckpt->map[3]*ckpt->n, 0);
+      loaded = 1;
+      cout << "resumed from " << fname << "." << endl;
+    }
+    else
+      cout << fname << " does not match this run; starting from the beginning." << endl;
+  }
+
+  if(loaded == 0){
+    ckpt->map[0] = CKPTMAGIC;
+    ckpt->map[1] = CKPTVER;
+    ckpt->map[2] = (double)ckpt->n;
+    ckpt->map[3] = 1;
+    ckpt->map[4] = 0;
+    memcpy(ckpt->map + CKPTKEY, &key, sizeof(double));
+  }
+
+  get_current_time(&ckpt->t_last);
+
+  return(loaded);
+}
+
+// 1 if interval seconds have passed since the last save
+
+int ckpt_due(struct MFISTA_CKPT *ckpt)
+{
+  struct timespec t_now;
+
+  if(ckpt->map == NULL) return(0);
+
+  get_current_time(&t_now);
+
+  return((double)(t_now.tv_sec - ckpt->t_last.tv_sec)
+	 + 1.0e-9*(double)(t_now.tv_nsec - ckpt->t_last.tv_nsec)
+	 >= ckpt->interval);
+}
+
+void ckpt_save(struct MFISTA_CKPT *ckpt)
+{
+  int slot;
+
+  if(ckpt->map == NULL) return;
+
+  slot = 1 - (int)ckpt->map[3];
+
+  ckpt_copy(ckpt, ckpt->map + CKPTHEAD + slot*ckpt->n, 1);
+  msync(ckpt->map, ckpt->size, MS_SYNC);
+
+  ckpt->map[3]  = slot;
+  ckpt->map[4] += 1;
+  msync(ckpt->map, CKPTHEAD*sizeof(double), MS_SYNC);
+
+  get_current_time(&ckpt->t_last);
+}
+
+void ckpt_close(struct MFISTA_CKPT *ckpt)
+{
+  if(ckpt->map != NULL){
+    munmap(ckpt->map, ckpt->size);
+    close(ckpt->fd);
+    ckpt->map = NULL;
+  }
+}
@@ -0,0 +1,117 @@
+#include "mfista.hpp"
+#include <fstream>
+
+// Converts the text visibility files (fft_data.txt, nufft_data.txt)
+// to the binary file of mfista_vis_lib, and back.
+
+void usage(char *s)
+{
+  cerr << s << " <in fname> <out fname>" << "\n\n";
+
+  cerr << "  <in fname>:          fft_data or nufft_data, text or binary." << endl;
+  cerr << "  <out fname>:         the same data in the other format." << "\n\n";
+
+  cerr << " A text file is written to a binary file and a binary file to a" << endl;
+  cerr << " text file. FFT or NUFFT data is told from the column line of the" << endl;
+  cerr << " text header. The text written from a binary file keeps all digits." << "\n\n";
+
+  exit(1);
+}
+
+// 1 if the column line of the text header is that of fft_data
+
+static int text_is_fft(string fname)
+{
+  int i;
+  string buf_str;
+  ifstream fs(fname.data());
+
+  if(fs.fail()){
+    cerr << "Cannot open \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  for(i = 0; i < 5; i++) getline(fs, buf_str);
+
+  return(buf_str.compare(0, 5, "u, v,") == 0);
+}
+
+static void write_text(string fname, struct VIS_DATA *vis)
+{
+  int i;
+  FILE *fp;
+
+  fp = fopen(fname.data(), "w");
+  if(fp == NULL){
+    cerr << "Cannot open \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  fprintf(fp, "M  = %d\nNX = %d\nNY = %d\n\n", vis->M, vis->Nx, vis->Ny);
+
+  if(vis->fft){
+    fprintf(fp, "u, v, y_r, y_i, noise_std_dev\n\n");
+    for(i = 0; i < vis->M; i++)
+      fprintf(fp, "%d, %d, %.17e, %.17e, %.17e\n",
+	      ((int*)vis->u)[i], ((int*)vis->v)[i],
+	      vis->vis_r[i], vis->vis_i[i], vis->vis_std[i]);
+  }
+  else{
+    fprintf(fp, "u_rad, v_rad, vis_r, vis_i, noise_std_dev\n\n");
+    for(i = 0; i < vis->M; i++)
+      fprintf(fp, "%.17e, %.17e, %.17e, %.17e, %.17e\n",
+	      ((double*)vis->u)[i], ((double*)vis->v)[i],
+	      vis->vis_r[i], vis->vis_i[i], vis->vis_std[i]);
+  }
+
+  fclose(fp);
+}
+
+int main(int argc, char *argv[]){
+
+  int *u_idx, *v_idx;
+  double *u_dx, *v_dy;
+  struct VIS_DATA vis;
+
+  if(argc != 3) usage(argv[0]);
+
+  if(vis_is_bin(argv[1])){
+    vis_map(argv[1], &vis);
+    write_text(argv[2], &vis);
+    vis_unmap(&vis);
+  }
+  else{
+    vis.fft = text_is_fft(argv[1]);
+    vis.map = NULL;
+
+    if(vis.fft){
+      read_fft_data(argv[1], &vis.M, &vis.Nx, &vis.Ny, &u_idx, &v_idx,
+		    &vis.vis_r, &vis.vis_i, &vis.vis_std);
+      vis.u = u_idx;
+      vis.v = v_idx;
+    }
+    else{
+      read_nufft_data(argv[1], &vis.M, &vis.Nx, &vis.Ny, &u_dx, &v_dy,
+		      &vis.vis_r, &vis.vis_i, &vis.vis_std);
+      vis.u = u_dx;
+      vis.v = v_dy;
+    }
+
+    if(vis_write(argv[2], &vis) != 0) exit(1);
+
+    if(vis.fft){
+      delete [] u_idx;
+      delete [] v_idx;
+    }
+    else{
+      delete [] u_dx;
+      delete [] v_dy;
+    }
+    delete [] vis.vis_r;
+    delete [] vis.vis_i;
+    delete [] vis.vis_std;
+  }
+
+  cout << vis.M << " visibilities of " << (vis.fft ? "FFT" : "NUFFT")
+       << " data written to \"" << argv[2] << ".\"" << endl;
+}
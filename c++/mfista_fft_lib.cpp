@@ -1,7 +1,9 @@
 #include "mfista.hpp"
 #include <iomanip>
+#include <cstring>
 
-double fft_half_squareNorm(int Nx, int Ny, fftw_complex *FT_h)
+template <typename C>
+double fft_half_squareNorm(int Nx, int Ny, C *FT_h)
 {
   int i, j, Nx_h, Ny_h;
   double sqsum = 0;
@@ -76,10 +78,123 @@ void idx2mat(int M, int Nx, int Ny,
   }
 }
 
-void calc_yAx_fft(int Nx, int Ny, VectorXcd &y_fft_h, VectorXd &mask_h, fftw_complex *cvec)
+/* Sorts the samples by cell Ny*u_idx + v_idx (counting sort, so the
+   samples of a cell keep their order) and merges the samples of each
+   cell into their inverse-variance weighted mean with noise
+   1/sqrt(sum 1/sigma^2). A cell with one sample is copied as it is.
+   Samples outside the Nx x Ny grid are dropped. The out arrays have
+   length M; returns the number of cells written to them. */
+
+int merge_fft_data(int M, int Nx, int Ny,
+		   int *u_idx, int *v_idx, double *y_r, double *y_i, double *noise_stdev,
+		   int *u_out, int *v_out, double *y_r_out, double *y_i_out,
+		   double *noise_out)
+{
+  int i, k, n, cell, NN = Nx*Ny, n_drop = 0;
+  double w, sum_w, sum_r, sum_i;
+  vector<int> first(NN+1, 0), order(M);
+
+  for(i = 0; i < M; i++){
+    if(u_idx[i] < 0 || u_idx[i] >= Nx || v_idx[i] < 0 || v_idx[i] >= Ny) n_drop++;
+    else first[Ny*u_idx[i] + v_idx[i] + 1]++;
+  }
+
+  for(cell = 0; cell < NN; cell++) first[cell+1] += first[cell];
+
+  for(i = 0; i < M; i++)
+    if(u_idx[i] >= 0 && u_idx[i] < Nx && v_idx[i] >= 0 && v_idx[i] < Ny)
+      order[first[Ny*u_idx[i] + v_idx[i]]++] = i;
+
+  /* first[cell] is now the end of the cell */
+
+  for(n = 0, k = 0, cell = 0; cell < NN; cell++){
+    if(k == first[cell]) continue;
+
+    i = order[k];
+
+    u_out[n] = u_idx[i];
+    v_out[n] = v_idx[i];
+
+    if(first[cell] - k == 1){
+      y_r_out[n]   = y_r[i];
+      y_i_out[n]   = y_i[i];
+      noise_out[n] = noise_stdev[i];
+    }
+    else{
+      for(sum_w = 0, sum_r = 0, sum_i = 0; k < first[cell]; k++){
+	i = order[k];
+	w = 1/(noise_stdev[i]*noise_stdev[i]);
+	sum_w += w;
+	sum_r += w*y_r[i];
+	sum_i += w*y_i[i];
+      }
+      y_r_out[n]   = sum_r/sum_w;
+      y_i_out[n]   = sum_i/sum_w;
+      noise_out[n] = 1/sqrt(sum_w);
+    }
+
+    k = first[cell];
+    n++;
+  }
+
+  if(n_drop > 0)
+    cout << n_drop << " visibilities outside the " << Nx << " x " << Ny
+	 << " grid are dropped." << endl;
+
+  return(n);
+}
+
+/* Snaps visibilities at (u_dx, v_dy) in rad/pixel (nufft_data) to the
+   cells of the FFT engine and merges them with merge_fft_data. The cell
+   of u is k = round(-u Nx/(2 pi)) mod Nx (and l of v), where the FFT
+   engine puts the image center at (Nx/2, Ny/2) and scales by
+   1/sqrt(Nx Ny), so the visibility becomes (-1)^(k+l) vis/sqrt(Nx Ny)
+   with noise sigma/sqrt(Nx Ny). Each visibility is also put at the
+   mirrored cell as its conjugate. The shift to the cell center is
+   du = u + 2 pi k/Nx, dv = v + 2 pi l/Ny; a source r pixels off the
+   center gets a phase error of about r |(du, dv)|. The out arrays have
+   length 2M; returns the number of cells. */
+
+int grid_nufft_data(int M, int Nx, int Ny,
+		    double *u_dx, double *v_dy, double *vis_r, double *vis_i, double *vis_std,
+		    int *u_idx, int *v_idx, double *y_r, double *y_i, double *noise_stdev)
+{
+  int i, k, l, sign;
+  double sqNN = sqrt((double)(Nx*Ny));
+  vector<int> u_all(2*M), v_all(2*M);
+  vector<double> r_all(2*M), i_all(2*M), s_all(2*M);
+
+  for(i = 0; i < M; i++){
+    k = (int)lround(-u_dx[i]*Nx/(2*M_PI));
+    l = (int)lround(-v_dy[i]*Ny/(2*M_PI));
+
+    sign = ((k + l) % 2 == 0) ? 1 : -1;
+
+    u_all[2*i]   = ((k % Nx) + Nx) % Nx;
+    v_all[2*i]   = ((l % Ny) + Ny) % Ny;
+    u_all[2*i+1] = (Nx - u_all[2*i]) % Nx;
+    v_all[2*i+1] = (Ny - v_all[2*i]) % Ny;
+
+    r_all[2*i]   =  sign*vis_r[i]/sqNN;
+    i_all[2*i]   =  sign*vis_i[i]/sqNN;
+    r_all[2*i+1] =  r_all[2*i];
+    i_all[2*i+1] = -i_all[2*i];
+
+    s_all[2*i]   = vis_std[i]/sqNN;
+    s_all[2*i+1] = s_all[2*i];
+  }
+
+  return(merge_fft_data(2*M, Nx, Ny, u_all.data(), v_all.data(),
+			r_all.data(), i_all.data(), s_all.data(),
+			u_idx, v_idx, y_r, y_i, noise_stdev));
+}
+
+template <typename T>
+void calc_yAx_fft(int Nx, int Ny, Matrix<complex<T>,Dynamic,1> &y_fft_h,
+		  Matrix<T,Dynamic,1> &mask_h, typename FFTW_T<T>::cpx *cvec)
 {
   int i, Ny_h;
-  double sqrtNN;
+  T sqrtNN;
 
   /* set parameters */
 
@@ -94,26 +209,38 @@ void calc_yAx_fft(int Nx, int Ny, VectorXcd &y_fft_h, VectorXd &mask_h, fftw_com
   }
 }
 
+template <typename T>
 double calc_F_part_fft(int Nx, int Ny,
-		       VectorXcd &vis_h, VectorXd &mask_h,
-		       fftw_plan *fftwplan, VectorXd &xvec,
-		       fftw_complex *cvec, double *rvec)
+		       Matrix<complex<T>,Dynamic,1> &vis_h, Matrix<T,Dynamic,1> &mask_h,
+		       typename FFTW_T<T>::plan *fftwplan, VectorXd &xvec,
+		       typename FFTW_T<T>::cpx *cvec, T *rvec)
 {
   int i, NN = Nx* Ny;
+  double Fval;
+
+  PROF_BEGIN(t_prof);
 
   for(i = 0; i < NN; i++) rvec[i] = xvec(i);
 
-  fftw_execute(*fftwplan);
+  FFTW_T<T>::execute(*fftwplan);
   calc_yAx_fft(Nx, Ny, vis_h, mask_h, cvec);
-  return(fft_half_squareNorm(Nx, Ny, cvec)/4);
+  Fval = fft_half_squareNorm(Nx, Ny, cvec)/4;
+
+  PROF_LAP(PROF_FWD, t_prof);
+  PROF_COUNT(n_fwd);
+
+  return(Fval);
 }
 
+template <typename T>
 void dF_dx_fft(VectorXd &dfdx, int Nx, int Ny,
-	       fftw_complex *yAx_fh, VectorXd &mask_h, VectorXd &xvec, 
-	       fftw_plan *ifftwplan, double *rvec)
+	       typename FFTW_T<T>::cpx *yAx_fh, Matrix<T,Dynamic,1> &mask_h, VectorXd &xvec, 
+	       typename FFTW_T<T>::plan *ifftwplan, T *rvec)
 {
   int i, Ny_h, NN = Nx*Ny;
-  double sqNN = sqrt((double)(Nx*Ny));
+  T sqNN = sqrt((T)(Nx*Ny));
+
+  PROF_BEGIN(t_prof);
 
   Ny_h = (int)floor(((double)Ny)/2) + 1;
   
@@ -122,11 +249,20 @@ void dF_dx_fft(VectorXd &dfdx, int Nx, int Ny,
     yAx_fh[i][1] *= (mask_h(i)/(2*sqNN));
   }
 
-  fftw_execute(*ifftwplan);
+  FFTW_T<T>::execute(*ifftwplan);
 
   for(i = 0; i < NN; i++) dfdx(i) = rvec[i];
+
+  PROF_LAP(PROF_ADJ, t_prof);
+  PROF_COUNT(n_adj);
 }
 
+template double calc_F_part_fft<double>(int, int, VectorXcd &, VectorXd &, fftw_plan *,
+					VectorXd &, fftw_complex *, double *);
+
+template void dF_dx_fft<double>(VectorXd &, int, int, fftw_complex *, VectorXd &, VectorXd &,
+				fftw_plan *, double *);
+
 /* TSV */
 
 int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
@@ -134,35 +270,63 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
 			   double lambda_l1, double lambda_tsv,
 			   double *cinit, double *xinit, double *xout,
 			   int nonneg_flag, unsigned int fftw_plan_flag,
-			   int box_flag, float *cl_box)
+			   int box_flag, float *cl_box,
+			   struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
 {
   void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
-  int NN = Nx*Ny, i, iter, Ny_h;
+  int NN = Nx*Ny, i, iter, Ny_h, single = mfista_opt->mixed, iter_switch = 0, to_double,
+    tsv_prox = (mfista_opt->tsv_prox == 1 && lambda_tsv > 0),
+    screen = (mfista_opt->screen == 1 && lambda_l1 > 0 && !tsv_prox), n_screen = 0, n_new,
+    use_active = 0, rebuild = 0,
+    gap_stop = (mfista_opt->gap > 0 && lambda_l1 > 0 && !tsv_prox),
+    res_stop = (mfista_opt->gap > 0 && !gap_stop),
+    chi2_stop = (mfista_opt->chi2 > 0), stop = STOP_MAXITER,
+    iter_start = 0, ckpt_on = (mfista_opt->ckpt_fname != NULL);
   double *rvec, 
-    Qcore, Fval, Qval, c, tmpa, tmpb, l1cost, tsvcost, costtmp,
-    mu=1, munew;
+    Qcore, Fval = 0, Qval, c, tmpa, tmpb, l1cost, tsvcost = 0, costtmp,
+    mu=1, munew, F0 = 0, colnorm = 0, gap, resid = 0, Fdata = 0, chi2, Mdata = 0;
+  float *rvec_f = NULL;
   fftw_complex *cvec;
+  fftwf_complex *cvec_f = NULL;
   fftw_plan fftwplan, ifftwplan;
+  fftwf_plan fftwplan_f = NULL, ifftwplan_f = NULL;
 
-  VectorXd cost, xtmp, xnew, zvec, dfdx, dtmp, xvec, box, mask_h, buf_diff;
+  struct MFISTA_CKPT ckpt;
+  struct MFISTA_TRACE *trace;
+  VectorXd cost, chi2v, xtmp, xnew, zvec, dfdx, dtmp, xvec, box, box0, boxa, g0, mask_h, buf_diff;
   VectorXcd yAx_h, vis_h;
+  VectorXf  mask_hf;
+  VectorXcf vis_hf;
+  struct TSV_DCT tsv_dct;
+  vector<int> active;
 
   /* set parameters */
 
+  PROF_BEGIN(t_setup);
+
   Ny_h = ((int)floor(((double)Ny)/2)+1);
 
   cout << "computing image with MFISTA." << endl;
-  cout << "stop if iter = " << maxiter << ", or Delta_cost < " << eps << endl;
+  if(gap_stop)
+    cout << "stop if iter = " << maxiter << ", or duality gap < " << mfista_opt->gap << " cost" << endl;
+  else if(res_stop)
+    cout << "stop if iter = " << maxiter << ", or |x - z| < " << mfista_opt->gap << " |x|" << endl;
+  else
+    cout << "stop if iter = " << maxiter << ", or Delta_cost < " << eps << endl;
 
   /* allocate variables */
 
   cost   = VectorXd::Zero(maxiter);
+  chi2v  = VectorXd::Zero(maxiter);
   dfdx   = VectorXd::Zero(NN);
   xnew   = VectorXd::Zero(NN);
   xtmp   = VectorXd::Zero(NN);
   dtmp   = VectorXd::Zero(NN);
   box    = VectorXd::Zero(NN);
 
+  if(box_flag == 1)
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+
   vis_h   = VectorXcd::Zero(Nx*Ny_h);
 
   buf_diff = VectorXd::Zero(Nx-1);
@@ -182,6 +346,10 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
   full2half(Nx, Ny, mask, mask_h);
   fft_full2half(Nx, Ny, vis, vis_h);
 
+  // number of data for the Mean SE
+
+  for(i = 0; i < NN; i++) if(mask[i] > 0) Mdata += 1;
+
 #ifdef PTHREAD
   int omp_num = THREAD_NUM;
   cout << "Run mfista with " << omp_num << " threads." << endl;
@@ -193,6 +361,57 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
   fftwplan  = fftw_plan_dft_r2c_2d( Nx, Ny, rvec, cvec, fftw_plan_flag);
   ifftwplan = fftw_plan_dft_c2r_2d( Nx, Ny, cvec, rvec, fftw_plan_flag);
 
+  /* single precision transforms for the first phase */
+
+  if(single == 1){
+    cout << "Iterate in single precision until Delta_cost reaches float accuracy." << endl;
+
+#ifdef PTHREAD
+    if(fftwf_init_threads()==0)
+      cout << "Could not initialize multi threads for fftw3f." << endl;
+#endif
+
+    rvec_f = (float*) fftwf_malloc(NN*sizeof(float));
+    cvec_f = (fftwf_complex*) fftwf_malloc(Nx*Ny_h*sizeof(fftwf_complex));
+
+    mask_hf = mask_h.cast<float>();
+    vis_hf  = vis_h.cast<complex<float> >();
+
+    fftwplan_f  = fftwf_plan_dft_r2c_2d( Nx, Ny, rvec_f, cvec_f, fftw_plan_flag);
+    ifftwplan_f = fftwf_plan_dft_c2r_2d( Nx, Ny, cvec_f, rvec_f, fftw_plan_flag);
+  }
+
+  /* TSV in the prox */
+
+  if(tsv_prox){
+    cout << "TSV is handled by the prox with DCT." << endl;
+    init_tsv_dct(Nx, Ny, fftw_plan_flag, &tsv_dct);
+  }
+
+  PROF_LAP(PROF_SETUP, t_setup);
+
+  /* duality gap and gap safe screening: F(0), A'b and the column norm of [A; sqrt(2 lambda_tsv) D] */
+
+  if(screen || gap_stop){
+    if(screen && box_flag == 0){
+      box = VectorXd::Ones(NN);
+      box_flag = 1;
+    }
+    box0 = box;
+    g0   = VectorXd::Zero(NN);
+
+    xtmp = VectorXd::Zero(NN);
+    F0 = calc_F_part_fft(Nx, Ny, vis_h, mask_h, &fftwplan, xtmp, cvec, rvec);
+    dF_dx_fft(g0, Nx, Ny, cvec, mask_h, xtmp, &ifftwplan, rvec);
+  }
+
+  if(screen){
+    xtmp(Ny*(Nx/2) + Ny/2) = 1;
+    calc_F_part_fft(Nx, Ny, vis_h, mask_h, &fftwplan, xtmp, cvec, rvec);
+    dF_dx_fft(dtmp, Nx, Ny, cvec, mask_h, xtmp, &ifftwplan, rvec);
+    colnorm = sqrt(xtmp.dot(g0 - dtmp) + 8*lambda_tsv);
+  }
+
   /* initialization */
 
   if(nonneg_flag == 0)
@@ -208,8 +427,14 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
 
   /* main */
 
-  costtmp = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
-			    &fftwplan, xvec, cvec, rvec);
+  if(single == 1)
+    costtmp = calc_F_part_fft(Nx, Ny, vis_hf, mask_hf,
+			      &fftwplan_f, xvec, cvec_f, rvec_f);
+  else
+    costtmp = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+			      &fftwplan, xvec, cvec, rvec);
+
+  chi2 = 2*costtmp/Mdata;
 
   // from OK 
   l1cost = xvec.lpNorm<1>();
@@ -220,7 +445,55 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
     costtmp += lambda_tsv*tsvcost;
   }
 
-  for(iter = 0; iter < maxiter; iter++){
+  /* checkpoint of the state at the top of an iteration */
+
+  if(ckpt_on){
+    ckpt_add(&ckpt, &iter_start);
+    ckpt_add(&ckpt, &mu);
+    ckpt_add(&ckpt, &c);
+    ckpt_add(&ckpt, &costtmp);
+    ckpt_add(&ckpt, &chi2);
+    ckpt_add(&ckpt, xvec);
+    ckpt_add(&ckpt, zvec);
+    ckpt_add(&ckpt, cost);
+    ckpt_add(&ckpt, chi2v);
+    ckpt_add(&ckpt, &single);
+    ckpt_add(&ckpt, &iter_switch);
+    ckpt_add(&ckpt, &n_screen);
+    ckpt_add(&ckpt, box);
+
+    if(tsv_prox){
+      ckpt_add(&ckpt, tsv_dct.zvec);
+      ckpt_add(&ckpt, tsv_dct.vvec);
+      ckpt_add(&ckpt, &tsv_dct.lambda);
+    }
+
+    ckpt_key(&ckpt, "L1_TSV_fft");
+    ckpt_key(&ckpt, lambda_l1);
+    ckpt_key(&ckpt, lambda_tsv);
+    ckpt_key(&ckpt, eps);
+    ckpt_key(&ckpt, Mdata);
+    ckpt_key(&ckpt, nonneg_flag);
+    ckpt_key(&ckpt, box_flag);
+    ckpt_key(&ckpt, mfista_opt);
+
+    if(ckpt_open(&ckpt, mfista_opt->ckpt_fname, mfista_opt->ckpt_sec,
+		 mfista_opt->resume) < 0) ckpt_on = 0;
+  }
+
+  // once most pixels are screened out the prox and TSV work only on
+  // the pixels left (active); the transforms stay full size
+
+  rebuild = (n_screen > 0);
+
+  trace = trace_open(mfista_opt, "L1_TSV_fft", iter_start+1);
+
+  for(iter = iter_start; iter < maxiter; iter++){
+
+    if(ckpt_on && iter > iter_start && ckpt_due(&ckpt)){
+      iter_start = iter;
+      ckpt_save(&ckpt);
+    }
 
     cost(iter) = costtmp;
 
@@ -229,47 +502,145 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
 	   << cost(iter) << ", c = " << c << endl;
     }
 
-    Qcore = calc_F_part_fft(Nx, Ny, vis_h, mask_h, 
-			    &fftwplan, zvec, cvec, rvec);
+    if(single == 1){
+      Qcore = calc_F_part_fft(Nx, Ny, vis_hf, mask_hf, 
+			      &fftwplan_f, zvec, cvec_f, rvec_f);
 
-    dF_dx_fft(dfdx, Nx, Ny, cvec, mask_h, zvec, &ifftwplan, rvec);
+      dF_dx_fft(dfdx, Nx, Ny, cvec_f, mask_hf, zvec, &ifftwplan_f, rvec_f);
+    }
+    else{
+      Qcore = calc_F_part_fft(Nx, Ny, vis_h, mask_h, 
+			      &fftwplan, zvec, cvec, rvec);
+
+      dF_dx_fft(dfdx, Nx, Ny, cvec, mask_h, zvec, &ifftwplan, rvec);
+    }
+
+    if( lambda_tsv > 0.0 && !tsv_prox ){
+      PROF_BEGIN(t_reg);
+
+      if(use_active){
+	tsvcost = TSV_active(Nx, Ny, zvec, boxa, active);
+	Qcore += lambda_tsv*tsvcost;
 
-    if( lambda_tsv > 0.0 ){
-      tsvcost = TSV(Nx, Ny, zvec, buf_diff);
-      Qcore += lambda_tsv*tsvcost;
+	d_TSV_active(dtmp, Nx, Ny, zvec, active);
+	for(int p : active) dfdx(p) -= lambda_tsv*dtmp(p);
+      }
+      else{
+	tsvcost = TSV(Nx, Ny, zvec, buf_diff);
+	Qcore += lambda_tsv*tsvcost;
+
+	d_TSV(dtmp, Nx, Ny, zvec);
+	dfdx.array() -= lambda_tsv*dtmp.array();
+      }
 
-      d_TSV(dtmp, Nx, Ny, zvec);
-      dfdx.array() -= lambda_tsv*dtmp.array();
+      PROF_LAP(PROF_REG, t_reg);
     }
 
-    for( i = 0; i < maxiter; i++){
-      xtmp.array() = zvec.array() + dfdx.array()/c;
-      soft_th_box(xnew, xtmp, lambda_l1/c, box_flag, box);
-      
-      Fval = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
-			     &fftwplan, xnew, cvec, rvec);
+    // zvec has to be 0 outside of the CLEAN box for the bound of the gap
+
+    if(screen && single == 0 && (iter % SCREENITER) == 0 &&
+       (zvec.array()*(box0.array() == 0).cast<double>()).abs().maxCoeff() == 0){
+      n_new = gap_safe_screen(box, zvec, dfdx, Qcore, F0, g0, colnorm,
+			      lambda_l1, nonneg_flag, use_active ? &active : NULL);
+      if(n_new > 0) rebuild = 1;
+      n_screen += n_new;
+    }
+
+    // stop when the duality gap certifies zvec (and xvec if it is better)
+
+    if(gap_stop && single == 0 && (iter % GAPITER) == 0 &&
+       (box_flag == 0 ||
+	(zvec.array()*(box.array() == 0).cast<double>()).abs().maxCoeff() == 0)){
+      gap  = dual_gap(zvec, dfdx, Qcore, F0, g0, lambda_l1, nonneg_flag,
+		      box_flag, box, NULL, use_active ? &active : NULL);
+      Fval = Qcore + lambda_l1*(use_active ? l1_active(zvec, active) : zvec.lpNorm<1>());
+
+      if(gap <= mfista_opt->gap*Fval){
+	if(Fval < cost(iter)){
+	  xvec = zvec;
+	  cost(iter) = Fval;
+	}
+	stop = STOP_GAP;
+	break;
+      }
+    }
 
-      if( lambda_tsv > 0.0 ){
-	tsvcost = TSV(Nx, Ny, xnew, buf_diff);
+    for( i = 0; i < maxiter; i++){
+      PROF_BEGIN(t_trial);
+      PROF_COUNT(n_trial);
+
+      if(use_active)
+	for(int p : active) xtmp(p) = zvec(p) + dfdx(p)/c;
+      else
+	xtmp.array() = zvec.array() + dfdx.array()/c;
+
+      PROF_BEGIN(t_prox);
+
+      if(tsv_prox)
+	prox_TSV_L1_box(xnew, xtmp, lambda_l1/c, lambda_tsv/c, TSVITER,
+			nonneg_flag, box_flag, box, &tsv_dct);
+      else if(use_active)
+	soft_threshold_active(xnew, xtmp, lambda_l1/c, nonneg_flag, box, active);
+      else
+	soft_th_box(xnew, xtmp, lambda_l1/c, box_flag, box);
+
+      PROF_LAP(PROF_PROX, t_prox);
+
+      if(single == 1)
+	Fval = calc_F_part_fft(Nx, Ny, vis_hf, mask_hf,
+			       &fftwplan_f, xnew, cvec_f, rvec_f);
+      else
+	Fval = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+			       &fftwplan, xnew, cvec, rvec);
+
+      Fdata = Fval;
+
+      if( lambda_tsv > 0.0 && !tsv_prox ){
+	PROF_BEGIN(t_reg);
+	if(use_active)
+	  tsvcost = TSV_active(Nx, Ny, xnew, boxa, active);
+	else
+	  tsvcost = TSV(Nx, Ny, xnew, buf_diff);
 	Fval += lambda_tsv*tsvcost;
+	PROF_LAP(PROF_REG, t_reg);
       }
 
-      Qval = calc_Q_part(xnew, zvec, c, dfdx, xtmp);
+      if(use_active)
+	Qval = calc_Q_part_active(xnew, zvec, c, dfdx, active);
+      else
+	Qval = calc_Q_part(xnew, zvec, c, dfdx, xtmp);
       Qval += Qcore;
 
-      if(Fval<=Qval) break;
+      // in float a step smaller than the rounding of F cannot be told
+      // from a failed one; accepting it keeps c from growing without end
+
+      if(Fval <= Qval + ((single == 1) ? FLOAT_NOISE*fabs(Qval) : 0)) break;
+
+      PROF_LAP(PROF_BT, t_trial);
 
       c *= ETA;
     }
 
     c /= ETA;
 
+    if(res_stop && (iter % GAPITER) == 0) resid = (xnew - zvec).norm();
+
     munew = (1+sqrt(1+4*mu*mu))/2;
 
-    l1cost = xnew.lpNorm<1>();
+    l1cost = use_active ? l1_active(xnew, active) : xnew.lpNorm<1>();
     Fval += lambda_l1*l1cost;
 
-    zvec = xvec;
+    if(tsv_prox){
+      PROF_BEGIN(t_reg);
+      tsvcost = TSV(Nx, Ny, xnew, buf_diff);
+      Fval += lambda_tsv*tsvcost;
+      PROF_LAP(PROF_REG, t_reg);
+    }
+
+    trace_iter(trace, iter+1, Fval, Fdata, l1cost, "tsv", tsvcost, c, i+1,
+	       Fval >= cost(iter));
+
+    if(!use_active) zvec = xvec;
 
     if(Fval < cost(iter)){
 
@@ -278,21 +649,105 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
       tmpa = 1+((mu-1)/munew);
       tmpb = ((1-mu)/munew);
 
-      zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+      if(use_active)
+	for(int p : active){
+	  zvec(p) = tmpa*xnew(p) + tmpb*xvec(p);
+	  xvec(p) = xnew(p);
+	}
+      else{
+	zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+	xvec = xnew;
+      }
 
-      xvec = xnew;
+      chi2 = 2*Fdata/Mdata;
     }
     else{
       tmpa = mu/munew;
       tmpb = 1-(mu/munew);
 
-      zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+      if(use_active)
+	for(int p : active) zvec(p) = tmpa*xnew(p) + tmpb*xvec(p);
+      else
+	zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+
+      // another stopping rule (in double, see the switch below)
+      if(single == 0 && (iter>iter_switch+1) && (xvec.lpNorm<1>() == 0)){
+	stop = STOP_ZERO;
+	break;
+      }
+    }
+
+    // the list (and the vectors off it) change only when x, z and the
+    // trial are 0 on the pixels screened out
+
+    if(rebuild &&
+       ((xvec.array().abs() + zvec.array().abs() + xnew.array().abs())*
+	(box.array() == 0).cast<double>()).maxCoeff() == 0){
+      active_set(box, boxa, active);
+      use_active = (active.size() <= SCREENACTIVE*NN);
+      rebuild = 0;
+    }
+
+    // proximal gradient residual relative to the image
+
+    if(res_stop && single == 0 && (iter % GAPITER) == 0 &&
+       resid <= mfista_opt->gap*xnew.norm()){
+      stop = STOP_RESID;
+      break;
+    }
+
+    // discrepancy principle: Mean SE in the band of the target and stable
+
+    chi2v(iter) = chi2;
+
+    if(chi2_stop && single == 0 && (iter>=iter_switch+TD) &&
+       (chi2v(iter) <= mfista_opt->chi2*(1+CHI2TOL)) &&
+       (chi2v(iter-TD)-chi2v(iter) < CHI2TOL*mfista_opt->chi2)){
+      stop = STOP_CHI2;
+      break;
+    }
 
-      // another stopping rule 
-      if((iter>1) && (xvec.lpNorm<1>() == 0)) break;
+    // time budget: xvec has the lowest cost so far
+
+    if((iter % DEADLINEITER) == 0 && past_deadline(mfista_opt)){
+      stop = STOP_DEADLINE;
+      break;
     }
 
-    if((iter>=MINITER) && ((cost(iter-TD)-cost(iter))< eps )) break;
+    if(single == 1){
+
+      // switch to double precision when float cannot resolve Delta_cost.
+      // Only the time budget stops in float: with a large c the first
+      // steps in float may not decrease the cost at all (x stays 0), so
+      // that also switches, and the last MINITER iterations are kept
+      // for double.
+
+      to_double = (iter>=MINITER) &&
+	((cost(iter-TD)-cost(iter)) < eps + FLOAT_NOISE*fabs(cost(iter)));
+
+      to_double = to_double || (iter+1 >= maxiter-MINITER) ||
+	((iter>1) && (xvec.lpNorm<1>() == 0));
+
+      if(to_double){
+
+	single = 0;
+	iter_switch = iter+1;
+
+	if(mfista_opt->verbose) cout << iter+1 << " switch to double precision." << endl;
+
+	trace_event(trace, "double", iter+1);
+
+	costtmp = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+				  &fftwplan, xvec, cvec, rvec);
+	costtmp += lambda_l1*xvec.lpNorm<1>();
+	if( lambda_tsv > 0 ) costtmp += lambda_tsv*TSV(Nx, Ny, xvec, buf_diff);
+      }
+    }
+    else if((mfista_opt->gap == 0) && (iter>=MINITER) && (iter>=iter_switch+TD) &&
+	    ((cost(iter-TD)-cost(iter))< eps )){
+      stop = STOP_COST;
+      break;
+    }
 
     mu = munew;
   }
@@ -305,8 +760,25 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
 
   cout << endl;
 
+  if(tsv_prox){
+    cout << "average DCT passes: "
+	 << (double)tsv_dct.iter_sum/tsv_dct.ncall << endl << endl;
+    free_tsv_dct(&tsv_dct);
+  }
+
+  if(screen)
+    cout << "screened pixels: " << n_screen << " of " << NN << endl << endl;
+
+  if(ckpt_on) ckpt_close(&ckpt);
+
+  trace_close(trace, stop, iter+1);
+
   *cinit = c;
 
+  mfista_result->stop_rule = stop;
+
+  mfista_result->ITER_float = (mfista_opt->mixed == 1 && iter_switch == 0) ? iter+1 : iter_switch;
+
   for(i = 0; i < NN; i++) xout[i] = xvec(i);
 
   /* free */
@@ -317,10 +789,20 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
   fftw_destroy_plan(fftwplan);
   fftw_destroy_plan(ifftwplan);
 
+  if(mfista_opt->mixed == 1){
+    fftwf_free(rvec_f);
+    fftwf_free(cvec_f);
+
+    fftwf_destroy_plan(fftwplan_f);
+    fftwf_destroy_plan(ifftwplan_f);
+  }
+
 #ifdef PTHREAD
   fftw_cleanup_threads();
+  if(mfista_opt->mixed == 1) fftwf_cleanup_threads();
 #else
   fftw_cleanup();
+  if(mfista_opt->mixed == 1) fftwf_cleanup();
 #endif
 
   cout << resetiosflags(ios_base::floatfield);
@@ -329,32 +811,70 @@ int mfista_L1_TSV_core_fft(int Nx, int Ny, int maxiter, double eps,
   // to OK
 }
 
-/* results */
+/* TV */
 
-void calc_result_fft(int M, int Nx, int Ny,
-		     fftw_complex *vis, double *mask,
-		     double lambda_l1, double lambda_tv, double lambda_tsv, 
-		     double *x,
-		     struct RESULT *mfista_result)
+int mfista_L1_TV_core_fft(int Nx, int Ny, int maxiter, double eps,
+			  fftw_complex *vis, double *mask,
+			  double lambda_l1, double lambda_tv,
+			  double *cinit, double *xinit, double *xout,
+			  int nonneg_flag, unsigned int fftw_plan_flag,
+			  int box_flag, float *cl_box,
+			  struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
 {
-  int i, Ny_h = ((int)floor(((double)Ny)/2)+1), NN = Nx*Ny;
-  double *rvec, tmp;
+  int NN = Nx*Ny, i, iter, Ny_h, aniso = mfista_opt->tv_aniso,
+    res_stop = (mfista_opt->gap > 0), chi2_stop = (mfista_opt->chi2 > 0), stop = STOP_MAXITER,
+    iter_start = 0, ckpt_on = (mfista_opt->ckpt_fname != NULL);
+  double *rvec,
+    Qcore, Fval = 0, Qval, c, tmpa, tmpb, l1cost, tvcost, costtmp,
+    mu=1, munew, resid = 0, Fdata = 0, chi2, Mdata = 0;
   fftw_complex *cvec;
-  fftw_plan fftwplan;
+  fftw_plan fftwplan, ifftwplan;
+  struct FGP_DUAL fgp_dual;
+  struct TV_ANISO tv_aniso;
 
-  VectorXd mask_h, buf_diff, xvec;
+  struct MFISTA_CKPT ckpt;
+  struct MFISTA_TRACE *trace;
+  VectorXd cost, chi2v, xtmp, xnew, zvec, dfdx, xvec, box, mask_h;
   VectorXcd vis_h;
 
+  /* set parameters */
+
+  PROF_BEGIN(t_setup);
+
+  Ny_h = ((int)floor(((double)Ny)/2)+1);
+
+  cout << "computing image with MFISTA." << endl;
+  if(res_stop)
+    cout << "stop if iter = " << maxiter << ", or |x - z| < " << mfista_opt->gap << " |x|" << endl;
+  else
+    cout << "stop if iter = " << maxiter << ", or Delta_cost < " << eps << endl;
+
   /* allocate variables */
 
-  rvec   = new double [NN];
+  cost   = VectorXd::Zero(maxiter);
+  chi2v  = VectorXd::Zero(maxiter);
+  dfdx   = VectorXd::Zero(NN);
+  xnew   = VectorXd::Zero(NN);
+  xtmp   = VectorXd::Zero(NN);
+  box    = VectorXd::Zero(NN);
 
-  xvec   = Map<VectorXd>(x,NN);
-  mask_h = VectorXd::Zero(Nx*Ny_h);
   vis_h  = VectorXcd::Zero(Nx*Ny_h);
-  
+  mask_h = VectorXd::Zero(Nx*Ny_h);
+
+  xvec = Map<VectorXd>(xinit,NN);
+  zvec = xvec;
+
+  if(box_flag == 1)
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+
+  /* preparation for TV */
+
+  if(aniso == 1) init_tv_aniso(Nx, Ny, &tv_aniso);
+  else           init_fgp_dual(Nx, Ny, &fgp_dual);
+
   /* fftw malloc */
 
+  rvec = (double*) fftw_malloc(NN*sizeof(double));
   cvec = (fftw_complex*) fftw_malloc(Nx*Ny_h*sizeof(fftw_complex));
 
   /* preparation for fftw */
@@ -362,116 +882,769 @@ void calc_result_fft(int M, int Nx, int Ny,
   full2half(Nx, Ny, mask, mask_h);
   fft_full2half(Nx, Ny, vis, vis_h);
 
-  fftwplan = fftw_plan_dft_r2c_2d( Nx, Ny, rvec, cvec, FFTW_ESTIMATE);
+  // number of data for the Mean SE
 
-  /* computing results */
-  
-  tmp = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
-			&fftwplan, xvec, cvec, rvec);
+  for(i = 0; i < NN; i++) if(mask[i] > 0) Mdata += 1;
 
-  /* saving results */
+#ifdef PTHREAD
+  int omp_num = THREAD_NUM;
+  cout << "Run mfista with " << omp_num << " threads." << endl;
 
-  mfista_result->sq_error = 2*tmp;
+  if(fftw_init_threads()==0)
+    cout << "Could not initialize multi threads for fftw3." << endl;
+#endif
 
-  mfista_result->M  = (int)(M/2);
-  mfista_result->N  = NN;
-  mfista_result->NX = Nx;
-  mfista_result->NY = Ny;
-	    
-  mfista_result->lambda_l1  = lambda_l1;
-  mfista_result->lambda_tv  = lambda_tv;
-  mfista_result->lambda_tsv = lambda_tsv;
-  
-  mfista_result->mean_sq_error = mfista_result->sq_error/((double)M);
+  fftwplan  = fftw_plan_dft_r2c_2d( Nx, Ny, rvec, cvec, fftw_plan_flag);
+  ifftwplan = fftw_plan_dft_c2r_2d( Nx, Ny, cvec, rvec, fftw_plan_flag);
 
-  mfista_result->l1cost   = 0;
-  mfista_result->N_active = 0;
+  PROF_LAP(PROF_SETUP, t_setup);
 
-  for(i = 0;i < NN;++i){
-    tmp = fabs(xvec[i]);
-    if(tmp > 0){
-      mfista_result->l1cost += tmp;
-      ++ mfista_result->N_active;
-    }
+  if(nonneg_flag != 0 && nonneg_flag != 1){
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
   }
 
-  mfista_result->finalcost = (mfista_result->sq_error)/2;
+  c = *cinit;
 
-  if(lambda_l1 > 0)
-    mfista_result->finalcost += lambda_l1*(mfista_result->l1cost);
+  /* main */
 
-  if(lambda_tsv > 0){
-    mfista_result->tsvcost = TSV(Nx, Ny, xvec, buf_diff);
-    mfista_result->finalcost += lambda_tsv*(mfista_result->tsvcost);
+  costtmp = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+			    &fftwplan, xvec, cvec, rvec);
+
+  chi2 = 2*costtmp/Mdata;
+
+  l1cost = xvec.lpNorm<1>();
+  costtmp += lambda_l1*l1cost;
+
+  tvcost = (aniso == 1) ? TV_aniso(Nx, Ny, xvec) : TV(Nx, Ny, xvec);
+  costtmp += lambda_tv*tvcost;
+
+  /* checkpoint of the state at the top of an iteration */
+
+  if(ckpt_on){
+    ckpt_add(&ckpt, &iter_start);
+    ckpt_add(&ckpt, &mu);
+    ckpt_add(&ckpt, &c);
+    ckpt_add(&ckpt, &costtmp);
+    ckpt_add(&ckpt, &chi2);
+    ckpt_add(&ckpt, xvec);
+    ckpt_add(&ckpt, zvec);
+    ckpt_add(&ckpt, cost);
+    ckpt_add(&ckpt, chi2v);
+
+    if(aniso == 1){
+      ckpt_add(&ckpt, tv_aniso.zvec);
+      ckpt_add(&ckpt, tv_aniso.vvec);
+      ckpt_add(&ckpt, &tv_aniso.lambda);
+    }
+    else{
+      ckpt_add(&ckpt, fgp_dual.pmat);
+      ckpt_add(&ckpt, fgp_dual.qmat);
+    }
+
+    ckpt_key(&ckpt, "L1_TV_fft");
+    ckpt_key(&ckpt, lambda_l1);
+    ckpt_key(&ckpt, lambda_tv);
+    ckpt_key(&ckpt, eps);
+    ckpt_key(&ckpt, Mdata);
+    ckpt_key(&ckpt, nonneg_flag);
+    ckpt_key(&ckpt, box_flag);
+    ckpt_key(&ckpt, mfista_opt);
+
+    if(ckpt_open(&ckpt, mfista_opt->ckpt_fname, mfista_opt->ckpt_sec,
+		 mfista_opt->resume) < 0) ckpt_on = 0;
   }
 
-  /* free */
-  
-  delete cvec;
-  delete rvec;
+  trace = trace_open(mfista_opt, "L1_TV_fft", iter_start+1);
 
-  fftw_destroy_plan(fftwplan);
-  fftw_cleanup();
-}
+  for(iter = iter_start; iter < maxiter; iter++){
 
-/* main subroutine */
+    if(ckpt_on && iter > iter_start && ckpt_due(&ckpt)){
+      iter_start = iter;
+      ckpt_save(&ckpt);
+    }
 
-void mfista_imaging_core_fft(int *u_idx, int *v_idx, 
-			     double *y_r, double *y_i, double *noise_stdev,
-			     int M, int Nx, int Ny, int maxiter, double eps,
-			     double lambda_l1, double lambda_tv, double lambda_tsv,
-			     double cinit, double *xinit, double *xout,
-			     int nonneg_flag, unsigned int fftw_plan_flag,
-			     int box_flag, float *cl_box,
-			     struct RESULT *mfista_result)
+    cost(iter) = costtmp;
+
+    if((iter % 100) == 0){
+      cout << iter+1 << " cost = " << fixed << setprecision(5)
+	   << cost(iter) << ", c = " << c << endl;
+    }
+
+    Qcore = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+			    &fftwplan, zvec, cvec, rvec);
+
+    dF_dx_fft(dfdx, Nx, Ny, cvec, mask_h, zvec, &ifftwplan, rvec);
+
+    for( i = 0; i < maxiter; i++){
+      PROF_BEGIN(t_trial);
+      PROF_COUNT(n_trial);
+
+      xtmp.array() = zvec.array() + dfdx.array()/c;
+
+      PROF_BEGIN(t_prox);
+
+      if(aniso == 1)
+	prox_TV_aniso(xnew, xtmp, lambda_l1/c, lambda_tv/c, ANISOITER,
+		      Nx, Ny, nonneg_flag, box_flag, box, &tv_aniso);
+      else
+	FGP_L1_box(xnew, xtmp, lambda_l1/c, lambda_tv/c, FGPITER,
+		   Nx, Ny, nonneg_flag, box_flag, box, &fgp_dual);
+
+      PROF_LAP(PROF_PROX, t_prox);
+
+      Fval = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+			     &fftwplan, xnew, cvec, rvec);
+
+      Fdata = Fval;
+
+      Qval = calc_Q_part(xnew, zvec, c, dfdx, xtmp);
+      Qval += Qcore;
+
+      if(Fval<=Qval) break;
+
+      PROF_LAP(PROF_BT, t_trial);
+
+      c *= ETA;
+    }
+
+    c /= ETA;
+
+    if(res_stop && (iter % GAPITER) == 0) resid = (xnew - zvec).norm();
+
+    munew = (1+sqrt(1+4*mu*mu))/2;
+
+    l1cost = xnew.lpNorm<1>();
+    Fval += lambda_l1*l1cost;
+
+    PROF_BEGIN(t_reg);
+
+    tvcost = (aniso == 1) ? TV_aniso(Nx, Ny, xnew) : TV(Nx, Ny, xnew);
+    Fval += lambda_tv*tvcost;
+
+    PROF_LAP(PROF_REG, t_reg);
+
+    trace_iter(trace, iter+1, Fval, Fdata, l1cost, "tv", tvcost, c, i+1,
+	       Fval >= cost(iter));
+
+    zvec = xvec;
+
+    if(Fval < cost(iter)){
+
+      costtmp = Fval;
+
+      tmpa = 1+((mu-1)/munew);
+      tmpb = ((1-mu)/munew);
+
+      zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+
+      xvec = xnew;
+      chi2 = 2*Fdata/Mdata;
+    }
+    else{
+      tmpa = mu/munew;
+      tmpb = 1-(mu/munew);
+
+      zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+
+      // another stopping rule
+      if((iter>1) && (xvec.lpNorm<1>() == 0)){
+	stop = STOP_ZERO;
+	break;
+      }
+    }
+
+    // proximal gradient residual relative to the image
+
+    if(res_stop && (iter % GAPITER) == 0 &&
+       resid <= mfista_opt->gap*xnew.norm()){
+      stop = STOP_RESID;
+      break;
+    }
+
+    // discrepancy principle: Mean SE in the band of the target and stable
+
+    chi2v(iter) = chi2;
+
+    if(chi2_stop && (iter>=TD) && (chi2v(iter) <= mfista_opt->chi2*(1+CHI2TOL)) &&
+       (chi2v(iter-TD)-chi2v(iter) < CHI2TOL*mfista_opt->chi2)){
+      stop = STOP_CHI2;
+      break;
+    }
+
+    // time budget: xvec has the lowest cost so far
+
+    if((iter % DEADLINEITER) == 0 && past_deadline(mfista_opt)){
+      stop = STOP_DEADLINE;
+      break;
+    }
+
+    if((!res_stop) && (iter>=MINITER) && ((cost(iter-TD)-cost(iter))< eps )){
+      stop = STOP_COST;
+      break;
+    }
+
+    mu = munew;
+  }
+  if(iter == maxiter){
+    cout << iter << " cost = " << cost(iter-1) << endl;
+    iter = iter -1;
+  }
+  else
+    cout << iter+1 << " cost = "  << cost(iter) << endl;
+
+  if(aniso == 1)
+    cout << "average Dykstra passes: "
+	 << (double)tv_aniso.iter_sum/tv_aniso.ncall << endl;
+  else
+    cout << "average FGP iterations: "
+	 << (double)fgp_dual.iter_sum/fgp_dual.ncall << endl;
+
+  cout << endl;
+
+  if(ckpt_on) ckpt_close(&ckpt);
+
+  trace_close(trace, stop, iter+1);
+
+  *cinit = c;
+
+  mfista_result->stop_rule = stop;
+
+  for(i = 0; i < NN; i++) xout[i] = xvec(i);
+
+  /* free */
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan);
+  fftw_destroy_plan(ifftwplan);
+
+#ifdef PTHREAD
+  fftw_cleanup_threads();
+#else
+  fftw_cleanup();
+#endif
+
+  cout << resetiosflags(ios_base::floatfield);
+
+  return(iter+1);
+}
+
+/* TV by the primal-dual splitting */
+
+int mfista_L1_TV_core_fft_pd(int Nx, int Ny, int maxiter, double eps,
+			     fftw_complex *vis, double *mask,
+			     double lambda_l1, double lambda_tv,
+			     double *cinit, double *xinit, double *xout,
+			     int nonneg_flag, unsigned int fftw_plan_flag,
+			     int box_flag, float *cl_box,
+			     struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
 {
-  int i, iter = 0;
+  int NN = Nx*Ny, i, iter, Ny_h;
+  double *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan, ifftwplan;
+
+  VectorXd xvec, box, mask_h;
+  VectorXcd vis_h;
+
+  /* set parameters */
+
+  Ny_h = ((int)floor(((double)Ny)/2)+1);
+
+  /* allocate variables */
+
+  box    = VectorXd::Zero(NN);
+  vis_h  = VectorXcd::Zero(Nx*Ny_h);
+  mask_h = VectorXd::Zero(Nx*Ny_h);
+
+  xvec = Map<VectorXd>(xinit,NN);
+
+  if(box_flag == 1)
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+
+  /* fftw malloc */
+
+  rvec = (double*) fftw_malloc(NN*sizeof(double));
+  cvec = (fftw_complex*) fftw_malloc(Nx*Ny_h*sizeof(fftw_complex));
+
+  /* preparation for fftw */
+
+  full2half(Nx, Ny, mask, mask_h);
+  fft_full2half(Nx, Ny, vis, vis_h);
+
+#ifdef PTHREAD
+  int omp_num = THREAD_NUM;
+  cout << "Run mfista with " << omp_num << " threads." << endl;
+
+  if(fftw_init_threads()==0)
+    cout << "Could not initialize multi threads for fftw3." << endl;
+#endif
+
+  fftwplan  = fftw_plan_dft_r2c_2d( Nx, Ny, rvec, cvec, fftw_plan_flag);
+  ifftwplan = fftw_plan_dft_c2r_2d( Nx, Ny, cvec, rvec, fftw_plan_flag);
+
+  if(nonneg_flag != 0 && nonneg_flag != 1){
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
+  }
+
+  /* main */
+
+  iter = L1_TV_primal_dual(xvec, Nx, Ny, maxiter, eps, lambda_l1, lambda_tv,
+			   nonneg_flag, box_flag, box,
+			   [&](VectorXd &x, VectorXd &dfdx){
+			     double F = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+							&fftwplan, x, cvec, rvec);
+			     dF_dx_fft(dfdx, Nx, Ny, cvec, mask_h, x, &ifftwplan, rvec);
+			     return(F);
+			   }, cinit, mfista_opt, mfista_result);
+
+  for(i = 0; i < NN; i++) xout[i] = xvec(i);
+
+  /* free */
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan);
+  fftw_destroy_plan(ifftwplan);
+
+#ifdef PTHREAD
+  fftw_cleanup_threads();
+#else
+  fftw_cleanup();
+#endif
+
+  return(iter+1);
+}
+
+/* TSV (lambda_l1 = 0) by L-BFGS */
+
+int mfista_TSV_core_fft_lbfgs(int Nx, int Ny, int maxiter, double eps,
+			      fftw_complex *vis, double *mask,
+			      double lambda_tsv,
+			      double *cinit, double *xinit, double *xout,
+			      int nonneg_flag, unsigned int fftw_plan_flag,
+			      int box_flag, float *cl_box,
+			      struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
+{
+  int NN = Nx*Ny, i, j, iter, Ny_h;
+  double *rvec, delta;
+  fftw_complex *cvec;
+  fftw_plan fftwplan, ifftwplan;
+
+  VectorXd xvec, box, mask_h, h_diag;
+  VectorXcd vis_h;
+
+  /* set parameters */
+
+  Ny_h = ((int)floor(((double)Ny)/2)+1);
+
+  /* allocate variables */
+
+  box    = VectorXd::Zero(NN);
+  vis_h  = VectorXcd::Zero(Nx*Ny_h);
+  mask_h = VectorXd::Zero(Nx*Ny_h);
+
+  xvec = Map<VectorXd>(xinit,NN);
+
+  if(box_flag == 1)
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+
+  /* fftw malloc */
+
+  rvec = (double*) fftw_malloc(NN*sizeof(double));
+  cvec = (fftw_complex*) fftw_malloc(Nx*Ny_h*sizeof(fftw_complex));
+
+  /* preparation for fftw */
+
+  full2half(Nx, Ny, mask, mask_h);
+  fft_full2half(Nx, Ny, vis, vis_h);
+
+#ifdef PTHREAD
+  int omp_num = THREAD_NUM;
+  cout << "Run mfista with " << omp_num << " threads." << endl;
+
+  if(fftw_init_threads()==0)
+    cout << "Could not initialize multi threads for fftw3." << endl;
+#endif
+
+  fftwplan  = fftw_plan_dft_r2c_2d( Nx, Ny, rvec, cvec, fftw_plan_flag);
+  ifftwplan = fftw_plan_dft_c2r_2d( Nx, Ny, cvec, rvec, fftw_plan_flag);
+
+  if(nonneg_flag != 0 && nonneg_flag != 1){
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
+  }
+
+  /* preconditioner: A'A is diagonal in the Fourier domain with mask^2/2,
+     and TSV is close to the periodic Laplacian */
+
+  h_diag = VectorXd::Zero(Nx*Ny_h);
+
+  for(i = 0; i < Nx; i++)
+    for(j = 0; j < Ny_h; j++)
+      h_diag(Ny_h*i+j) = pow(mask_h(Ny_h*i+j),2.0)/2
+	+ 2*lambda_tsv*(4*pow(sin(M_PI*i/Nx),2.0) + 4*pow(sin(M_PI*j/Ny),2.0));
+
+  delta  = EPS*h_diag.maxCoeff();
+  h_diag = (h_diag.array() + delta)*NN;
+
+  /* main */
+
+  iter = TSV_lbfgs_box(xvec, Nx, Ny, maxiter, eps, lambda_tsv,
+		       nonneg_flag, box_flag, box,
+		       [&](VectorXd &x, VectorXd &dfdx){
+			 double F = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+						    &fftwplan, x, cvec, rvec);
+			 dF_dx_fft(dfdx, Nx, Ny, cvec, mask_h, x, &ifftwplan, rvec);
+			 return(F);
+		       },
+		       [&](VectorXd &d){
+			 for(int k = 0; k < NN; k++) rvec[k] = d(k);
+			 fftw_execute(fftwplan);
+			 for(int k = 0; k < Nx*Ny_h; k++){
+			   cvec[k][0] /= h_diag(k);
+			   cvec[k][1] /= h_diag(k);
+			 }
+			 fftw_execute(ifftwplan);
+			 for(int k = 0; k < NN; k++) d(k) = rvec[k];
+		       }, *cinit, mfista_opt, mfista_result);
+
+  for(i = 0; i < NN; i++) xout[i] = xvec(i);
+
+  /* free */
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan);
+  fftw_destroy_plan(ifftwplan);
+
+#ifdef PTHREAD
+  fftw_cleanup_threads();
+#else
+  fftw_cleanup();
+#endif
+
+  return(iter+1);
+}
+
+/* Newton polish of L1+TSV */
+
+int mfista_L1_TSV_core_fft_newton(int Nx, int Ny, int maxiter, double eps,
+				   fftw_complex *vis, double *mask,
+				   double lambda_l1, double lambda_tsv,
+				   double *cinit, double *xinit, double *xout,
+				   int nonneg_flag, unsigned int fftw_plan_flag,
+				   int box_flag, float *cl_box,
+				   int iter_start, struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
+{
+  int NN = Nx*Ny, i, iter, Ny_h;
+  double *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan, ifftwplan;
+
+  VectorXd xvec, box, mask_h;
+  VectorXcd vis_h;
+
+  /* set parameters */
+
+  Ny_h = ((int)floor(((double)Ny)/2)+1);
+
+  /* allocate variables */
+
+  box    = VectorXd::Zero(NN);
+  vis_h  = VectorXcd::Zero(Nx*Ny_h);
+  mask_h = VectorXd::Zero(Nx*Ny_h);
+
+  xvec = Map<VectorXd>(xinit,NN);
+
+  if(box_flag == 1)
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+
+  /* fftw malloc */
+
+  rvec = (double*) fftw_malloc(NN*sizeof(double));
+  cvec = (fftw_complex*) fftw_malloc(Nx*Ny_h*sizeof(fftw_complex));
+
+  /* preparation for fftw */
+
+  full2half(Nx, Ny, mask, mask_h);
+  fft_full2half(Nx, Ny, vis, vis_h);
+
+#ifdef PTHREAD
+  if(fftw_init_threads()==0)
+    cout << "Could not initialize multi threads for fftw3." << endl;
+#endif
+
+  fftwplan  = fftw_plan_dft_r2c_2d( Nx, Ny, rvec, cvec, fftw_plan_flag);
+  ifftwplan = fftw_plan_dft_c2r_2d( Nx, Ny, cvec, rvec, fftw_plan_flag);
+
+  if(nonneg_flag != 0 && nonneg_flag != 1){
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
+  }
+
+  /* main */
+
+  iter = L1_TSV_newton(xvec, Nx, Ny, maxiter, eps, lambda_l1, lambda_tsv,
+		       nonneg_flag, box_flag, box,
+		       [&](VectorXd &x, VectorXd &dfdx){
+			 double F = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+						    &fftwplan, x, cvec, rvec);
+			 dF_dx_fft(dfdx, Nx, Ny, cvec, mask_h, x, &ifftwplan, rvec);
+			 return(F);
+		       }, cinit, iter_start, mfista_opt, mfista_result);
+
+  for(i = 0; i < NN; i++) xout[i] = xvec(i);
+
+  /* free */
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan);
+  fftw_destroy_plan(ifftwplan);
+
+#ifdef PTHREAD
+  fftw_cleanup_threads();
+#else
+  fftw_cleanup();
+#endif
+
+  return(iter+1);
+}
+
+/* results */
+
+void calc_result_fft(int M, int Nx, int Ny,
+		     fftw_complex *vis, double *mask,
+		     double lambda_l1, double lambda_tv, double lambda_tsv, 
+		     double *x,
+		     struct RESULT *mfista_result)
+{
+  int i, Ny_h = ((int)floor(((double)Ny)/2)+1), NN = Nx*Ny;
+  double *rvec, tmp;
+  fftw_complex *cvec;
+  fftw_plan fftwplan;
+
+  VectorXd mask_h, buf_diff, xvec;
+  VectorXcd vis_h;
+
+  /* allocate variables */
+
+  rvec   = new double [NN];
+
+  xvec   = Map<VectorXd>(x,NN);
+  mask_h = VectorXd::Zero(Nx*Ny_h);
+  vis_h  = VectorXcd::Zero(Nx*Ny_h);
+  
+  /* fftw malloc */
+
+  cvec = (fftw_complex*) fftw_malloc(Nx*Ny_h*sizeof(fftw_complex));
+
+  /* preparation for fftw */
+
+  full2half(Nx, Ny, mask, mask_h);
+  fft_full2half(Nx, Ny, vis, vis_h);
+
+  fftwplan = fftw_plan_dft_r2c_2d( Nx, Ny, rvec, cvec, FFTW_ESTIMATE);
+
+  /* computing results */
+  
+  tmp = calc_F_part_fft(Nx, Ny, vis_h, mask_h,
+			&fftwplan, xvec, cvec, rvec);
+
+  /* saving results */
+
+  mfista_result->sq_error = 2*tmp;
+
+  mfista_result->M  = (int)(M/2);
+  mfista_result->N  = NN;
+  mfista_result->NX = Nx;
+  mfista_result->NY = Ny;
+	    
+  mfista_result->lambda_l1  = lambda_l1;
+  mfista_result->lambda_tv  = lambda_tv;
+  mfista_result->lambda_tsv = lambda_tsv;
+  
+  mfista_result->mean_sq_error = mfista_result->sq_error/((double)M);
+
+  mfista_result->l1cost   = 0;
+  mfista_result->N_active = 0;
+
+  for(i = 0;i < NN;++i){
+    tmp = fabs(xvec[i]);
+    if(tmp > 0){
+      mfista_result->l1cost += tmp;
+      ++ mfista_result->N_active;
+    }
+  }
+
+  mfista_result->finalcost = (mfista_result->sq_error)/2;
+
+  if(lambda_l1 > 0)
+    mfista_result->finalcost += lambda_l1*(mfista_result->l1cost);
+
+  if(lambda_tsv > 0){
+    mfista_result->tsvcost = TSV(Nx, Ny, xvec, buf_diff);
+    mfista_result->finalcost += lambda_tsv*(mfista_result->tsvcost);
+  }
+  else if (lambda_tv > 0){
+    if(mfista_result->tv_aniso == 1)
+      mfista_result->tvcost = TV_aniso(Nx, Ny, xvec);
+    else
+      mfista_result->tvcost = TV(Nx, Ny, xvec);
+    mfista_result->finalcost += lambda_tv*(mfista_result->tvcost);
+  }
+
+  /* free */
+  
+  delete cvec;
+  delete rvec;
+
+  fftw_destroy_plan(fftwplan);
+  fftw_cleanup();
+}
+
+/* main subroutine */
+
+void mfista_imaging_core_fft_opt(int *u_idx, int *v_idx, 
+				 double *y_r, double *y_i, double *noise_stdev,
+				 int M, int Nx, int Ny, int maxiter, double eps,
+				 double lambda_l1, double lambda_tv, double lambda_tsv,
+				 double cinit, double *xinit, double *xout,
+				 int nonneg_flag, unsigned int fftw_plan_flag,
+				 int box_flag, float *cl_box,
+				 struct MFISTA_OPT *mfista_opt,
+				 struct RESULT *mfista_result)
+{
+  int i, iter = 0, M_cell, newton;
   double epsilon, *mask, s_t, e_t, c = cinit;
   struct timespec time_spec1, time_spec2;
   fftw_complex *vis;
 
+  // the time budget includes the preparations
+
+  get_current_time(&mfista_opt->t_start);
+
+  prof_reset();
+
   for(epsilon=0, i=0;i<M;++i) epsilon += y_r[i]*y_r[i] + y_i[i]*y_i[i];
     
   epsilon *= eps/((double)M);
 
+  // one sample per uv cell; idx2mat would keep only the last of a cell
+
+  vector<int> u_cell(M), v_cell(M);
+  vector<double> y_r_cell(M), y_i_cell(M), noise_cell(M);
+
+  M_cell = merge_fft_data(M, Nx, Ny, u_idx, v_idx, y_r, y_i, noise_stdev,
+			  u_cell.data(), v_cell.data(), y_r_cell.data(), y_i_cell.data(),
+			  noise_cell.data());
+
+  if(M_cell < M)
+    cout << M << " visibilities are merged into " << M_cell << " uv cells ("
+	 << (double)M/M_cell << " per cell)." << endl;
+
   vis   = (fftw_complex*) fftw_malloc(Nx*Ny*sizeof(fftw_complex));
   mask = new double [Nx*Ny];
 
-  idx2mat(M, Nx, Ny, u_idx, v_idx, y_r, y_i, noise_stdev, vis, mask);
+  idx2mat(M_cell, Nx, Ny, u_cell.data(), v_cell.data(), y_r_cell.data(), y_i_cell.data(),
+	  noise_cell.data(), vis, mask);
 
   get_current_time(&time_spec1);
 
-  if( lambda_tv == 0 ){
-    iter = mfista_L1_TSV_core_fft(Nx, Ny, maxiter, epsilon,
+  if( lambda_tv == 0 && lambda_l1 == 0 && mfista_opt->lbfgs == 1 &&
+      !opt_mfista_only(mfista_opt, "L-BFGS", 1) ){
+    iter = mfista_TSV_core_fft_lbfgs(Nx, Ny, maxiter, epsilon,
+				     vis, mask, lambda_tsv, &c, xinit, xout,
+				     nonneg_flag, fftw_plan_flag, box_flag, cl_box,
+				     mfista_opt, mfista_result);
+  }
+  else if( lambda_tv == 0 ){
+    newton = (mfista_opt->newton == 1 && !opt_mfista_only(mfista_opt, "-newton", 0));
+
+    iter = mfista_L1_TSV_core_fft(Nx, Ny, maxiter,
+				  (newton == 1) ? NEWTONWARM*epsilon : epsilon,
 				  vis, mask, lambda_l1, lambda_tsv, &c, xinit, xout,
-				  nonneg_flag, fftw_plan_flag, box_flag, cl_box);
+				  nonneg_flag, fftw_plan_flag, box_flag, cl_box,
+				  mfista_opt, mfista_result);
+
+    if(newton == 1 && !past_deadline(mfista_opt))
+      iter += mfista_L1_TSV_core_fft_newton(Nx, Ny, maxiter, epsilon,
+					    vis, mask, lambda_l1, lambda_tsv, &c, xout, xout,
+					    nonneg_flag, fftw_plan_flag, box_flag, cl_box,
+					    iter+1, mfista_opt, mfista_result);
+  }
+  else if( lambda_tv != 0  && lambda_tsv == 0 && mfista_opt->primal_dual == 1 &&
+	   !opt_mfista_only(mfista_opt, "-pd", 1) ){
+    iter = mfista_L1_TV_core_fft_pd(Nx, Ny, maxiter, epsilon,
+				    vis, mask, lambda_l1, lambda_tv, &c, xinit, xout,
+				    nonneg_flag, fftw_plan_flag, box_flag, cl_box,
+				    mfista_opt, mfista_result);
+  }
+  else if( lambda_tv != 0  && lambda_tsv == 0 ){
+    iter = mfista_L1_TV_core_fft(Nx, Ny, maxiter, epsilon,
+				 vis, mask, lambda_l1, lambda_tv, &c, xinit, xout,
+				 nonneg_flag, fftw_plan_flag, box_flag, cl_box,
+				 mfista_opt, mfista_result);
   }
-  // else if( lambda_tv != 0  && lambda_tsv == 0 ){
-  //   iter = mfista_L1_TV_core_fft(Nx, Ny, maxiter, epsilon,
-  // 				 vis, mask, lambda_l1, lambda_tv, &c, xinit, xout,
-  // 				 nonneg_flag, fftw_plan_flag, box_flag, cl_box);
-  // }
   else{
-    cout << "We have not implemented TV option." << endl;
-    // cout << "You cannot set both of lambda_TV and lambda_TSV positive." << endl;
+    cout << "You cannot set both of lambda_TV and lambda_TSV positive." << endl;
+    fftw_free(vis);
+    delete [] mask;
     return;
   }
 
   get_current_time(&time_spec2);
 
-  s_t = (double)time_spec1.tv_sec + (10e-10)*(double)time_spec1.tv_nsec;
-  e_t = (double)time_spec2.tv_sec + (10e-10)*(double)time_spec2.tv_nsec;
+  s_t = (double)time_spec1.tv_sec + (1.0e-9)*(double)time_spec1.tv_nsec;
+  e_t = (double)time_spec2.tv_sec + (1.0e-9)*(double)time_spec2.tv_nsec;
 
   mfista_result->comp_time = e_t-s_t;
   mfista_result->ITER      = iter;
   mfista_result->nonneg    = nonneg_flag;
+  mfista_result->tv_aniso  = mfista_opt->tv_aniso;
   mfista_result->Lip_const = c;
   mfista_result->maxiter   = maxiter;
+  mfista_result->prof      = mfista_prof;
 
-  calc_result_fft(M, Nx, Ny, vis, mask, lambda_l1, lambda_tv, lambda_tsv, xout, mfista_result);
+  calc_result_fft(M_cell, Nx, Ny, vis, mask, lambda_l1, lambda_tv, lambda_tsv, xout, mfista_result);
 
-  delete vis;
-  delete mask;
+  mfista_result->M_raw  = M;
+  mfista_result->M_cell = M_cell;
+
+  fftw_free(vis);
+  delete [] mask;
 
 }
 
+void mfista_imaging_core_fft(int *u_idx, int *v_idx, 
+			     double *y_r, double *y_i, double *noise_stdev,
+			     int M, int Nx, int Ny, int maxiter, double eps,
+			     double lambda_l1, double lambda_tv, double lambda_tsv,
+			     double cinit, double *xinit, double *xout,
+			     int nonneg_flag, unsigned int fftw_plan_flag,
+			     int box_flag, float *cl_box,
+			     struct RESULT *mfista_result)
+{
+  struct MFISTA_OPT mfista_opt;
+  struct RESULT result;
+
+  init_opt(&mfista_opt);
+
+  // the caller's RESULT may end at Lip_const
+
+  memcpy(&result, mfista_result, RESULT_LEGACY);
+
+  mfista_imaging_core_fft_opt(u_idx, v_idx, y_r, y_i, noise_stdev,
+			      M, Nx, Ny, maxiter, eps, lambda_l1, lambda_tv, lambda_tsv,
+			      cinit, xinit, xout, nonneg_flag, fftw_plan_flag,
+			      box_flag, cl_box, &mfista_opt, &result);
+
+  memcpy(mfista_result, &result, RESULT_LEGACY);
+}
@@ -0,0 +1,183 @@
+#include "mfista.hpp"
+#include <cstdio>
+
+// Grids nufft_data (u_rad, v_rad) to fft_data for the FFT engine.
+//
+// Every visibility is snapped to the nearest uv cell of the Nx x Ny
+// FFT grid (grid_nufft_data), and the visibilities of one cell are
+// merged with inverse-variance weights. Two estimates of the error of
+// the approximation are printed:
+//
+//   phase error: a source r pixels off the image center gets a phase
+//     error of about r |(du, dv)|, where (du, dv) is the shift to the
+//     cell center. The rms over the data is printed for a few r, with
+//     the radius where it reaches -tol.
+//
+//   scatter: chi^2 per degree of freedom of the visibilities around
+//     the mean of their cell. About 1 when the visibilities of a cell
+//     differ only by the noise; much larger when the snapping smears
+//     structure of the source (or the noise is underestimated).
+
+// default tolerance of the phase error for the radius
+#define GRIDTOL 0.1
+
+void usage(char *s)
+{
+  cerr << s << " <nufft_data fname> <fft_data fname> {-bin} {-tol t}" << "\n\n";
+
+  cerr << "  <nufft_data fname>:  visibilities at u_rad, v_rad (text or binary)." << endl;
+  cerr << "  <fft_data fname>:    gridded visibilities for mfista_imaging_fft." << "\n\n";
+
+  cerr << " Options." << "\n\n";
+
+  cerr << "  {-bin}:              write a binary file (see mfista_convert)." << endl;
+  cerr << "  {-tol t}:            phase error for the radius of the estimate (default " << GRIDTOL << ")." << "\n\n";
+
+  cerr << " The image of mfista_imaging_fft with the gridded data approximates" << endl;
+  cerr << " that of mfista_imaging_nufft well when the emission lies within the" << endl;
+  cerr << " printed radius and the scatter is close to 1." << "\n\n";
+
+  exit(1);
+}
+
+static void write_fft_text(char *fname, struct VIS_DATA *vis)
+{
+  int i;
+  FILE *fp;
+
+  fp = fopen(fname, "w");
+  if(fp == NULL){
+    cerr << "Cannot open \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  fprintf(fp, "M  = %d\nNX = %d\nNY = %d\n\nu, v, y_r, y_i, noise_std_dev\n\n",
+	  vis->M, vis->Nx, vis->Ny);
+
+  for(i = 0; i < vis->M; i++)
+    fprintf(fp, "%d, %d, %.17e, %.17e, %.17e\n",
+	    ((int*)vis->u)[i], ((int*)vis->v)[i],
+	    vis->vis_r[i], vis->vis_i[i], vis->vis_std[i]);
+
+  fclose(fp);
+}
+
+int main(int argc, char *argv[]){
+
+  int i, k, ku, lv, sign, M, Nx, Ny, NN, M_cell, bin_flag = 0, n_dof;
+  double tol = GRIDTOL, *u_dx, *v_dy, *vis_r, *vis_i, *vis_std, sqNN,
+    d2 = 0, chi2 = 0, r, rms;
+  struct VIS_DATA nufft_vis, fft_vis;
+
+  if(argc < 3) usage(argv[0]);
+
+  for(i = 3; i < argc; i++){
+    if(strcmp(argv[i],"-bin") == 0)
+      bin_flag = 1;
+    else if(strcmp(argv[i],"-tol") == 0 && i+1 < argc)
+      tol = atof(argv[++i]);
+    else
+      usage(argv[0]);
+  }
+
+  nufft_vis.map = NULL;
+
+  if(vis_is_bin(argv[1])){
+    vis_map(argv[1], &nufft_vis);
+    if(nufft_vis.fft != 0){
+      cerr << "\"" << argv[1] << "\" is not NUFFT data." << endl;
+      exit(0);
+    }
+    M  = nufft_vis.M;
+    Nx = nufft_vis.Nx;
+    Ny = nufft_vis.Ny;
+    u_dx    = (double*) nufft_vis.u;
+    v_dy    = (double*) nufft_vis.v;
+    vis_r   = nufft_vis.vis_r;
+    vis_i   = nufft_vis.vis_i;
+    vis_std = nufft_vis.vis_std;
+  }
+  else
+    read_nufft_data(argv[1], &M, &Nx, &Ny, &u_dx, &v_dy, &vis_r, &vis_i, &vis_std);
+
+  NN   = Nx*Ny;
+  sqNN = sqrt((double)NN);
+
+  vector<int> u_idx(2*M), v_idx(2*M), cell_of(NN, -1);
+  vector<double> y_r(2*M), y_i(2*M), noise(2*M);
+
+  M_cell = grid_nufft_data(M, Nx, Ny, u_dx, v_dy, vis_r, vis_i, vis_std,
+			   u_idx.data(), v_idx.data(), y_r.data(), y_i.data(), noise.data());
+
+  // shift to the cell center and scatter around the mean of the cell,
+  // with the cells and signs of grid_nufft_data
+
+  for(k = 0; k < M_cell; k++) cell_of[Ny*u_idx[k] + v_idx[k]] = k;
+
+  for(i = 0; i < M; i++){
+    ku = (int)lround(-u_dx[i]*Nx/(2*M_PI));
+    lv = (int)lround(-v_dy[i]*Ny/(2*M_PI));
+
+    d2 += pow(u_dx[i] + 2*M_PI*ku/Nx, 2.0) + pow(v_dy[i] + 2*M_PI*lv/Ny, 2.0);
+
+    sign = ((ku + lv) % 2 == 0) ? 1 : -1;
+    k    = cell_of[Ny*((ku % Nx + Nx) % Nx) + (lv % Ny + Ny) % Ny];
+
+    chi2 += (pow(sign*vis_r[i]/sqNN - y_r[k], 2.0) + pow(sign*vis_i[i]/sqNN - y_i[k], 2.0))
+      /pow(vis_std[i]/sqNN, 2.0);
+  }
+
+  // the conjugates give the same scatter, so the visibilities alone
+  // have 2M - M_cell degrees of freedom (2 real numbers each)
+
+  n_dof = 2*M - M_cell;
+  rms   = sqrt(d2/M/2);
+
+  // output
+
+  fft_vis.fft     = 1;
+  fft_vis.M       = M_cell;
+  fft_vis.Nx      = Nx;
+  fft_vis.Ny      = Ny;
+  fft_vis.u       = u_idx.data();
+  fft_vis.v       = v_idx.data();
+  fft_vis.vis_r   = y_r.data();
+  fft_vis.vis_i   = y_i.data();
+  fft_vis.vis_std = noise.data();
+  fft_vis.map     = NULL;
+
+  if(bin_flag){
+    if(vis_write(argv[2], &fft_vis) != 0) exit(1);
+  }
+  else
+    write_fft_text(argv[2], &fft_vis);
+
+  cout << M << " visibilities gridded to " << M_cell << " uv cells of "
+       << Nx << " x " << Ny << " (" << 2.0*M/M_cell << " per cell with the conjugates)." << endl;
+
+  cout << endl << " Error estimate." << "\n\n";
+
+  cout << " rms shift to the cell center: " << sqrt(d2/M)*Nx/(2*M_PI) << " cells" << endl;
+
+  for(r = Nx/16.0; r <= Nx/2.0; r *= 2)
+    cout << " phase error at r = " << r << " pixels: " << r*rms << " rad" << endl;
+
+  cout << " radius of phase error " << tol << ": " << ((rms > 0) ? tol/rms : INFINITY) << " pixels" << endl;
+
+  if(n_dof > 0)
+    cout << " scatter in the cells (chi2/dof): " << chi2/n_dof << endl;
+  else
+    cout << " scatter in the cells (chi2/dof): no cell with two visibilities" << endl;
+
+  // release memory
+
+  if(nufft_vis.map != NULL)
+    vis_unmap(&nufft_vis);
+  else{
+    delete [] u_dx;
+    delete [] v_dy;
+    delete [] vis_r;
+    delete [] vis_i;
+    delete [] vis_std;
+  }
+}
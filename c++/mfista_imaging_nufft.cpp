@@ -8,7 +8,7 @@ void usage(char *s)
 
   cerr << s
        << " <nufft_data fname> <double lambda_l1> <double lambda_tv> <double lambda_tsv> <double c> <X outfile>"
-       << " {X initfile} {-nonneg} {-cl_box box_fname} {-maxiter N} {-eps epsilon} {-log log_fname}"
+       << " {X initfile} {-nonneg} {-cl_box box_fname} {-maxiter N} {-eps epsilon} {-mixed} {-aniso} {-pd} {-tsv_prox} {-no_lbfgs} {-newton} {-screen} {-gap tol} {-chi2 target} {-deadline sec} {-checkpoint fname} {-ckpt_sec sec} {-resume} {-trace fname} {-log log_fname}"
        << "\n\n";
   
   cerr << "  <nufft_data fname>:  file name of nufft_file." << endl;
@@ -25,6 +25,20 @@ void usage(char *s)
   cerr << "  {-maxiter N}:        maximum number of iterations." << endl;
   cerr << "  {-eps epsilon}:      epsilon to check convergence." << endl;
   cerr << "  {-cl_box box_fname}: file name of CLEAN box (float)." << endl;
+  cerr << "  {-mixed}:            iterate in float, finish in double." << endl;
+  cerr << "  {-aniso}:            use anisotropic TV." << endl;
+  cerr << "  {-pd}:               solve L1+TV by the primal-dual splitting." << endl;
+  cerr << "  {-tsv_prox}:         put TSV in the prox (solved with DCT)." << endl;
+  cerr << "  {-no_lbfgs}:         use MFISTA also when lambda_l1 = 0." << endl;
+  cerr << "  {-newton}:           polish L1+TSV by Newton-CG after MFISTA." << endl;
+  cerr << "  {-screen}:           remove pixels that are 0 at the optimum (L1+TSV)." << endl;
+  cerr << "  {-gap tol}:          stop on the duality gap instead of Delta_cost." << endl;
+  cerr << "  {-chi2 target}:      stop when Mean SE reaches target (discrepancy principle)." << endl;
+  cerr << "  {-deadline sec}:     return the best image after sec seconds." << endl;
+  cerr << "  {-checkpoint fname}: save the MFISTA state to fname periodically." << endl;
+  cerr << "  {-ckpt_sec sec}:     interval of the checkpoints (default " << CKPTSEC << ")." << endl;
+  cerr << "  {-resume}:           continue from the state in the checkpoint file." << endl;
+  cerr << "  {-trace fname}:      write every MFISTA iteration to fname in JSON lines." << endl;
   cerr << "  {-log log_fname}:    log file name."                << "\n\n";
 
   cerr << " This solves one of the following problems with nonuniform FFT."
@@ -46,6 +60,65 @@ void usage(char *s)
 
   cerr << " If {-nonneg} option is active, x is nonnegative." << "\n\n";
 
+  cerr << " <nufft_data fname> is a text file or a binary file made by" << endl;
+  cerr << " mfista_convert, which is mapped and used without reading." << "\n\n";
+
+  cerr << " If {-aniso} option is used, TV(x) is the anisotropic TV" << endl;
+  cerr << " sum |x(i,j)-x(i+1,j)| + |x(i,j)-x(i,j+1)|." << "\n\n";
+
+  cerr << " If {-pd} option is used, the problem with TV is solved by the" << endl;
+  cerr << " primal-dual splitting of Condat and Vu instead of MFISTA." << endl;
+  cerr << " c is not used; the stepsize is set from |A'A|." << "\n\n";
+
+  cerr << " If {-tsv_prox} option is used, TSV(x) is not differentiated but" << endl;
+  cerr << " put in the prox, which is solved by DCT. This makes the stepsize" << endl;
+  cerr << " independent of lambda_tsv and helps when lambda_tsv is large." << endl;
+  cerr << " The prox is exact for lambda_l1 = 0 without {-nonneg} and {-cl_box};" << endl;
+  cerr << " otherwise it is iterated, which costs several DCTs per step." << "\n\n";
+
+  cerr << " If lambda_l1 = 0 and lambda_tv = 0, the cost is smooth and is minimized" << endl;
+  cerr << " by L-BFGS with the bounds of {-nonneg} and {-cl_box}. {-no_lbfgs}" << endl;
+  cerr << " switches this off." << "\n\n";
+
+  cerr << " If {-newton} option is used, MFISTA for L1+TSV stops at 1e4 epsilon" << endl;
+  cerr << " and the image is polished to epsilon by Newton-CG steps on the" << endl;
+  cerr << " support of x. This is faster for small epsilon." << "\n\n";
+
+  cerr << " If {-screen} option is used, the gap safe screening removes every" << endl;
+  cerr << " " << SCREENITER << " iterations the pixels proven to be 0 at the optimum;" << endl;
+  cerr << " they are added to the CLEAN box. Once no more than " << SCREENACTIVE*100 << "% of the" << endl;
+  cerr << " pixels are left, the prox and TSV are computed only on those; the" << endl;
+  cerr << " transforms stay full size." << "\n\n";
+
+  cerr << " If {-gap tol} option is used, MFISTA stops when the duality gap is" << endl;
+  cerr << " below tol times the cost (L1+TSV with lambda_l1 > 0), which bounds" << endl;
+  cerr << " the error of the cost, or otherwise when the proximal gradient step" << endl;
+  cerr << " |x - z| is below tol |x|. The tests are done every " << GAPITER << " iterations" << endl;
+  cerr << " and replace the test on Delta_cost with epsilon." << "\n\n";
+
+  cerr << " If {-chi2 target} option is used, MFISTA also stops when Mean SE" << endl;
+  cerr << " (chi^2 per data) is within " << CHI2TOL << " target above target and has changed" << endl;
+  cerr << " less than that over " << TD << " iterations. Use the expected value for the" << endl;
+  cerr << " noise, e.g. target = 2 for complex data with the stdev per component." << endl;
+  cerr << " The rule that stopped MFISTA is written to the log." << "\n\n";
+
+  cerr << " If {-deadline sec} option is used, MFISTA checks the time every " << DEADLINEITER << endl;
+  cerr << " iterations and returns the image of the lowest cost so far when sec" << endl;
+  cerr << " seconds have passed since the start of the solver, including the" << endl;
+  cerr << " preparation of the transforms. The Newton polish is then skipped." << "\n\n";
+
+  cerr << " If {-checkpoint fname} option is used, the state of MFISTA (x, z, mu," << endl;
+  cerr << " c, iteration, cost history and the warm starts of the proxes) is" << endl;
+  cerr << " written to the memory mapped file fname every ckpt_sec seconds. With" << endl;
+  cerr << " {-resume}, a run with the same data and options continues exactly" << endl;
+  cerr << " from the last saved state. A file written with other lambdas, epsilon," << endl;
+  cerr << " number of data or options is not loaded." << "\n\n";
+
+  cerr << " If {-trace fname} option is used, each MFISTA iteration is written to" << endl;
+  cerr << " fname as one JSON object (iter, cost, data, l1, tsv or tv, c, trials," << endl;
+  cerr << " dt, restart), with start, stop and precision switch events. A writer" << endl;
+  cerr << " thread does the output, so the iterations are not slowed down." << "\n\n";
+
   cerr << " c is used for stepsize. Large c makes the algorithm" << endl;
   cerr << " stable but slow. Around 500000 is fine." << "\n\n";
   
@@ -56,7 +129,7 @@ void usage(char *s)
 
 int main(int argc, char *argv[]){
 
-  string buf_str, nufftw_fname, log_fname, init_fname, box_fname;
+  string nufftw_fname, log_fname, init_fname, box_fname;
 
   int M, NN, Nx, Ny, dnum, i,
     init_flag = 0, box_flag = 0, log_flag = 0, nonneg_flag = 0,
@@ -69,8 +142,13 @@ int main(int argc, char *argv[]){
 
   struct IO_FNAMES mfista_io;
   struct RESULT    mfista_result;
+  struct MFISTA_OPT mfista_opt;
+  struct VIS_DATA  vis_data;
+
+  vis_data.map = NULL;
 
   init_result(&mfista_io, &mfista_result);
+  init_opt(&mfista_opt);
   
   // check the number of variables first.
 
@@ -114,6 +192,54 @@ int main(int argc, char *argv[]){
     else if(strcmp(argv[i],"-nonneg") == 0){
       nonneg_flag = 1;
     }
+    else if(strcmp(argv[i],"-mixed") == 0){
+      mfista_opt.mixed = 1;
+    }
+    else if(strcmp(argv[i],"-aniso") == 0){
+      mfista_opt.tv_aniso = 1;
+    }
+    else if(strcmp(argv[i],"-pd") == 0){
+      mfista_opt.primal_dual = 1;
+    }
+    else if(strcmp(argv[i],"-tsv_prox") == 0){
+      mfista_opt.tsv_prox = 1;
+    }
+    else if(strcmp(argv[i],"-no_lbfgs") == 0){
+      mfista_opt.lbfgs = 0;
+    }
+    else if(strcmp(argv[i],"-newton") == 0){
+      mfista_opt.newton = 1;
+    }
+    else if(strcmp(argv[i],"-screen") == 0){
+      mfista_opt.screen = 1;
+    }
+    else if(strcmp(argv[i],"-gap") == 0){
+      i++;
+      mfista_opt.gap = atof(argv[i]);
+    }
+    else if(strcmp(argv[i],"-chi2") == 0){
+      i++;
+      mfista_opt.chi2 = atof(argv[i]);
+    }
+    else if(strcmp(argv[i],"-deadline") == 0){
+      i++;
+      mfista_opt.deadline = atof(argv[i]);
+    }
+    else if(strcmp(argv[i],"-checkpoint") == 0){
+      i++;
+      mfista_opt.ckpt_fname = argv[i];
+    }
+    else if(strcmp(argv[i],"-ckpt_sec") == 0){
+      i++;
+      mfista_opt.ckpt_sec = atof(argv[i]);
+    }
+    else if(strcmp(argv[i],"-resume") == 0){
+      mfista_opt.resume = 1;
+    }
+    else if(strcmp(argv[i],"-trace") == 0){
+      i++;
+      mfista_opt.trace_fname = argv[i];
+    }
     else{
       init_flag  = 1;
       init_fname = argv[i];
@@ -136,35 +262,23 @@ int main(int argc, char *argv[]){
 
   cout << "data file name is \"" << nufftw_fname << ".\"\n";
 
-  // open a file
-  
-  ifstream nufft_fs(nufftw_fname.data());
-
-  if(nufft_fs.fail()){
-    cerr << "Cannot open \"" << nufftw_fname << ".\"\n";
-    exit(0);
+  if(vis_is_bin(nufftw_fname)){
+    vis_map(nufftw_fname, &vis_data);
+    if(vis_data.fft != 0){
+      cerr << "\"" << nufftw_fname << "\" is not NUFFT data." << endl;
+      exit(0);
+    }
+    M  = vis_data.M;
+    Nx = vis_data.Nx;
+    Ny = vis_data.Ny;
+    u_dx    = (double*) vis_data.u;
+    v_dy    = (double*) vis_data.v;
+    vis_r   = vis_data.vis_r;
+    vis_i   = vis_data.vis_i;
+    vis_std = vis_data.vis_std;
   }
-
-  // read data
-
-  getline(nufft_fs, buf_str);
-  if(sscanf(buf_str.data(), "M  = %d\n", &M) != 1)  exit(0);
-
-  getline(nufft_fs, buf_str);  
-  if(sscanf(buf_str.data(), "NX = %d\n", &Nx) != 1) exit(0);
-
-  getline(nufft_fs, buf_str);  
-  if(sscanf(buf_str.data(), "NY = %d\n", &Ny) != 1) exit(0);
-
-  getline(nufft_fs, buf_str);  
-  if(sscanf(buf_str.data(), "\n") != 0)             exit(0);
-
-  getline(nufft_fs, buf_str);  
-  if(sscanf(buf_str.data(),
-	     "u_rad, v_rad, vis_r, vis_i, noise_std_dev\n") != 0) exit(0);
-
-  getline(nufft_fs, buf_str);  
-  if(sscanf(buf_str.data(), "\n") != 0)             exit(0);
+  else
+    read_nufft_data(nufftw_fname, &M, &Nx, &Ny, &u_dx, &v_dy, &vis_r, &vis_i, &vis_std);
 
   // print data size
 
@@ -177,29 +291,10 @@ int main(int argc, char *argv[]){
 
   // allocate vectors
   
-  u_dx = new double[M];
-  v_dy = new double[M];
-  vis_r  = new double[M];
-  vis_i  = new double[M];
-  vis_std  = new double[M];
   xinit = new double[NN];
   xvec  = new double[NN];
   box = new float[NN];
 
-  // read visibilities
-
-  for(i = 0; i < M; i++){
-    getline(nufft_fs, buf_str);  
-    if(sscanf(buf_str.data(), "%le, %le, %le, %le, %le\n",
-	      u_dx+i, v_dy+i, vis_r+i, vis_i+i, vis_std+i)!=5){
-
-      cerr << "cannot read data." << endl;
-      exit(0);
-    }
-  }
-
-  nufft_fs.close();
-
   // initialize vector
 
   if (init_flag == 1){
@@ -237,9 +332,10 @@ int main(int argc, char *argv[]){
 
   // main iteration
 
-  mfista_imaging_core_nufft(u_dx, v_dy, vis_r, vis_i, vis_std,
-			    M, Nx, Ny, maxiter, eps, lambda_l1, lambda_tv, lambda_tsv, cinit,
-			    xinit, xvec, nonneg_flag, box_flag, box, &mfista_result);
+  mfista_imaging_core_nufft_opt(u_dx, v_dy, vis_r, vis_i, vis_std,
+				M, Nx, Ny, maxiter, eps, lambda_l1, lambda_tv, lambda_tsv, cinit,
+				xinit, xvec, nonneg_flag, box_flag, box,
+				&mfista_opt, &mfista_result);
 
   // write resulting image to a file
 
@@ -264,11 +360,15 @@ int main(int argc, char *argv[]){
 
   // release memory
 
-  delete u_dx;
-  delete v_dy;
-  delete vis_r;
-  delete vis_i;
-  delete vis_std;
+  if(vis_data.map != NULL)
+    vis_unmap(&vis_data);
+  else{
+    delete u_dx;
+    delete v_dy;
+    delete vis_r;
+    delete vis_i;
+    delete vis_std;
+  }
   delete xinit;
   delete xvec;
   delete box;
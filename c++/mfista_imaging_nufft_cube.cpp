@@ -0,0 +1,354 @@
+#include "mfista.hpp"
+#include <fstream>
+
+// I-O part
+
+void usage(char *s)
+{
+
+  cerr << s
+       << " <channel list fname> <double lambda_l1> <double lambda_tv> <double lambda_tsv> <double c> <X cube outfile>"
+       << " {X initfile} {-nonneg} {-cl_box box_fname} {-maxiter N} {-eps epsilon} {-mixed} {-batch} {-log log_fname}"
+       << "\n\n";
+
+  cerr << "  <channel list fname>: file listing one nufft_file per line." << endl;
+  cerr << "  <double lambda_l1>:   lambda_l1.  Positive."    << endl;
+  cerr << "  <double lambda_tv>:   lambda_tv.  Positive."    << endl;
+  cerr << "  <double lambda_tsv>:  lambda_tsv. Positive."    << endl;
+  cerr << "  <double c>:           c.          Positive."    << endl;
+  cerr << "  <X cube outfile>:     file name to write the X of all channels." << "\n\n";
+
+  cerr << " Options." << "\n\n";
+
+  cerr << "  {X initfile}:         file name of initial X."       << endl;
+  cerr << "  {-nonneg}:            Use this if x is nonnegative." << endl;
+  cerr << "  {-maxiter N}:         maximum number of iterations." << endl;
+  cerr << "  {-eps epsilon}:       epsilon to check convergence." << endl;
+  cerr << "  {-cl_box box_fname}:  file name of CLEAN box (float)." << endl;
+  cerr << "  {-mixed}:             iterate in float, finish in double." << endl;
+  cerr << "  {-batch}:             solve all channels together (same u_rad, v_rad)." << endl;
+  cerr << "  {-log log_fname}:     log file name."                << "\n\n";
+
+  cerr << " This solves the problem of mfista_imaging_nufft for every channel" << endl;
+  cerr << " of a spectral cube. All the channels must have the same NX and NY." << "\n\n";
+
+  cerr << " Images are written to <X cube outfile> as soon as each channel" << endl;
+  cerr << " is finished; channel ch is stored at offset ch*NX*NY (double)." << "\n\n";
+
+  cerr << " With {-batch} the channels (e.g. the polarizations of one data set)" << endl;
+  cerr << " must share u_rad and v_rad; they are solved with one set of gridding" << endl;
+  cerr << " tables and batched FFTs, and written when all are finished." << "\n\n";
+
+  cerr << " c is used for stepsize. Large c makes the algorithm" << endl;
+  cerr << " stable but slow. Around 500000 is fine." << "\n\n";
+
+  exit(1);
+}
+
+// writing each channel as soon as it is solved
+
+struct CUBE_OUT{
+  ofstream *out_fs;
+  ofstream *log_fs;
+  int NN;
+  char *prog;
+  vector<string> *fnames;
+  struct IO_FNAMES *mfista_io;
+};
+
+void write_channel(int ch, double *x, struct RESULT *res, void *arg)
+{
+  struct CUBE_OUT *cube_out = (struct CUBE_OUT*) arg;
+
+  cube_out->out_fs->seekp((streamoff)ch*cube_out->NN*sizeof(double));
+  cube_out->out_fs->write((char*)x, sizeof(double)*cube_out->NN);
+  cube_out->out_fs->flush();
+
+  cout << "channel " << ch << ": iterations " << res->ITER
+       << ", cost " << res->finalcost
+       << ", time " << res->comp_time << " sec." << endl;
+
+  if(cube_out->log_fs != NULL){
+    cube_out->mfista_io->fft_fname = (char*)(*cube_out->fnames)[ch].data();
+    write_result(cube_out->log_fs, cube_out->prog, cube_out->mfista_io, res);
+  }
+}
+
+// commandline program
+
+int main(int argc, char *argv[]){
+
+  string buf_str, list_fname, log_fname, init_fname, box_fname;
+
+  int Nch, NN, Nx = 0, Ny = 0, Nx_ch, Ny_ch, dnum, i, ch,
+    init_flag = 0, box_flag = 0, log_flag = 0, nonneg_flag = 0, batch_flag = 0,
+    maxiter = MAXITER, *M;
+
+  float *box;
+
+  double cinit, lambda_l1, lambda_tv, lambda_tsv, eps = EPS,
+    **u_dx, **v_dy, **vis_std, **vis_r, **vis_i, *xinit;
+
+  vector<string> fnames;
+
+  struct IO_FNAMES mfista_io;
+  struct RESULT    *mfista_result;
+  struct MFISTA_OPT mfista_opt;
+  struct CUBE_OUT  cube_out;
+
+  init_opt(&mfista_opt);
+
+  // check the number of variables first.
+
+  if(argc<7) usage(argv[0]);
+
+  // read parameters
+
+  lambda_l1 = atof(argv[2]);
+  cout << "lambda_l1  = " << lambda_l1 << endl;
+
+  lambda_tv = atof(argv[3]);
+  cout << "lambda_tv  = " << lambda_tv << endl;
+
+  lambda_tsv = atof(argv[4]);
+  cout << "lambda_tsv = " << lambda_tsv << endl;
+
+  cinit = std::atof(argv[5]);
+  cout << "c = " << cinit << endl;
+
+  // read options
+
+  for(i = 7; i < argc ; i++){
+    if(strcmp(argv[i],"-log") == 0){
+      log_flag = 1;
+      i++;
+      log_fname = argv[i];
+    }
+    else if(strcmp(argv[i],"-cl_box") == 0){
+      box_flag = 1;
+      i++;
+      box_fname = argv[i];
+    }
+    else if(strcmp(argv[i],"-maxiter") == 0){
+      i++;
+      maxiter = atoi(argv[i]);
+    }
+    else if(strcmp(argv[i],"-eps") == 0){
+      i++;
+      eps = atof(argv[i]);
+    }
+    else if(strcmp(argv[i],"-nonneg") == 0){
+      nonneg_flag = 1;
+    }
+    else if(strcmp(argv[i],"-mixed") == 0){
+      mfista_opt.mixed = 1;
+    }
+    else if(strcmp(argv[i],"-batch") == 0){
+      batch_flag = 1;
+    }
+    else{
+      init_flag  = 1;
+      init_fname = argv[i];
+    }
+  }
+
+  if(nonneg_flag == 1)
+    cout << "x is nonnegative." << endl;
+
+  if(log_flag ==1)
+    cout << "Log will be saved to "
+	 << "\"" << log_fname << "\"." << endl;
+
+  cout << endl;
+
+  // read channel list
+
+  list_fname = argv[1];
+
+  ifstream list_fs(list_fname.data());
+
+  if(list_fs.fail()){
+    cerr << "Cannot open \"" << list_fname << ".\"\n";
+    exit(0);
+  }
+
+  while(getline(list_fs, buf_str))
+    if(buf_str.size() > 0) fnames.push_back(buf_str);
+
+  list_fs.close();
+
+  Nch = (int)fnames.size();
+
+  if(Nch == 0){
+    cerr << "No channel in \"" << list_fname << ".\"\n";
+    exit(0);
+  }
+
+  cout << "number of channels:    " << Nch << endl;
+
+  // read visibilities of all channels
+
+  M       = new int[Nch];
+  u_dx    = new double*[Nch];
+  v_dy    = new double*[Nch];
+  vis_r   = new double*[Nch];
+  vis_i   = new double*[Nch];
+  vis_std = new double*[Nch];
+
+  for(ch = 0; ch < Nch; ch++){
+    read_nufft_data(fnames[ch], M+ch, &Nx_ch, &Ny_ch,
+		    u_dx+ch, v_dy+ch, vis_r+ch, vis_i+ch, vis_std+ch);
+
+    if(ch == 0){
+      Nx = Nx_ch;
+      Ny = Ny_ch;
+    }
+    else if(Nx_ch != Nx || Ny_ch != Ny){
+      cerr << "Image size of \"" << fnames[ch] << "\" differs from the first channel." << endl;
+      exit(0);
+    }
+
+    cout << "channel " << ch << ": \"" << fnames[ch]
+	 << "\", number of u-v points: " << M[ch] << endl;
+
+    if(batch_flag == 1 && ch > 0 &&
+       (M[ch] != M[0] || memcmp(u_dx[ch], u_dx[0], M[0]*sizeof(double)) != 0 ||
+	memcmp(v_dy[ch], v_dy[0], M[0]*sizeof(double)) != 0)){
+      cerr << "u_rad, v_rad of \"" << fnames[ch] << "\" differ from the first channel;"
+	   << " -batch needs the same uv coverage." << endl;
+      exit(0);
+    }
+  }
+
+  // print data size
+
+  NN = Nx*Ny;
+
+  cout << "X-dim of image:        " << Nx << endl;
+  cout << "Y-dim of image:        " << Ny << endl;
+  cout << "Data size Nx x Ny:     " << NN << endl;
+
+  // allocate vectors
+
+  xinit = new double[NN];
+  box   = new float[NN];
+
+  mfista_result = new struct RESULT[Nch];
+
+  for(ch = 0; ch < Nch; ch++) init_result(&mfista_io, mfista_result+ch);
+
+  // initialize vector
+
+  if (init_flag == 1){
+    cout << "Initializing x with " << init_fname.data() << endl;
+
+    ifstream init_fs(init_fname.data(), ios::in | ios::binary);
+    dnum = (int)(init_fs.readsome((char*)xinit, sizeof(double)*NN))
+      /(sizeof(double));
+    init_fs.close();
+
+    if(dnum != NN){
+      cerr << "Number of read data is shorter than expected." << endl;
+      exit(0);
+    }
+  }
+  else
+    for(i = 0; i < NN; i++) xinit[i]=0;
+
+  // cleanbox
+
+  if (box_flag == 1){
+    cout << "Restrict x with CLEAN box defined in \"" << box_fname.data()
+	 << ".\"\n";
+
+    ifstream box_fs(box_fname.data(), ios::in | ios::binary);
+    dnum = (int)(box_fs.readsome((char*)box, sizeof(float)*NN))
+      /(sizeof(float));
+    box_fs.close();
+
+    if(dnum != NN){
+      cerr << "Number of read data is shorter than expected." << endl;
+      exit(0);
+    }
+  }
+
+  // output files
+
+  ofstream out_fs(argv[6], ios::out | ios::binary);
+  ofstream log_fs;
+
+  if(log_flag == 1) log_fs.open(log_fname.data(), ios::out);
+
+  mfista_io.out_fname = argv[6];
+
+  if(init_flag == 1) mfista_io.in_fname = (char*)init_fname.data();
+
+  cube_out.out_fs    = &out_fs;
+  cube_out.log_fs    = (log_flag == 1) ? &log_fs : NULL;
+  cube_out.NN        = NN;
+  cube_out.prog      = argv[0];
+  cube_out.fnames    = &fnames;
+  cube_out.mfista_io = &mfista_io;
+
+  // main iteration
+
+  if(batch_flag == 1){
+
+    // stream by stream: vis_r[ch*M + k], x[ch*NN + i]
+
+    double *vis_r_b = new double[Nch*M[0]], *vis_i_b = new double[Nch*M[0]],
+      *vis_std_b = new double[Nch*M[0]], *xinit_b = new double[Nch*NN],
+      *xout_b = new double[Nch*NN];
+
+    for(ch = 0; ch < Nch; ch++){
+      memcpy(vis_r_b   + ch*M[0], vis_r[ch],   M[0]*sizeof(double));
+      memcpy(vis_i_b   + ch*M[0], vis_i[ch],   M[0]*sizeof(double));
+      memcpy(vis_std_b + ch*M[0], vis_std[ch], M[0]*sizeof(double));
+      memcpy(xinit_b   + ch*NN,   xinit,       NN*sizeof(double));
+    }
+
+    mfista_imaging_core_nufft_batch(u_dx[0], v_dy[0], Nch, vis_r_b, vis_i_b, vis_std_b,
+				    M[0], Nx, Ny, maxiter, eps, lambda_l1, lambda_tv, lambda_tsv,
+				    cinit, xinit_b, xout_b, nonneg_flag, box_flag, box,
+				    &mfista_opt, mfista_result);
+
+    for(ch = 0; ch < Nch; ch++)
+      write_channel(ch, xout_b + ch*NN, mfista_result + ch, &cube_out);
+
+    delete [] vis_r_b;
+    delete [] vis_i_b;
+    delete [] vis_std_b;
+    delete [] xinit_b;
+    delete [] xout_b;
+  }
+  else
+    mfista_imaging_core_nufft_cube(Nch, M, u_dx, v_dy, vis_r, vis_i, vis_std,
+				   Nx, Ny, maxiter, eps, lambda_l1, lambda_tv, lambda_tsv, cinit,
+				   xinit, NULL, nonneg_flag, box_flag, box,
+				   write_channel, &cube_out, &mfista_opt, mfista_result);
+
+  out_fs.close();
+
+  if(log_flag == 1) log_fs.close();
+
+  // release memory
+
+  for(ch = 0; ch < Nch; ch++){
+    delete [] u_dx[ch];
+    delete [] v_dy[ch];
+    delete [] vis_r[ch];
+    delete [] vis_i[ch];
+    delete [] vis_std[ch];
+  }
+
+  delete [] M;
+  delete [] u_dx;
+  delete [] v_dy;
+  delete [] vis_r;
+  delete [] vis_i;
+  delete [] vis_std;
+  delete [] xinit;
+  delete [] box;
+  delete [] mfista_result;
+
+}
@@ -0,0 +1,310 @@
+#include "mfista.hpp"
+#include <fstream>
+#include <sstream>
+
+// I-O part
+
+void usage(char *s)
+{
+
+  cerr << s
+       << " <frame list fname> <double lambda_l1> <double lambda_tv> <double lambda_tsv> <double lambda_t> <double c> <X movie outfile>"
+       << " {X initfile} {-nonneg} {-cl_box box_fname} {-maxiter N} {-eps epsilon} {-log log_fname}"
+       << "\n\n";
+
+  cerr << "  <frame list fname>: file listing one nufft_file per line," << endl;
+  cerr << "                      optionally followed by the time of the frame." << endl;
+  cerr << "  <double lambda_l1>: lambda_l1.  Positive."    << endl;
+  cerr << "  <double lambda_tv>: lambda_tv.  Positive."    << endl;
+  cerr << "  <double lambda_tsv>:lambda_tsv. Positive."    << endl;
+  cerr << "  <double lambda_t>:  lambda_t.   Positive."    << endl;
+  cerr << "  <double c>:         c.          Positive."    << endl;
+  cerr << "  <X movie outfile>:  file name to write the X of all frames." << "\n\n";
+
+  cerr << " Options." << "\n\n";
+
+  cerr << "  {X initfile}:        file name of initial X (one frame)." << endl;
+  cerr << "  {-nonneg}:           Use this if x is nonnegative." << endl;
+  cerr << "  {-maxiter N}:        maximum number of iterations." << endl;
+  cerr << "  {-eps epsilon}:      epsilon to check convergence." << endl;
+  cerr << "  {-cl_box box_fname}: file name of CLEAN box (float)." << endl;
+  cerr << "  {-log log_fname}:    log file name."                << "\n\n";
+
+  cerr << " This solves the following problem with nonuniform FFT."
+       << "\n\n";
+
+  cerr << " argmin sum_t |v_t-A_t x_t|_2^2/2 + lambda_l1 |x_t|_1 + lambda_tsv TSV(x_t)" << endl;
+  cerr << "        + lambda_t sum_t |x_t - x_{t+1}|_2^2/(t_{t+1} - t_t)"
+       << "\n\n";
+
+  cerr << " and write x_1, ..., x_Nt to <X movie outfile>." << endl;
+  cerr << " Frame times are rescaled to a span of Nt; without times" << endl;
+  cerr << " the frames are equally spaced." << "\n\n";
+
+  cerr << " If {-nonneg} option is active, x is nonnegative." << "\n\n";
+
+  cerr << " c is used for stepsize. Large c makes the algorithm" << endl;
+  cerr << " stable but slow. Around 500000 is fine." << "\n\n";
+
+  exit(1);
+}
+
+// commandline program
+
+int main(int argc, char *argv[]){
+
+  string buf_str, list_fname, log_fname, init_fname, box_fname;
+
+  int Nt, NN, Nx = 0, Ny = 0, Nx_t, Ny_t, M_all, dnum, i, t, offset,
+    init_flag = 0, box_flag = 0, log_flag = 0, nonneg_flag = 0, time_flag = 1,
+    maxiter = MAXITER, *M;
+
+  float *box;
+
+  double cinit, lambda_l1, lambda_tv, lambda_tsv, lambda_t, eps = EPS, tmp,
+    *u_dx, *v_dy, *vis_std, *vis_r, *vis_i, *xinit, *xvec, *t_frame;
+
+  vector<string> fnames;
+  vector<double> times;
+  vector<double*> u_t, v_t, r_t, i_t, s_t;
+
+  struct IO_FNAMES mfista_io;
+  struct RESULT    mfista_result;
+
+  init_result(&mfista_io, &mfista_result);
+
+  // check the number of variables first.
+
+  if(argc<8) usage(argv[0]);
+
+  // read parameters
+
+  lambda_l1 = atof(argv[2]);
+  cout << "lambda_l1  = " << lambda_l1 << endl;
+
+  lambda_tv = atof(argv[3]);
+  cout << "lambda_tv  = " << lambda_tv << endl;
+
+  lambda_tsv = atof(argv[4]);
+  cout << "lambda_tsv = " << lambda_tsv << endl;
+
+  lambda_t = atof(argv[5]);
+  cout << "lambda_t   = " << lambda_t << endl;
+
+  cinit = std::atof(argv[6]);
+  cout << "c = " << cinit << endl;
+
+  // read options
+
+  for(i = 8; i < argc ; i++){
+    if(strcmp(argv[i],"-log") == 0){
+      log_flag = 1;
+      i++;
+      log_fname = argv[i];
+    }
+    else if(strcmp(argv[i],"-cl_box") == 0){
+      box_flag = 1;
+      i++;
+      box_fname = argv[i];
+    }
+    else if(strcmp(argv[i],"-maxiter") == 0){
+      i++;
+      maxiter = atoi(argv[i]);
+    }
+    else if(strcmp(argv[i],"-eps") == 0){
+      i++;
+      eps = atof(argv[i]);
+    }
+    else if(strcmp(argv[i],"-nonneg") == 0){
+      nonneg_flag = 1;
+    }
+    else{
+      init_flag  = 1;
+      init_fname = argv[i];
+    }
+  }
+
+  if(nonneg_flag == 1)
+    cout << "x is nonnegative." << endl;
+
+  if(log_flag ==1)
+    cout << "Log will be saved to "
+	 << "\"" << log_fname << "\"." << endl;
+
+  cout << endl;
+
+  // read frame list
+
+  list_fname = argv[1];
+
+  ifstream list_fs(list_fname.data());
+
+  if(list_fs.fail()){
+    cerr << "Cannot open \"" << list_fname << ".\"\n";
+    exit(0);
+  }
+
+  while(getline(list_fs, buf_str)){
+    istringstream line_ss(buf_str);
+
+    if(!(line_ss >> buf_str)) continue;
+
+    fnames.push_back(buf_str);
+
+    if(line_ss >> tmp) times.push_back(tmp);
+    else               time_flag = 0;
+  }
+
+  list_fs.close();
+
+  Nt = (int)fnames.size();
+
+  if(Nt == 0){
+    cerr << "No frame in \"" << list_fname << ".\"\n";
+    exit(0);
+  }
+
+  cout << "number of frames:      " << Nt << endl;
+
+  // read visibilities of all frames
+
+  M = new int[Nt];
+
+  u_t.resize(Nt); v_t.resize(Nt); r_t.resize(Nt); i_t.resize(Nt); s_t.resize(Nt);
+
+  for(t = 0, M_all = 0; t < Nt; t++){
+    read_nufft_data(fnames[t], M+t, &Nx_t, &Ny_t,
+		    &u_t[t], &v_t[t], &r_t[t], &i_t[t], &s_t[t]);
+
+    if(t == 0){
+      Nx = Nx_t;
+      Ny = Ny_t;
+    }
+    else if(Nx_t != Nx || Ny_t != Ny){
+      cerr << "Image size of \"" << fnames[t] << "\" differs from the first frame." << endl;
+      exit(0);
+    }
+
+    cout << "frame " << t << ": \"" << fnames[t]
+	 << "\", number of u-v points: " << M[t] << endl;
+
+    M_all += M[t];
+  }
+
+  u_dx    = new double[M_all];
+  v_dy    = new double[M_all];
+  vis_r   = new double[M_all];
+  vis_i   = new double[M_all];
+  vis_std = new double[M_all];
+
+  for(t = 0, offset = 0; t < Nt; offset += M[t], t++){
+    for(i = 0; i < M[t]; i++){
+      u_dx[offset + i]    = u_t[t][i];
+      v_dy[offset + i]    = v_t[t][i];
+      vis_r[offset + i]   = r_t[t][i];
+      vis_i[offset + i]   = i_t[t][i];
+      vis_std[offset + i] = s_t[t][i];
+    }
+
+    delete [] u_t[t];
+    delete [] v_t[t];
+    delete [] r_t[t];
+    delete [] i_t[t];
+    delete [] s_t[t];
+  }
+
+  t_frame = (time_flag == 1) ? times.data() : NULL;
+
+  // print data size
+
+  NN = Nx*Ny;
+
+  cout << "X-dim of image:        " << Nx << endl;
+  cout << "Y-dim of image:        " << Ny << endl;
+  cout << "Data size Nx x Ny:     " << NN << endl;
+
+  // allocate vectors
+
+  xinit = new double[Nt*NN];
+  xvec  = new double[Nt*NN];
+  box   = new float[NN];
+
+  // initialize vector; every frame starts from the same image
+
+  if (init_flag == 1){
+    cout << "Initializing x with " << init_fname.data() << endl;
+
+    ifstream init_fs(init_fname.data(), ios::in | ios::binary);
+    dnum = (int)(init_fs.readsome((char*)xinit, sizeof(double)*NN))
+      /(sizeof(double));
+    init_fs.close();
+
+    if(dnum != NN){
+      cerr << "Number of read data is shorter than expected." << endl;
+      exit(0);
+    }
+  }
+  else
+    for(i = 0; i < NN; i++) xinit[i]=0;
+
+  for(t = 1; t < Nt; t++)
+    for(i = 0; i < NN; i++) xinit[t*NN + i] = xinit[i];
+
+  // cleanbox
+
+  if (box_flag == 1){
+    cout << "Restrict x with CLEAN box defined in \"" << box_fname.data()
+	 << ".\"\n";
+
+    ifstream box_fs(box_fname.data(), ios::in | ios::binary);
+    dnum = (int)(box_fs.readsome((char*)box, sizeof(float)*NN))
+      /(sizeof(float));
+    box_fs.close();
+
+    if(dnum != NN){
+      cerr << "Number of read data is shorter than expected." << endl;
+      exit(0);
+    }
+  }
+
+  // main iteration
+
+  mfista_imaging_core_nufft_movie(Nt, M, t_frame, u_dx, v_dy, vis_r, vis_i, vis_std,
+				  Nx, Ny, maxiter, eps, lambda_l1, lambda_tv, lambda_tsv,
+				  lambda_t, cinit, xinit, xvec, nonneg_flag, box_flag, box,
+				  &mfista_result);
+
+  // write resulting movie to a file
+
+  ofstream out_fs(argv[7], ios::out | ios::binary);
+  out_fs.write((char*)xvec, sizeof(double)*Nt*NN);
+  out_fs.close();
+
+  // output results
+
+  mfista_io.fft_fname = argv[1];
+  mfista_io.out_fname = argv[7];
+
+  if(init_flag == 1) mfista_io.in_fname = (char*)init_fname.data();
+
+  cout_result(argv[0], &mfista_io, &mfista_result);
+
+  if(log_flag == 1){
+    ofstream log_fs(log_fname.data(), ios::out);
+    write_result(&log_fs, argv[0], &mfista_io, &mfista_result);
+    log_fs.close();
+  }
+
+  // release memory
+
+  delete [] M;
+  delete [] u_dx;
+  delete [] v_dy;
+  delete [] vis_r;
+  delete [] vis_i;
+  delete [] vis_std;
+  delete [] xinit;
+  delete [] xvec;
+  delete [] box;
+
+}
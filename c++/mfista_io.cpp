@@ -1,7 +1,54 @@
 #include "mfista.hpp"
+#include <fstream>
+#include <string.h>
+#include <charconv>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef PTHREAD
+#include <thread>
+#endif
 
 // I-O part
 
+static const char *stop_rule_name[] = {"MAXITER", "Delta_cost", "x = 0",
+				       "duality gap", "|x - z|", "Mean SE",
+				       "deadline"};
+
+static const char *prof_name[] = {" setup:                  ",
+				  " forward transform:      ",
+				  " adjoint transform:      ",
+				  " gridding:               ",
+				  " prox:                   ",
+				  " TSV / TV:               ",
+				  " rejected trials:        "};
+
+// per-phase breakdown, empty if the solver was not instrumented
+
+static void write_prof(ostream *ofs, struct RESULT *mfista_result)
+{
+  struct PROF *prof = &(mfista_result->prof);
+  int k;
+
+  if(prof->n_fwd + prof->n_adj == 0) return;
+
+  *ofs << " Time per phase[sec]:\n\n";
+
+  for(k = 0; k < PROF_N; k++)
+    if(prof->time[k] > 0)
+      *ofs << prof_name[k] << prof->time[k] << endl;
+
+  *ofs << endl;
+  *ofs << " # of forward FFTs:      " << prof->n_fwd << endl;
+  *ofs << " # of adjoint FFTs:      " << prof->n_adj << endl;
+  if(mfista_result->ITER > 0)
+    *ofs << " trials per iteration:   "
+	 << (double)prof->n_trial/mfista_result->ITER << endl;
+  *ofs << endl;
+}
+
 void init_result(struct IO_FNAMES *mfista_io,
 		 struct RESULT *mfista_result)
 {
@@ -31,6 +78,15 @@ void init_result(struct IO_FNAMES *mfista_io,
   mfista_result->finalcost     = 0;
   mfista_result->comp_time     = 0;
   mfista_result->Lip_const     = 0;
+  mfista_result->ITER_float    = 0;
+  mfista_result->lambda_t      = 0;
+  mfista_result->tcost         = 0;
+  mfista_result->tv_aniso      = 0;
+  mfista_result->stop_rule     = -1;
+  mfista_result->M_raw         = 0;
+  mfista_result->M_cell        = 0;
+
+  memset(&(mfista_result->prof), 0, sizeof(struct PROF));
 }
 
 void cout_result(char *fname,
@@ -61,6 +117,9 @@ void cout_result(char *fname,
   if(mfista_result->nonneg == 1)
     cout << " x is nonnegative.\n\n";
 
+  if(mfista_result->lambda_tv != 0 && mfista_result->tv_aniso == 1)
+    cout << " TV is anisotropic.\n\n";
+
   if(mfista_result->lambda_l1 != 0)
     cout << " Lambda_1:               " << mfista_result->lambda_l1 << endl;
 
@@ -70,16 +129,27 @@ void cout_result(char *fname,
   if(mfista_result->lambda_tv != 0)
     cout << " Lambda_TV:              " << mfista_result->lambda_tv << endl;
 
+  if(mfista_result->lambda_t != 0)
+    cout << " Lambda_t:               " << mfista_result->lambda_t << endl;
+
   cout << " MAXITER:                " << mfista_result->maxiter << endl;
 
   cout << endl;
   cout << " Results:\n\n";
 
   cout << " # of iterations:        " << mfista_result->ITER << endl;
+  if(mfista_result->ITER_float != 0)
+    cout << " # of float iterations:  " << mfista_result->ITER_float << endl;
+  if(mfista_result->stop_rule >= STOP_MAXITER && mfista_result->stop_rule <= STOP_DEADLINE)
+    cout << " stopped by:             " << stop_rule_name[mfista_result->stop_rule] << endl;
   cout << " cost:                   " << mfista_result->finalcost << endl;
   cout << " computaion time[sec]:   " << mfista_result->comp_time << endl;
   cout << " Est. Lipschitzs const:  " << mfista_result->Lip_const << "\n\n";
 
+  if(mfista_result->M_cell > 0)
+    cout << " # of uv cells:          " << mfista_result->M_cell << " of "
+	 << mfista_result->M_raw << " visibilities ("
+	 << (double)mfista_result->M_raw/mfista_result->M_cell << " per cell)" << endl;
   cout << " # of nonzero pixels:    " << mfista_result->N_active << endl;
   cout << " Squared Error (SE):     " << mfista_result->sq_error << endl;
   cout << " Mean SE:                " << mfista_result->mean_sq_error << endl;
@@ -93,8 +163,13 @@ void cout_result(char *fname,
   if(mfista_result->lambda_tv != 0)
     cout << " TV cost:                " << mfista_result->tvcost << endl;
 
+  if(mfista_result->lambda_t != 0)
+    cout << " temporal cost:          " << mfista_result->tcost << endl;
+
   cout << endl;
 
+  write_prof(&cout, mfista_result);
+
 }
 
 void write_result(ostream *ofs, char *fname, struct IO_FNAMES *mfista_io,
@@ -124,6 +199,9 @@ void write_result(ostream *ofs, char *fname, struct IO_FNAMES *mfista_io,
   if(mfista_result->nonneg == 1)
     *ofs << " x is nonnegative.\n\n";
 
+  if(mfista_result->lambda_tv != 0 && mfista_result->tv_aniso == 1)
+    *ofs << " TV is anisotropic.\n\n";
+
   if(mfista_result->lambda_l1 != 0)
     *ofs << " Lambda_1:               " << mfista_result->lambda_l1 << endl;
 
@@ -133,16 +211,27 @@ void write_result(ostream *ofs, char *fname, struct IO_FNAMES *mfista_io,
   if(mfista_result->lambda_tv != 0)
     *ofs << " Lambda_TV:              " << mfista_result->lambda_tv << endl;
 
+  if(mfista_result->lambda_t != 0)
+    *ofs << " Lambda_t:               " << mfista_result->lambda_t << endl;
+
   *ofs << " MAXITER:                " << mfista_result->maxiter << endl;
 
   *ofs << endl;
   *ofs << " Results:\n\n";
 
   *ofs << " # of iterations:        " << mfista_result->ITER << endl;
+  if(mfista_result->ITER_float != 0)
+    *ofs << " # of float iterations:  " << mfista_result->ITER_float << endl;
+  if(mfista_result->stop_rule >= STOP_MAXITER && mfista_result->stop_rule <= STOP_DEADLINE)
+    *ofs << " stopped by:             " << stop_rule_name[mfista_result->stop_rule] << endl;
   *ofs << " cost:                   " << mfista_result->finalcost << endl;
   *ofs << " computaion time[sec]:   " << mfista_result->comp_time << endl;
   *ofs << " Est. Lipschitzs const:  " << mfista_result->Lip_const << "\n\n";
 
+  if(mfista_result->M_cell > 0)
+    *ofs << " # of uv cells:          " << mfista_result->M_cell << " of "
+	 << mfista_result->M_raw << " visibilities ("
+	 << (double)mfista_result->M_raw/mfista_result->M_cell << " per cell)" << endl;
   *ofs << " # of nonzero pixels:    " << mfista_result->N_active << endl;
   *ofs << " Squared Error (SE):     " << mfista_result->sq_error << endl;
   *ofs << " Mean SE:                " << mfista_result->mean_sq_error << endl;
@@ -156,7 +245,258 @@ void write_result(ostream *ofs, char *fname, struct IO_FNAMES *mfista_io,
   if(mfista_result->lambda_tv != 0)
     *ofs << " TV cost:                " << mfista_result->tvcost << endl;
 
+  if(mfista_result->lambda_t != 0)
+    *ofs << " temporal cost:          " << mfista_result->tcost << endl;
+
   *ofs << endl;
 
+  write_prof(ofs, mfista_result);
+
+}
+
+// Rows of the text data after the header. The file is mapped and the
+// rows are split at newlines into one chunk per thread (at least
+// READ_BYTES_PER_THREAD bytes each). Each chunk first counts its lines
+// to know its first row, then parses its numbers with from_chars into
+// the columns. Only the first M lines are read, as by the sscanf loop.
+
+#define READ_BYTES_PER_THREAD (1 << 22)
+
+static const char *skip_sep(const char *p, const char *end)
+{
+  while(p < end && (*p == ' ' || *p == ',' || *p == '\t' || *p == '+')) p++;
+  return(p);
+}
+
+template <typename T>
+static const char *parse_num(const char *p, const char *end, T *val)
+{
+  from_chars_result res;
+
+  p = skip_sep(p, end);
+  res = from_chars(p, end, *val);
+
+  return((res.ec == errc()) ? res.ptr : NULL);
+}
+
+template <typename T>
+static int parse_rows(const char *p, const char *end, int row, int M,
+		      T *u, T *v, double *vis_r, double *vis_i, double *vis_std)
+{
+  const char *eol;
+
+  for(; p < end && row < M; p = eol + 1, row++){
+    eol = (const char*) memchr(p, '\n', end - p);
+    if(eol == NULL) eol = end;
+
+    if((p = parse_num(p, eol, u+row))       == NULL ||
+       (p = parse_num(p, eol, v+row))       == NULL ||
+       (p = parse_num(p, eol, vis_r+row))   == NULL ||
+       (p = parse_num(p, eol, vis_i+row))   == NULL ||
+       (p = parse_num(p, eol, vis_std+row)) == NULL) return(1);
+  }
+
+  return(0);
+}
+
+static int count_lines(const char *p, const char *end)
+{
+  int n = 0;
+
+  while(p < end && (p = (const char*) memchr(p, '\n', end - p)) != NULL){
+    n++;
+    p++;
+  }
+
+  return(n);
+}
+
+template <typename T>
+static void read_rows(string fname, size_t offset, int M,
+		      T *u, T *v, double *vis_r, double *vis_i, double *vis_std)
+{
+  int w, fd, n_thread = 1, n_line = 0;
+  size_t len;
+  struct stat st;
+  const char *map, *body, *end;
+
+  fd = open(fname.data(), O_RDONLY);
+  if(fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < offset){
+    cerr << "Cannot open \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  map = (const char*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(map == MAP_FAILED){
+    cerr << "cannot map \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  body = map + offset;
+  end  = map + st.st_size;
+  len  = end - body;
+
+#ifdef PTHREAD
+  n_thread = len/READ_BYTES_PER_THREAD;
+  if(n_thread > THREAD_NUM) n_thread = THREAD_NUM;
+  if(n_thread < 1)          n_thread = 1;
+#endif
+
+  vector<const char*> start(n_thread+1);
+  vector<int> first(n_thread+1, 0), fail(n_thread, 0);
+
+  start[0] = body;
+  start[n_thread] = end;
+
+  for(w = 1; w < n_thread; w++){
+    start[w] = body + (len*w)/n_thread;
+    if(start[w] < start[w-1]) start[w] = start[w-1];
+    while(start[w] < end && start[w][-1] != '\n') start[w]++;
+  }
+
+  auto count = [&](int w){ first[w+1] = count_lines(start[w], start[w+1]); };
+  auto parse = [&](int w){ fail[w] = parse_rows(start[w], start[w+1], first[w], M,
+						u, v, vis_r, vis_i, vis_std); };
+
+#ifdef PTHREAD
+  vector<thread> workers;
+
+  for(w = 0; w < n_thread; w++) workers.push_back(thread(count, w));
+  for(w = 0; w < n_thread; w++) workers[w].join();
+#else
+  for(w = 0; w < n_thread; w++) count(w);
+#endif
+
+  // the last line may have no newline
+
+  if(len > 0 && end[-1] != '\n') first[n_thread]++;
+
+  for(w = 0; w < n_thread; w++) first[w+1] += first[w];
+  n_line = first[n_thread];
+
+#ifdef PTHREAD
+  workers.clear();
+
+  for(w = 0; w < n_thread; w++) workers.push_back(thread(parse, w));
+  for(w = 0; w < n_thread; w++) workers[w].join();
+#else
+  for(w = 0; w < n_thread; w++) parse(w);
+#endif
+
+  munmap((void*)map, st.st_size);
+
+  for(w = 0; w < n_thread; w++) if(fail[w]) n_line = -1;
+
+  if(n_line < M){
+    cerr << "cannot read data." << endl;
+    exit(0);
+  }
 }
 
+void read_fft_data(string fname, int *M, int *Nx, int *Ny,
+		   int **u_idx, int **v_idx,
+		   double **vis_r, double **vis_i, double **vis_std)
+{
+  size_t offset;
+  string buf_str;
+
+  // open a file
+  
+  ifstream fft_fs(fname.data());
+
+  if(fft_fs.fail()){
+    cerr << "Cannot open \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  // read data
+  
+  getline(fft_fs, buf_str);
+  if(sscanf(buf_str.data(), "M  = %d\n", M) != 1)  exit(0);
+
+  getline(fft_fs, buf_str);
+  if(sscanf(buf_str.data(), "NX = %d\n", Nx) != 1) exit(0);
+
+  getline(fft_fs, buf_str);
+  if(sscanf(buf_str.data(), "NY = %d\n", Ny) != 1) exit(0);
+
+  getline(fft_fs, buf_str);
+  if(sscanf(buf_str.data(), "\n") != 0)            exit(0);
+
+  getline(fft_fs, buf_str);
+  if(sscanf(buf_str.data(),
+	    "u, v, y_r, y_i, noise_std_dev\n") != 0) exit(0);
+
+  getline(fft_fs, buf_str);
+  if(sscanf(buf_str.data(), "\n") != 0)            exit(0);
+
+  // allocate vectors
+
+  *u_idx   = new int[*M];
+  *v_idx   = new int[*M];
+  *vis_r   = new double[*M];
+  *vis_i   = new double[*M];
+  *vis_std = new double[*M];
+
+  // read visibilities
+
+  offset = fft_fs.tellg();
+  fft_fs.close();
+
+  read_rows(fname, offset, *M, *u_idx, *v_idx, *vis_r, *vis_i, *vis_std);
+}
+
+void read_nufft_data(string fname, int *M, int *Nx, int *Ny,
+		     double **u_dx, double **v_dy,
+		     double **vis_r, double **vis_i, double **vis_std)
+{
+  size_t offset;
+  string buf_str;
+
+  // open a file
+  
+  ifstream nufft_fs(fname.data());
+
+  if(nufft_fs.fail()){
+    cerr << "Cannot open \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  // read data
+
+  getline(nufft_fs, buf_str);
+  if(sscanf(buf_str.data(), "M  = %d\n", M) != 1)  exit(0);
+
+  getline(nufft_fs, buf_str);  
+  if(sscanf(buf_str.data(), "NX = %d\n", Nx) != 1) exit(0);
+
+  getline(nufft_fs, buf_str);  
+  if(sscanf(buf_str.data(), "NY = %d\n", Ny) != 1) exit(0);
+
+  getline(nufft_fs, buf_str);  
+  if(sscanf(buf_str.data(), "\n") != 0)            exit(0);
+
+  getline(nufft_fs, buf_str);  
+  if(sscanf(buf_str.data(),
+	     "u_rad, v_rad, vis_r, vis_i, noise_std_dev\n") != 0) exit(0);
+
+  getline(nufft_fs, buf_str);  
+  if(sscanf(buf_str.data(), "\n") != 0)            exit(0);
+
+  // allocate vectors
+  
+  *u_dx    = new double[*M];
+  *v_dy    = new double[*M];
+  *vis_r   = new double[*M];
+  *vis_i   = new double[*M];
+  *vis_std = new double[*M];
+
+  // read visibilities
+
+  offset = nufft_fs.tellg();
+  nufft_fs.close();
+
+  read_rows(fname, offset, *M, *u_dx, *v_dy, *vis_r, *vis_i, *vis_std);
+}
@@ -0,0 +1,222 @@
+#include "mfista.hpp"
+#include <iomanip>
+
+// mfista_lbfgs_lib
+//
+// For lambda_l1 = 0 the cost
+//
+//   F(x) + lambda_tsv TSV(x),   x >= 0 (nonneg), x = 0 outside the box
+//
+// is smooth with simple bounds, and a limited memory quasi-Newton
+// method needs far fewer iterations than MFISTA. The bounds are handled
+// by the projected L-BFGS (two-metric projection, Bertsekas 1982, SIAM
+// J. Control Optim. 20, 221): variables on a bound with the gradient
+// pushing outward are fixed, the L-BFGS direction is computed for the
+// free variables, and the step P(x + t d) is backtracked until the
+// Armijo condition holds. The initial Hessian of the two-loop recursion
+// is the given preconditioner if any (the FFT engine has one diagonal
+// in the Fourier domain), else 1/c with c the curvature y'y/s'y of the
+// last pair (initially the given c).
+//
+// The trace reports c as that curvature and trials as the number of
+// backtracking steps; restart is 1 when the memory was cleared.
+
+// two-loop recursion d = -H g
+
+static void lbfgs_direction(VectorXd &dvec, VectorXd &gvec,
+			    vector<VectorXd> &svec, vector<VectorXd> &yvec,
+			    vector<double> &rho, int m, int head, double c,
+			    function<void(VectorXd&)> &precond)
+{
+  int k, l, n = (int)svec.size();
+  double beta;
+  VectorXd alpha(n);
+
+  dvec = -gvec;
+
+  for(k = 0; k < m; ++k){
+    l = (head - 1 - k + n) % n;
+    alpha(l) = rho[l]*svec[l].dot(dvec);
+    dvec -= alpha(l)*yvec[l];
+  }
+
+  if(precond) precond(dvec);
+  else        dvec /= c;
+
+  for(k = m-1; k >= 0; --k){
+    l = (head - 1 - k + n) % n;
+    beta = rho[l]*yvec[l].dot(dvec);
+    dvec += (alpha(l) - beta)*svec[l];
+  }
+}
+
+int TSV_lbfgs_box(VectorXd &xvec, int Nx, int Ny, int maxiter, double eps,
+		  double lambda_tsv, int nonneg_flag, int box_flag, VectorXd &box,
+		  function<double(VectorXd&, VectorXd&)> F_dF,
+		  function<void(VectorXd&)> precond,
+		  double c, struct MFISTA_OPT *mfista_opt,
+		  struct RESULT *mfista_result)
+{
+  int NN = Nx*Ny, i, iter, ls = 0, m = 0, head = 0, restart = 0,
+    verbose = mfista_opt->verbose, stop = STOP_MAXITER;
+  double costtmp, Fval, t, gd, sy, Fpart = 0, tsvpart = 0, datacost, tsvcost;
+
+  VectorXd cost, dfdx, gvec, gnew, pgvec, dvec, xnew, dtmp, outside, buf_diff;
+  vector<VectorXd> svec(LBFGSM, VectorXd::Zero(NN)), yvec(LBFGSM, VectorXd::Zero(NN));
+  vector<double> rho(LBFGSM, 0);
+  struct MFISTA_TRACE *trace;
+
+  cost     = VectorXd::Zero(maxiter);
+  dfdx     = VectorXd::Zero(NN);
+  gnew     = VectorXd::Zero(NN);
+  pgvec    = VectorXd::Zero(NN);
+  dvec     = VectorXd::Zero(NN);
+  dtmp     = VectorXd::Zero(NN);
+  outside  = VectorXd::Zero(NN);
+  buf_diff = VectorXd::Zero(Nx-1);
+
+  // pixels outside of the box stay at 0
+
+  if(box_flag == 1)
+    for(i = 0; i < NN; ++i) outside(i) = (box(i) == 0);
+
+  auto project = [&](VectorXd &x){
+    if(nonneg_flag == 1) x = x.cwiseMax(0);
+    if(box_flag == 1)    x = x.array()*(1-outside.array());
+  };
+
+  // cost and gradient (not the negative gradient as in dF_dx_*); the
+  // two terms of the cost are kept in Fpart and tsvpart for the trace
+
+  auto f_grad = [&](VectorXd &x, VectorXd &g){
+    Fpart   = F_dF(x, dfdx);
+    tsvpart = 0;
+
+    g = -dfdx;
+
+    if(lambda_tsv > 0){
+      tsvpart = TSV(Nx, Ny, x, buf_diff);
+      d_TSV(dtmp, Nx, Ny, x);
+      g += lambda_tsv*dtmp;
+    }
+    return(Fpart + lambda_tsv*tsvpart);
+  };
+
+  if(verbose){
+    cout << "computing image with L-BFGS (lambda_l1 = 0)." << endl;
+    cout << "stop if iter = " << maxiter << ", or Delta_cost < " << eps << endl;
+  }
+
+  project(xvec);
+  costtmp  = f_grad(xvec, gvec);
+  datacost = Fpart;
+  tsvcost  = tsvpart;
+
+  trace = trace_open(mfista_opt, "TSV_lbfgs", 1);
+
+  for(iter = 0; iter < maxiter; iter++){
+
+    cost(iter) = costtmp;
+
+    trace_iter(trace, iter+1, costtmp, datacost, 0, "tsv", tsvcost, c, ls+1, restart);
+    restart = 0;
+
+    if(verbose && (iter % 10) == 0)
+      cout << iter+1 << " cost = " << fixed << setprecision(5)
+	   << cost(iter) << endl;
+
+    if((iter>=LBFGSTD) && (cost(iter-LBFGSTD)-cost(iter) < eps)){
+      stop = STOP_COST;
+      break;
+    }
+
+    // projected gradient on the free variables
+
+    pgvec = gvec;
+    for(i = 0; i < NN; ++i)
+      if(outside(i) != 0 || (nonneg_flag == 1 && xvec(i) <= 0 && gvec(i) > 0))
+	pgvec(i) = 0;
+
+    if(pgvec.squaredNorm() == 0){
+      stop = STOP_COST;
+      break;
+    }
+
+    // time budget: the iterations decrease the cost, xvec is the best
+
+    if((iter % DEADLINEITER) == 0 && past_deadline(mfista_opt)){
+      stop = STOP_DEADLINE;
+      break;
+    }
+
+    // direction
+
+    lbfgs_direction(dvec, pgvec, svec, yvec, rho, m, head, c, precond);
+    for(i = 0; i < NN; ++i) if(pgvec(i) == 0) dvec(i) = 0;
+
+    if(pgvec.dot(dvec) >= 0){
+      m = 0;
+      restart = 1;
+      dvec = -pgvec/c;
+    }
+
+    // backtracking
+
+    for(t = 1, ls = 0; ls < LBFGSLS; ++ls, t /= 2){
+      xnew = xvec + t*dvec;
+      project(xnew);
+
+      Fval = f_grad(xnew, gnew);
+      gd   = gvec.dot(xnew - xvec);
+
+      if(Fval <= costtmp + LBFGSARMIJO*gd) break;
+    }
+
+    if(ls == LBFGSLS){
+      if(m == 0){
+	stop = STOP_COST;
+	break;
+      }
+
+      // restart from the gradient step
+      m = 0;
+      restart = 1;
+      continue;
+    }
+
+    // memory
+
+    svec[head] = xnew - xvec;
+    yvec[head] = gnew - gvec;
+    sy = svec[head].dot(yvec[head]);
+
+    if(sy > EPS*EPS*yvec[head].squaredNorm()){
+      c = yvec[head].squaredNorm()/sy;
+      rho[head] = 1/sy;
+      head = (head+1) % LBFGSM;
+      if(m < LBFGSM) ++m;
+    }
+
+    xvec.swap(xnew);
+    gvec.swap(gnew);
+    costtmp  = Fval;
+    datacost = Fpart;
+    tsvcost  = tsvpart;
+  }
+
+  if(iter == maxiter) iter = iter-1;
+
+  cost(iter) = costtmp;
+
+  trace_close(trace, stop, iter+1);
+
+  mfista_result->stop_rule = stop;
+
+  if(verbose){
+    cout << iter+1 << " cost = " << cost(iter) << endl;
+    cout << endl;
+    cout << resetiosflags(ios_base::floatfield);
+  }
+
+  return(iter);
+}
@@ -0,0 +1,230 @@
+#include "mfista.hpp"
+#include <iomanip>
+
+// mfista_newton_lib
+//
+// Newton polish of L1+TSV after a MFISTA warm-up. One iteration is
+//
+//   1. a proximal gradient step z = P(x - grad f(x)/c) with the usual
+//      backtracking of c, which fixes the support S and the signs s,
+//   2. the Newton system on S,
+//
+//        (A'A + 2 lambda_tsv L)_SS d = -(grad f(z) + lambda_l1 s)_S,
+//
+//      solved by CG with Hessian-vector products through the transforms
+//      (A'A v = grad F(v) - grad F(0)) and the TSV stencil,
+//   3. a backtracking line search on z + t d, where entries changing the
+//      sign (or leaving x >= 0) are set to 0.
+//
+// Once the support is identified the steps are Newton steps on a smooth
+// problem and the convergence is superlinear.
+//
+// iter_start is the number of the first Newton iteration in the trace,
+// which continues that of the warm-up.
+
+int L1_TSV_newton(VectorXd &xvec, int Nx, int Ny, int maxiter, double eps,
+		  double lambda_l1, double lambda_tsv,
+		  int nonneg_flag, int box_flag, VectorXd &box,
+		  function<double(VectorXd&, VectorXd&)> F_dF,
+		  double *cinit, int iter_start, struct MFISTA_OPT *mfista_opt,
+		  struct RESULT *mfista_result)
+{
+  int NN = Nx*Ny, i, iter, k, ls, n_cg = 0, trials = 1,
+    verbose = mfista_opt->verbose, stop = STOP_MAXITER;
+  double c = *cinit, Fx, Fz, Fval, Qval, costtmp, phi, rr, rr_new, alpha, tol, slope, t,
+    Fpart = 0, tsvpart = 0, datacost, tsvcost, zdata, ztsv;
+
+  VectorXd cost, dfdx, dfdx0, gvec, gtmp, zvec, xtmp, sgn, rvec, pvec, hvec, dvec, dtmp, buf_diff;
+
+  struct MFISTA_TRACE *trace;
+
+  void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
+
+  if(nonneg_flag == 1) soft_th_box = soft_threshold_nonneg_box;
+  else                 soft_th_box = soft_threshold_box;
+
+  cost     = VectorXd::Zero(maxiter);
+  dfdx     = VectorXd::Zero(NN);
+  dfdx0    = VectorXd::Zero(NN);
+  gvec     = VectorXd::Zero(NN);
+  gtmp     = VectorXd::Zero(NN);
+  zvec     = VectorXd::Zero(NN);
+  xtmp     = VectorXd::Zero(NN);
+  sgn      = VectorXd::Zero(NN);
+  dvec     = VectorXd::Zero(NN);
+  dtmp     = VectorXd::Zero(NN);
+  buf_diff = VectorXd::Zero(Nx-1);
+
+  // f = F + lambda_tsv TSV and its gradient; F and TSV are kept in
+  // Fpart and tsvpart for the trace
+
+  auto f_grad = [&](VectorXd &x, VectorXd &g){
+    Fpart   = F_dF(x, dfdx);
+    tsvpart = 0;
+
+    g = -dfdx;
+
+    if(lambda_tsv > 0){
+      tsvpart = TSV(Nx, Ny, x, buf_diff);
+      d_TSV(dtmp, Nx, Ny, x);
+      g += lambda_tsv*dtmp;
+    }
+    return(Fpart + lambda_tsv*tsvpart);
+  };
+
+  // (A'A + 2 lambda_tsv L) v on the support
+
+  auto hess = [&](VectorXd &v, VectorXd &hv){
+    F_dF(v, dfdx);
+
+    hv = dfdx0 - dfdx;
+
+    if(lambda_tsv > 0){
+      d_TSV(dtmp, Nx, Ny, v);
+      hv += lambda_tsv*dtmp;
+    }
+    hv.array() *= sgn.array().abs();
+  };
+
+  xtmp = VectorXd::Zero(NN);
+  F_dF(xtmp, dfdx0);
+
+  if(verbose){
+    cout << "polishing image with Newton-CG." << endl;
+    cout << "stop if iter = " << maxiter << ", or Delta_cost < " << eps << endl;
+  }
+
+  Fx = f_grad(xvec, gvec);
+  costtmp  = Fx + lambda_l1*xvec.lpNorm<1>();
+  datacost = Fpart;
+  tsvcost  = tsvpart;
+
+  trace = trace_open(mfista_opt, "L1_TSV_newton", iter_start);
+
+  for(iter = 0; iter < maxiter; iter++){
+
+    cost(iter) = costtmp;
+
+    trace_iter(trace, iter_start+iter, costtmp, datacost, xvec.lpNorm<1>(),
+	       "tsv", tsvcost, c, trials, 0);
+
+    if(verbose)
+      cout << iter+1 << " cost = " << fixed << setprecision(5)
+	   << cost(iter) << ", c = " << c << endl;
+
+    if((iter>=1) && (cost(iter-1)-cost(iter) < eps)){
+      stop = STOP_COST;
+      break;
+    }
+
+    // time budget, checked every iteration since one runs up to NEWTONCG
+    // Hessian products
+
+    if(past_deadline(mfista_opt)){
+      stop = STOP_DEADLINE;
+      break;
+    }
+
+    // proximal gradient step
+
+    for(k = 0; k < maxiter; k++){
+      xtmp = xvec - gvec/c;
+      soft_th_box(zvec, xtmp, lambda_l1/c, box_flag, box);
+
+      Fval = F_dF(zvec, dfdx);
+      if(lambda_tsv > 0) Fval += lambda_tsv*TSV(Nx, Ny, zvec, buf_diff);
+
+      xtmp = zvec - xvec;
+      Qval = Fx + gvec.dot(xtmp) + c*xtmp.squaredNorm()/2;
+
+      if(Fval<=Qval) break;
+
+      c *= ETA;
+    }
+
+    c /= ETA;
+    trials = k+1;
+
+    // support and signs
+
+    for(i = 0; i < NN; i++)
+      sgn(i) = (zvec(i) > 0) ? 1 : ((zvec(i) < 0) ? -1 : 0);
+
+    Fz    = f_grad(zvec, gvec);
+    phi   = Fz + lambda_l1*zvec.lpNorm<1>();
+    zdata = Fpart;
+    ztsv  = tsvpart;
+
+    // CG for the Newton direction
+
+    rvec = -(gvec + lambda_l1*sgn);
+    rvec.array() *= sgn.array().abs();
+
+    dvec = VectorXd::Zero(NN);
+    pvec = rvec;
+    rr   = rvec.squaredNorm();
+    tol  = rr*min(NEWTONCGTOL*NEWTONCGTOL, rr);
+
+    for(k = 0; k < NEWTONCG && rr > tol; k++){
+      hess(pvec, hvec);
+
+      alpha = rr/pvec.dot(hvec);
+      if(!(alpha > 0)) break;
+
+      dvec += alpha*pvec;
+      rvec -= alpha*hvec;
+
+      rr_new = rvec.squaredNorm();
+      pvec   = rvec + (rr_new/rr)*pvec;
+      rr     = rr_new;
+    }
+
+    n_cg += k;
+
+    // line search keeping the signs
+
+    slope = -(gvec + lambda_l1*sgn).dot(dvec);
+
+    xvec     = zvec;
+    Fx       = Fz;
+    costtmp  = phi;
+    datacost = zdata;
+    tsvcost  = ztsv;
+
+    for(t = 1, ls = 0; ls < NEWTONLS && slope > 0; ++ls, t /= 2){
+      xtmp = zvec + t*dvec;
+
+      for(i = 0; i < NN; i++)
+	if(xtmp(i)*sgn(i) <= 0) xtmp(i) = 0;
+
+      Fval = f_grad(xtmp, gtmp);
+
+      if(Fval + lambda_l1*xtmp.lpNorm<1>() <= phi - NEWTONARMIJO*t*slope){
+	xvec.swap(xtmp);
+	gvec.swap(gtmp);
+	Fx       = Fval;
+	costtmp  = Fval + lambda_l1*xvec.lpNorm<1>();
+	datacost = Fpart;
+	tsvcost  = tsvpart;
+	break;
+      }
+    }
+  }
+
+  if(iter == maxiter) iter = iter-1;
+
+  trace_close(trace, stop, iter_start+iter);
+
+  mfista_result->stop_rule = stop;
+
+  if(verbose){
+    cout << iter+1 << " cost = " << cost(iter)
+	 << ", CG iterations = " << n_cg << endl;
+    cout << endl;
+    cout << resetiosflags(ios_base::floatfield);
+  }
+
+  *cinit = c;
+
+  return(iter);
+}
@@ -0,0 +1,636 @@
+#include "mfista.hpp"
+#include <iomanip>
+
+// mfista_nufft_batch_lib
+//
+// K images (e.g. Stokes I/Q/U/V) sharing one uv coverage are solved
+// together. The gridding tables are computed once, the K transforms are
+// done with one fftw_plan_many_dft plan, and every kernel weight read
+// from E2x/E2y is applied to all K value streams before moving on.
+//
+// Visibilities, noise, and images are stored stream by stream:
+// vis_r[s*M + k], xinit[s*Nx*Ny + i].
+//
+// The batch runs plain MFISTA for L1+TSV. Problems it does not cover
+// (TV, L-BFGS for lambda_l1 = 0, and the options of MFISTA_OPT other
+// than verbose) are solved image by image with mfista_imaging_core_nufft_opt.
+
+void NUFFT2d1_batch(vector<VectorXd> &Xout,
+		    VectorXd &E1, MatrixXd &E2x, MatrixXd &E2y,
+		    MatrixXd &E4mat, VectorXi &mx, VectorXi &my,
+		    fftw_complex *in, double *out, fftw_plan *fftwplan_c2r,
+		    MatrixXcd &Fin)
+{
+  int K, M, Nx, Ny, Mrx, Mry, Mh, MMh, MM4, j, k, s, lx, ly, idx, idy, sign, offset;
+  double MM, wy, w;
+  complex<double> tmpc;
+  VectorXcd v0;
+
+  K  = Fin.rows();
+  M  = E1.size();
+  Nx = E4mat.rows();
+  Ny = E4mat.cols();
+
+  Mrx = 2*Nx;
+  Mh  = Ny + 1;
+  Mry = 2*Ny;
+  MMh = Mrx*Mh;
+  MM4 = Mrx*Mry;
+  MM  = (double)(Mrx*Mry);
+
+  v0 = VectorXcd::Zero(K);
+
+  for(j = 0; j < K*MMh; j++){
+    in[j][0] = 0;
+    in[j][1] = 0;
+  }
+
+  for(k = 0; k < M; k++){
+
+    for(s = 0; s < K; s++){
+      if(NU_SIGN == 1) v0(s) = E1(k)*Fin(s, k);
+      else             v0(s) = E1(k)*conj(Fin(s, k));
+    }
+
+    for(ly = 0; ly < 2*MSP; ly++){
+
+      wy = E2y(k, ly)/2.0;
+
+      for(sign = -1; sign < 2; sign +=2){
+	idy = idx_fftw(sign*(my(k)+ly-MSP+1),Mry);
+
+	if(idy < (Ny+1))
+	  for(lx = 0; lx < 2*MSP; lx++){
+	    idx = idx_fftw(sign*(mx(k)+lx-MSP+1),Mrx);
+	    w = wy*E2x(k,lx);
+
+	    for(s = 0, offset = idx*Mh + idy; s < K; s++, offset += MMh){
+	      tmpc = v0(s)*w;
+	      in[offset][0] += real(tmpc);
+	      in[offset][1] += sign*imag(tmpc);
+	    }
+	  }
+      }
+    }
+  }
+
+  fftw_execute(*fftwplan_c2r);
+
+  for(s = 0; s < K; s++)
+    for(k = 0; k < Nx; k++){
+      idx = m2mr(k,Nx);
+      for(j = 0; j < Ny; j++){
+	idy = m2mr(j,Ny);
+	Xout[s](k*Ny + j) = out[s*MM4 + idx*Mry + idy]*E4mat(k,j)/MM;
+      }
+    }
+}
+
+void NUFFT2d2_batch(MatrixXcd &Fout, VectorXd &E1,
+		    MatrixXd &E2x, MatrixXd &E2y,
+		    MatrixXd &E4mat, VectorXi &mx, VectorXi &my,
+		    double *in, fftw_complex *out, fftw_plan *fftwplan_r2c,
+		    vector<VectorXd> &Xin)
+{
+  int K, M, Nx, Ny, Mrx, Mry, Mh, MMh, MM4, i, j, k, s, lx, ly, idx, idy, sign, offset;
+  double tmp, MM, f_r;
+
+  K  = Fout.rows();
+  M  = E1.size();
+  Nx = E4mat.rows();
+  Ny = E4mat.cols();
+
+  Mrx = 2*Nx;
+  Mry = 2*Ny;
+  Mh  = Ny+1;
+  MMh = Mrx*Mh;
+  MM4 = Mrx*Mry;
+  MM  = (double)Mrx*Mry;
+
+  Fout.setZero();
+
+  for(i = 0; i < K*MM4; i++) in[i] = 0;
+
+  for(s = 0; s < K; s++)
+    for(i = 0; i < Nx; i++){
+      idx = m2mr(i,Nx);
+      for(j = 0; j < Ny; j++){
+	idy = m2mr(j,Ny);
+	in[s*MM4 + idx*Mry + idy] = Xin[s](i*Ny + j)*E4mat(i,j);
+      }
+    }
+
+  fftw_execute(*fftwplan_r2c);
+
+  for(k = 0; k < M; k++){
+    for(ly = 0; ly < 2*MSP; ly++){
+
+      idy = -1;
+
+      j = idx_fftw((my(k)+ly-MSP+1),Mry);
+      if(j < (Ny+1)){
+	idy = j;
+	sign = 1;
+      }
+      else{
+	j = idx_fftw(-(my(k)+ly-MSP+1),Mry);
+	if(j < (Ny+1)){
+	  idy = j;
+	  sign = -1;
+	}
+      }
+
+      if( idy >= 0){
+	f_r = E1(k)*E2y(k,ly)/MM;
+	for(lx = 0; lx < 2*MSP; lx++){
+
+	  idx = idx_fftw(sign*(mx(k)+lx-MSP+1),Mrx);
+	  tmp = f_r*E2x(k,lx);
+
+	  for(s = 0, offset = idx*Mh + idy; s < K; s++, offset += MMh)
+	    Fout(s, k) += complex<double>
+	      (out[offset][0], sign*(NU_SIGN)*out[offset][1])*tmp;
+	}
+      }
+    }
+  }
+}
+
+void calc_F_part_nufft_batch(VectorXd &Fval, MatrixXcd &yAx,
+			     VectorXd &E1,
+			     MatrixXd &E2x, MatrixXd &E2y,
+			     MatrixXd &E4mat, VectorXi &mx, VectorXi &my,
+			     double *in_r, fftw_complex *out_c,
+			     fftw_plan *fftwplan_r2c,
+			     MatrixXcd &vis, MatrixXd &weight, vector<VectorXd> &xvec)
+{
+  NUFFT2d2_batch(yAx, E1, E2x, E2y, E4mat, mx, my,
+		 in_r, out_c, fftwplan_r2c, xvec);
+
+  yAx = (vis.array() - yAx.array())*weight.array();
+
+  Fval = yAx.rowwise().squaredNorm()/2;
+}
+
+void dF_dx_nufft_batch(vector<VectorXd> &dFdx,
+		       VectorXd &E1, MatrixXd &E2x, MatrixXd &E2y,
+		       MatrixXd &E4mat,
+		       VectorXi &mx, VectorXi &my,
+		       fftw_complex *in_c, double *out_r, fftw_plan *fftwplan_c2r,
+		       MatrixXd &weight, MatrixXcd &yAx)
+{
+  yAx.array() *= weight.array();
+
+  NUFFT2d1_batch(dFdx, E1, E2x, E2y, E4mat, mx, my,
+		 in_c, out_r, fftwplan_c2r, yAx);
+}
+
+/* TSV */
+
+void mfista_L1_TSV_core_nufft_batch(double *xout, int K,
+				    int M, int Nx, int Ny, double *u_dx, double *v_dy,
+				    int maxiter, double *eps,
+				    double *vis_r, double *vis_i, double *vis_std,
+				    double lambda_l1, double lambda_tsv,
+				    double *cinit, double *xinit, int *iter_out, int *stop_out,
+				    int nonneg_flag, int box_flag, float *cl_box, int verbose)
+{
+  void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
+
+  int NN = Nx*Ny, MMh = 2*Nx*(Ny+1), n[2] = {2*Nx, 2*Ny},
+    i, s, iter, n_active, n_pending;
+  double Qval, tmpa, tmpb, l1cost, *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_c2r, fftwplan_r2c;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  VectorXi mx, my, active, pending;
+  VectorXd E1, box, u, v, buf_diff, dtmp,
+    c, mu, munew, costtmp, Qcore, Fval, Ftmp;
+  MatrixXd E2x, E2y, E4mat, cost, weight;
+  MatrixXcd yAx, vis;
+  vector<VectorXd> xvec(K), zvec(K), xnew(K), xtmp(K), dfdx(K);
+
+  if(verbose) cout << "Memory allocation and preparations for " << K << " images." << endl << endl;
+
+  mx    = VectorXi::Zero(M);
+  my    = VectorXi::Zero(M);
+  E1    = VectorXd::Zero(M);
+  E2x   = MatrixXd::Zero(M,2*MSP);
+  E2y   = MatrixXd::Zero(M,2*MSP);
+  E4mat = MatrixXd::Zero(Nx,Ny);
+
+  cost    = MatrixXd::Zero(maxiter, K);
+  dtmp    = VectorXd::Zero(NN);
+  box     = VectorXd::Zero(NN);
+  c       = VectorXd::Zero(K);
+  mu      = VectorXd::Ones(K);
+  munew   = VectorXd::Zero(K);
+  costtmp = VectorXd::Zero(K);
+  Qcore   = VectorXd::Zero(K);
+  Fval    = VectorXd::Zero(K);
+  Ftmp    = VectorXd::Zero(K);
+  active  = VectorXi::Ones(K);
+  pending = VectorXi::Zero(K);
+
+  yAx    = MatrixXcd::Zero(K, M);
+  vis    = MatrixXcd::Zero(K, M);
+  weight = MatrixXd::Zero(K, M);
+
+  buf_diff = VectorXd::Zero(Nx-1);
+
+  u = Map<VectorXd>(u_dx,M);
+  v = Map<VectorXd>(v_dy,M);
+
+  for(s = 0; s < K; s++){
+    xvec[s] = Map<VectorXd>(xinit + s*NN, NN);
+    zvec[s] = xvec[s];
+    xnew[s] = VectorXd::Zero(NN);
+    xtmp[s] = VectorXd::Zero(NN);
+    dfdx[s] = VectorXd::Zero(NN);
+    c(s)    = cinit[s];
+  }
+
+  if(box_flag == 1){
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+  }
+  else box = VectorXd::Zero(NN);
+
+  for(s = 0; s < K; s++)
+    for(i = 0; i < M; i++){
+      vis(s, i)    = complex<double>(vis_r[s*M + i], vis_i[s*M + i]);
+      weight(s, i) = 1/vis_std[s*M + i];
+    }
+
+  if(verbose) cout << "Preparation for FFT." << endl;
+
+  // one set of gridding tables for all the images
+
+  preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);
+
+  // K transforms with one plan
+
+  rvec  = (double*) fftw_malloc(K*4*NN*sizeof(double));
+  cvec  = (fftw_complex*) fftw_malloc(K*MMh*sizeof(fftw_complex));
+
+  for(i = 0; i< K*MMh; i++) {cvec[i][0]=0;cvec[i][1]=0;}
+  for(i = 0; i< K*4*NN; i++){rvec[i]=0;}
+
+  fftwplan_c2r = fftw_plan_many_dft_c2r(2, n, K, cvec, NULL, 1, MMh,
+					rvec, NULL, 1, 4*NN, fftw_plan_flag);
+  fftwplan_r2c = fftw_plan_many_dft_r2c(2, n, K, rvec, NULL, 1, 4*NN,
+					cvec, NULL, 1, MMh, fftw_plan_flag);
+
+  // initialization
+
+  if(nonneg_flag == 0)
+    soft_th_box =soft_threshold_box;
+  else if(nonneg_flag == 1)
+    soft_th_box =soft_threshold_nonneg_box;
+  else {
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return;
+  }
+
+  if(verbose){
+    cout << "Done." << endl;
+
+    cout << "computing " << K << " images with MFISTA with NUFFT." << endl;
+    cout << "stop if iter = " << maxiter << " or Delta_cost < eps for every image" << endl;
+  }
+
+  // main
+
+  calc_F_part_nufft_batch(costtmp, yAx, E1, E2x, E2y, E4mat, mx, my,
+			  rvec, cvec, &fftwplan_r2c, vis, weight, xvec);
+
+  for(s = 0; s < K; s++){
+    costtmp(s) += lambda_l1*xvec[s].lpNorm<1>();
+
+    if( lambda_tsv > 0 )
+      costtmp(s) += lambda_tsv*TSV(Nx, Ny, xvec[s], buf_diff);
+  }
+
+  for(iter = 0; iter < maxiter; iter++){
+
+    // converged images keep their last cost and stay in the batch
+    cost.row(iter) = costtmp.transpose();
+
+    if(verbose && (iter % 10) == 0){
+      cout << iter+1 << " cost =" << fixed << setprecision(5);
+      for(s = 0; s < K; s++) cout << " " << cost(iter, s);
+      cout << endl;
+    }
+
+    calc_F_part_nufft_batch(Qcore, yAx, E1, E2x, E2y, E4mat, mx, my,
+			    rvec, cvec, &fftwplan_r2c, vis, weight, zvec);
+
+    dF_dx_nufft_batch(dfdx, E1, E2x, E2y, E4mat, mx, my,
+		      cvec, rvec, &fftwplan_c2r, weight, yAx);
+
+    if( lambda_tsv > 0.0 ){
+      for(s = 0; s < K; s++){
+	Qcore(s) += lambda_tsv*TSV(Nx, Ny, zvec[s], buf_diff);
+
+	d_TSV(dtmp, Nx, Ny, zvec[s]);
+	dfdx[s].array() -= lambda_tsv*dtmp.array();
+      }
+    }
+
+    // backtracking for every active image, sharing the transforms
+
+    pending = active;
+
+    for(i = 0; i < maxiter; i++){
+
+      for(s = 0; s < K; s++){
+	if(pending(s) == 0) continue;
+
+	xtmp[s].array() = zvec[s].array() + dfdx[s].array()/c(s);
+	soft_th_box(xnew[s], xtmp[s], lambda_l1/c(s), box_flag, box);
+      }
+
+      calc_F_part_nufft_batch(Ftmp, yAx, E1, E2x, E2y, E4mat, mx, my,
+			      rvec, cvec, &fftwplan_r2c, vis, weight, xnew);
+
+      for(n_pending = 0, s = 0; s < K; s++){
+	if(pending(s) == 0) continue;
+
+	Fval(s) = Ftmp(s);
+
+	if( lambda_tsv > 0.0 )
+	  Fval(s) += lambda_tsv*TSV(Nx, Ny, xnew[s], buf_diff);
+
+	Qval = calc_Q_part(xnew[s], zvec[s], c(s), dfdx[s], xtmp[s]);
+	Qval += Qcore(s);
+
+	if(Fval(s)<=Qval) pending(s) = 0;
+	else{
+	  c(s) *= ETA;
+	  n_pending++;
+	}
+      }
+
+      if(n_pending == 0) break;
+    }
+
+    for(n_active = 0, s = 0; s < K; s++){
+      if(active(s) == 0) continue;
+
+      c(s) /= ETA;
+
+      munew(s) = (1+sqrt(1+4*mu(s)*mu(s)))/2;
+
+      l1cost = xnew[s].lpNorm<1>();
+      Fval(s) += lambda_l1*l1cost;
+
+      zvec[s] = xvec[s];
+
+      if(Fval(s) < cost(iter, s)){
+
+	costtmp(s) = Fval(s);
+
+	tmpa = 1+((mu(s)-1)/munew(s));
+	tmpb = ((1-mu(s))/munew(s));
+
+	zvec[s].array() = tmpa * xnew[s].array() + tmpb * zvec[s].array();
+
+	xvec[s] = xnew[s];
+      }
+      else{
+
+	tmpa = mu(s)/munew(s);
+	tmpb = 1-(mu(s)/munew(s));
+
+	zvec[s].array() = tmpa * xnew[s].array() + tmpb * zvec[s].array();
+
+	// another stopping rule
+	if((iter>1) && (xvec[s].lpNorm<1>() == 0)){
+	  active(s)   = 0;
+	  stop_out[s] = STOP_ZERO;
+	}
+      }
+
+      if(active(s) == 1 && (iter>=MINITER) && ((cost(iter-TD, s)-cost(iter, s))< eps[s] )){
+	active(s)   = 0;
+	stop_out[s] = STOP_COST;
+      }
+
+      mu(s) = munew(s);
+
+      if(active(s) == 0){
+	// freeze the image; it stays in the batched transforms unchanged
+	zvec[s]     = xvec[s];
+	iter_out[s] = iter+1;
+	if(verbose)
+	  cout << iter+1 << " image " << s << " converged, cost = " << cost(iter, s) << endl;
+      }
+      else n_active++;
+    }
+
+    if(n_active == 0) break;
+  }
+
+  for(s = 0; s < K; s++){
+    if(active(s) == 1){
+      iter_out[s] = maxiter;
+      stop_out[s] = STOP_MAXITER;
+    }
+
+    cinit[s] = c(s);
+
+    for(i = 0; i < NN; i++) xout[s*NN + i] = xvec[s](i);
+  }
+
+  if(verbose) cout << endl;
+
+  // free memory
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan_c2r);
+  fftw_destroy_plan(fftwplan_r2c);
+
+  fftw_cleanup();
+
+  cout << resetiosflags(ios_base::floatfield);
+}
+
+/* results */
+
+void calc_result_nufft_batch(struct RESULT *mfista_result, int K,
+			     int M, int Nx, int Ny, double *u_dx, double *v_dy,
+			     double *vis_r, double *vis_i, double *vis_std,
+			     double lambda_l1, double lambda_tv, double lambda_tsv,
+			     double *xout)
+{
+  int i, s, NN = Nx*Ny, MMh = 2*Nx*(Ny+1), n[2] = {2*Nx, 2*Ny};
+  double tmp, *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_r2c;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  VectorXi mx, my;
+  VectorXd E1, Fval, u, v, buf_diff;
+  MatrixXd E2x, E2y, E4mat, weight;
+  MatrixXcd yAx, vis;
+  vector<VectorXd> x(K);
+
+  mx    = VectorXi::Zero(M);
+  my    = VectorXi::Zero(M);
+  E1    = VectorXd::Zero(M);
+  E2x   = MatrixXd::Zero(M,2*MSP);
+  E2y   = MatrixXd::Zero(M,2*MSP);
+  E4mat = MatrixXd::Zero(Nx,Ny);
+  Fval  = VectorXd::Zero(K);
+
+  buf_diff = VectorXd::Zero(Nx-1);
+  u = Map<VectorXd>(u_dx,M);
+  v = Map<VectorXd>(v_dy,M);
+
+  for(s = 0; s < K; s++) x[s] = Map<VectorXd>(xout + s*NN, NN);
+
+  preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);
+
+  rvec  = (double*) fftw_malloc(K*4*NN*sizeof(double));
+  cvec  = (fftw_complex*) fftw_malloc(K*MMh*sizeof(fftw_complex));
+
+  fftwplan_r2c = fftw_plan_many_dft_r2c(2, n, K, rvec, NULL, 1, 4*NN,
+					cvec, NULL, 1, MMh, fftw_plan_flag);
+
+  yAx    = MatrixXcd::Zero(K, M);
+  vis    = MatrixXcd::Zero(K, M);
+  weight = MatrixXd::Zero(K, M);
+
+  for(s = 0; s < K; s++)
+    for(i = 0; i < M; i++){
+      vis(s, i)    = complex<double>(vis_r[s*M + i], vis_i[s*M + i]);
+      weight(s, i) = 1/vis_std[s*M + i];
+    }
+
+  calc_F_part_nufft_batch(Fval, yAx, E1, E2x, E2y, E4mat, mx, my,
+			  rvec, cvec, &fftwplan_r2c, vis, weight, x);
+
+  for(s = 0; s < K; s++){
+
+    mfista_result[s].sq_error = 2*Fval(s);
+
+    mfista_result[s].M  = (int)(M/2);
+    mfista_result[s].N  = NN;
+    mfista_result[s].NX = Nx;
+    mfista_result[s].NY = Ny;
+
+    mfista_result[s].lambda_l1  = lambda_l1;
+    mfista_result[s].lambda_tv  = lambda_tv;
+    mfista_result[s].lambda_tsv = lambda_tsv;
+
+    mfista_result[s].mean_sq_error = mfista_result[s].sq_error/((double)M);
+
+    mfista_result[s].l1cost   = 0;
+    mfista_result[s].N_active = 0;
+
+    for(i = 0; i < NN; i++){
+      tmp = fabs(x[s](i));
+      if(tmp > 0){
+	mfista_result[s].l1cost += tmp;
+	++ mfista_result[s].N_active;
+      }
+    }
+
+    mfista_result[s].finalcost = (mfista_result[s].sq_error)/2;
+
+    if(lambda_l1 > 0)
+      mfista_result[s].finalcost += lambda_l1*(mfista_result[s].l1cost);
+
+    if(lambda_tsv > 0){
+      mfista_result[s].tsvcost = TSV(Nx, Ny, x[s], buf_diff);
+      mfista_result[s].finalcost += lambda_tsv*(mfista_result[s].tsvcost);
+    }
+  }
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan_r2c);
+}
+
+/* main subroutine */
+
+void mfista_imaging_core_nufft_batch(double *u_dx, double *v_dy, int K,
+				     double *vis_r, double *vis_i, double *vis_std,
+				     int M, int Nx, int Ny, int maxiter, double eps,
+				     double lambda_l1, double lambda_tv, double lambda_tsv,
+				     double cinit, double *xinit, double *xout,
+				     int nonneg_flag, int box_flag, float *cl_box,
+				     struct MFISTA_OPT *mfista_opt,
+				     struct RESULT *mfista_result)
+{
+  int i, s, NN = Nx*Ny, *iter, *stop;
+  double *epsilon, *c, s_t, e_t;
+  struct timespec time_spec1, time_spec2;
+
+  // anything but plain MFISTA for L1+TSV: one image at a time
+
+  if(lambda_tv != 0 || (lambda_l1 == 0 && mfista_opt->lbfgs == 1) ||
+     mfista_opt->mixed == 1 || mfista_opt->tsv_prox == 1 || mfista_opt->newton == 1 ||
+     mfista_opt->screen == 1 || mfista_opt->gap > 0 || mfista_opt->chi2 > 0 ||
+     mfista_opt->deadline > 0 || mfista_opt->ckpt_fname != NULL ||
+     mfista_opt->trace_fname != NULL || mfista_opt->trace_func != NULL){
+
+    if(mfista_opt->verbose)
+      cout << "Solving the " << K << " images one by one." << endl << endl;
+
+    for(s = 0; s < K; s++)
+      mfista_imaging_core_nufft_opt(u_dx, v_dy, vis_r + s*M, vis_i + s*M, vis_std + s*M,
+				    M, Nx, Ny, maxiter, eps, lambda_l1, lambda_tv, lambda_tsv,
+				    cinit, xinit + s*NN, xout + s*NN, nonneg_flag, box_flag, cl_box,
+				    mfista_opt, mfista_result + s);
+    return;
+  }
+
+  iter    = new int [K];
+  stop    = new int [K];
+  epsilon = new double [K];
+  c       = new double [K];
+
+  for(s = 0; s < K; s++){
+    epsilon[s] = 0;
+    for(i = 0; i < M; i++)
+      epsilon[s] += vis_r[s*M + i]*vis_r[s*M + i] + vis_i[s*M + i]*vis_i[s*M + i];
+
+    epsilon[s] *= eps/((double)M);
+
+    iter[s] = 0;
+    c[s]    = cinit;
+  }
+
+  get_current_time(&time_spec1);
+
+  mfista_L1_TSV_core_nufft_batch(xout, K, M, Nx, Ny, u_dx, v_dy, maxiter, epsilon,
+				 vis_r, vis_i, vis_std, lambda_l1, lambda_tsv,
+				 c, xinit, iter, stop, nonneg_flag, box_flag, cl_box,
+				 mfista_opt->verbose);
+
+  get_current_time(&time_spec2);
+
+  s_t = (double)time_spec1.tv_sec + (1.0e-9)*(double)time_spec1.tv_nsec;
+  e_t = (double)time_spec2.tv_sec + (1.0e-9)*(double)time_spec2.tv_nsec;
+
+  for(s = 0; s < K; s++){
+    mfista_result[s].comp_time = e_t-s_t;
+    mfista_result[s].ITER      = iter[s];
+    mfista_result[s].stop_rule = stop[s];
+    mfista_result[s].nonneg    = nonneg_flag;
+    mfista_result[s].Lip_const = c[s];
+    mfista_result[s].maxiter   = maxiter;
+  }
+
+  calc_result_nufft_batch(mfista_result, K, M, Nx, Ny, u_dx, v_dy, vis_r, vis_i, vis_std,
+			  lambda_l1, lambda_tv, lambda_tsv, xout);
+
+  delete [] iter;
+  delete [] stop;
+  delete [] epsilon;
+  delete [] c;
+}
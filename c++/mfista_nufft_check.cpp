@@ -0,0 +1,416 @@
+#include "mfista.hpp"
+#include <fstream>
+#include <random>
+
+// Accuracy of the NUFFT against the exact DFT.
+//
+// For the same u, v and image, NUFFT2d2 (forward) and NUFFT2d1 (adjoint)
+// are compared with the direct sums
+//
+//   V(k)   = sum_ij X(i,j) exp(-NU_SIGN i (u_k (i-Nx/2) + v_k (j-Ny/2)))
+//   X(i,j) = Re sum_k conj(exp(...)) y(k)
+//
+// in double and in single precision, with the gridding kernel of width
+// 2*MSP of this build. For each configuration the relative errors, the
+// adjoint dot-test |<Ax,y> - <x,A^H y>|/(|Ax||y|) and the time of one
+// transform are reported. A configuration whose error is above the
+// threshold, or whose dot-test is above the rounding of its precision,
+// fails, and the exit status is 1 when any of them fails.
+//
+// With MSP = 6 the error is about 2e-3, with MSP = 4 about 0.1 and with
+// MSP = 12 below 1e-10 (1e-6 in float).
+//
+// The batched solve of mfista_nufft_batch_lib is checked against K
+// single solves of the same streams (the same u, v; random vis).
+
+// default threshold of the relative error
+#define CHECKTOL   5.0e-3
+
+// thresholds of the dot-test
+#define CHECKDOT   1.0e-12
+#define CHECKDOTF  1.0e-6
+
+// minimum time spent on timing one transform
+#define CHECKSEC   0.2
+
+// iterations, lambda_l1, c and threshold of the relative difference of
+// the batched solve
+#define CHECKITER  50
+#define CHECKL1    1.0
+#define CHECKC     1.0e5
+#define CHECKBATCH 1.0e-8
+
+void usage(char *s)
+{
+  cerr << s
+       << " {-data nufft_data} {-M n} {-nx n} {-ny n} {-seed n}"
+       << " {-tol t} {-K n} {-json fname}"
+       << "\n\n";
+
+  cerr << " Options." << "\n\n";
+
+  cerr << "  {-data nufft_data}:  u, v and vis of a data file instead of random ones." << endl;
+  cerr << "  {-M n}:              number of random visibilities (default 10000)." << endl;
+  cerr << "  {-nx n}:             X-dim of image (default 64)." << endl;
+  cerr << "  {-ny n}:             Y-dim of image (default 48)." << endl;
+  cerr << "  {-seed n}:           seed of the random numbers (default 1)." << endl;
+  cerr << "  {-tol t}:            threshold of the relative error (default " << CHECKTOL << ")." << endl;
+  cerr << "  {-K n}:              streams of the batched solve (default 4, 0 to skip)." << endl;
+  cerr << "  {-json fname}:       write the results to a JSON file." << "\n\n";
+
+  cerr << " Random u_rad and v_rad are uniform in [-pi/2, pi/2)." << endl;
+  cerr << " The kernel width is set when building: -DMSP=12 for high precision." << "\n\n";
+
+  exit(1);
+}
+
+static double elapsed(struct timespec *t0)
+{
+  struct timespec t1;
+
+  get_current_time(&t1);
+
+  return((double)(t1.tv_sec - t0->tv_sec) + 1.0e-9*(double)(t1.tv_nsec - t0->tv_nsec));
+}
+
+static double time_call(function<void()> func, double min_sec)
+{
+  struct timespec t0;
+  double sec;
+  long n = 0;
+
+  func();
+
+  get_current_time(&t0);
+  do{
+    func();
+    n++;
+  } while((sec = elapsed(&t0)) < min_sec);
+
+  return(sec/n);
+}
+
+// fftw buffers and plans of the 2Nx x 2Ny grid in each precision
+
+static void plan_grid(int Nx, int Ny, double **rvec, fftw_complex **cvec,
+		      fftw_plan *c2r, fftw_plan *r2c)
+{
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  *rvec = (double*) fftw_malloc(4*Nx*Ny*sizeof(double));
+  *cvec = (fftw_complex*) fftw_malloc(2*Nx*(Ny+1)*sizeof(fftw_complex));
+  *c2r  = fftw_plan_dft_c2r_2d(2*Nx, 2*Ny, *cvec, *rvec, fftw_plan_flag);
+  *r2c  = fftw_plan_dft_r2c_2d(2*Nx, 2*Ny, *rvec, *cvec, fftw_plan_flag);
+}
+
+static void plan_grid(int Nx, int Ny, float **rvec, fftwf_complex **cvec,
+		      fftwf_plan *c2r, fftwf_plan *r2c)
+{
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  *rvec = (float*) fftwf_malloc(4*Nx*Ny*sizeof(float));
+  *cvec = (fftwf_complex*) fftwf_malloc(2*Nx*(Ny+1)*sizeof(fftwf_complex));
+  *c2r  = fftwf_plan_dft_c2r_2d(2*Nx, 2*Ny, *cvec, *rvec, fftw_plan_flag);
+  *r2c  = fftwf_plan_dft_r2c_2d(2*Nx, 2*Ny, *rvec, *cvec, fftw_plan_flag);
+}
+
+static void free_grid(double *rvec, fftw_complex *cvec, fftw_plan c2r, fftw_plan r2c)
+{
+  fftw_destroy_plan(c2r);
+  fftw_destroy_plan(r2c);
+  fftw_free(rvec);
+  fftw_free(cvec);
+}
+
+static void free_grid(float *rvec, fftwf_complex *cvec, fftwf_plan c2r, fftwf_plan r2c)
+{
+  fftwf_destroy_plan(c2r);
+  fftwf_destroy_plan(r2c);
+  fftwf_free(rvec);
+  fftwf_free(cvec);
+}
+
+// exact transforms, separable in x and y
+
+static void dft_forward(int Nx, int Ny, VectorXd &u, VectorXd &v, VectorXd &xvec,
+			VectorXcd &vis)
+{
+  int i, j, k;
+  complex<double> sum_y;
+  VectorXcd ex(Nx), ey(Ny);
+
+  for(k = 0; k < u.size(); k++){
+    for(i = 0; i < Nx; i++) ex(i) = polar(1.0, -NU_SIGN*u(k)*(i-Nx/2));
+    for(j = 0; j < Ny; j++) ey(j) = polar(1.0, -NU_SIGN*v(k)*(j-Ny/2));
+
+    vis(k) = 0;
+    for(i = 0; i < Nx; i++){
+      sum_y = 0;
+      for(j = 0; j < Ny; j++) sum_y += xvec(i*Ny+j)*ey(j);
+      vis(k) += ex(i)*sum_y;
+    }
+  }
+}
+
+static void dft_adjoint(int Nx, int Ny, VectorXd &u, VectorXd &v, VectorXcd &vis,
+			VectorXd &xvec)
+{
+  int i, j, k;
+  complex<double> tmp;
+  VectorXcd ex(Nx), ey(Ny);
+
+  xvec.setZero();
+
+  for(k = 0; k < u.size(); k++){
+    for(i = 0; i < Nx; i++) ex(i) = polar(1.0, NU_SIGN*u(k)*(i-Nx/2));
+    for(j = 0; j < Ny; j++) ey(j) = polar(1.0, NU_SIGN*v(k)*(j-Ny/2));
+
+    for(i = 0; i < Nx; i++){
+      tmp = ex(i)*vis(k);
+      for(j = 0; j < Ny; j++) xvec(i*Ny+j) += real(tmp*ey(j));
+    }
+  }
+}
+
+struct CHECK_OUT{
+  const char *prec;
+  double err_fwd;
+  double err_adj;
+  double dot;
+  double sec_fwd;
+  double sec_adj;
+  double tol;
+  double dot_tol;
+  int pass;
+};
+
+template <typename T>
+static void check_config(struct CHECK_OUT *out, int Nx, int Ny,
+			 VectorXd &E1d, MatrixXd &E2xd, MatrixXd &E2yd, MatrixXd &E4matd,
+			 VectorXi &mx, VectorXi &my, VectorXd &xvec, VectorXcd &vis,
+			 VectorXcd &vis_dft, VectorXd &x_dft)
+{
+  T *rvec;
+  typename FFTW_T<T>::cpx *cvec;
+  typename FFTW_T<T>::plan c2r, r2c;
+  Matrix<T,Dynamic,1> E1 = E1d.cast<T>();
+  Matrix<T,Dynamic,Dynamic> E2x = E2xd.cast<T>(), E2y = E2yd.cast<T>(), E4mat = E4matd.cast<T>();
+  VectorXcd yAx;
+  VectorXd xout = VectorXd::Zero(Nx*Ny);
+
+  plan_grid(Nx, Ny, &rvec, &cvec, &c2r, &r2c);
+
+  NUFFT2d2(yAx, E1, E2x, E2y, E4mat, mx, my, rvec, cvec, &r2c, xvec);
+  NUFFT2d1(xout, E1, E2x, E2y, E4mat, mx, my, cvec, rvec, &c2r, vis);
+
+  out->err_fwd = (yAx - vis_dft).norm()/vis_dft.norm();
+  out->err_adj = (xout - x_dft).norm()/x_dft.norm();
+  out->dot     = fabs(real(vis.dot(yAx)) - xvec.dot(xout))/(yAx.norm()*vis.norm());
+
+  out->sec_fwd = time_call([&]{NUFFT2d2(yAx, E1, E2x, E2y, E4mat, mx, my,
+					rvec, cvec, &r2c, xvec);}, CHECKSEC);
+  out->sec_adj = time_call([&]{NUFFT2d1(xout, E1, E2x, E2y, E4mat, mx, my,
+					cvec, rvec, &c2r, vis);}, CHECKSEC);
+
+  out->pass = (out->err_fwd <= out->tol && out->err_adj <= out->tol && out->dot <= out->dot_tol);
+
+  free_grid(rvec, cvec, c2r, r2c);
+}
+
+int main(int argc, char *argv[]){
+
+  int i, s, M = 10000, Nx = 64, Ny = 48, NN, K = 4, fail = 0, batch_pass = 1;
+  unsigned long seed = 1;
+  double tol = CHECKTOL, sec_dft, *u_dx, *v_dy, *vis_r, *vis_i, *vis_std,
+    batch_diff = 0, sec_batch = 0, sec_single = 0;
+  char *data_fname = NULL, *json_fname = NULL;
+  struct timespec t0;
+  struct CHECK_OUT out[2];
+  VectorXi mx, my;
+  VectorXd u, v, E1, xvec, x_dft;
+  VectorXcd vis, vis_dft;
+  MatrixXd E2x, E2y, E4mat;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i],"-data") == 0 && i+1 < argc)
+      data_fname = argv[++i];
+    else if(strcmp(argv[i],"-M") == 0 && i+1 < argc)
+      M = atoi(argv[++i]);
+    else if(strcmp(argv[i],"-nx") == 0 && i+1 < argc)
+      Nx = atoi(argv[++i]);
+    else if(strcmp(argv[i],"-ny") == 0 && i+1 < argc)
+      Ny = atoi(argv[++i]);
+    else if(strcmp(argv[i],"-seed") == 0 && i+1 < argc)
+      seed = strtoul(argv[++i], NULL, 10);
+    else if(strcmp(argv[i],"-tol") == 0 && i+1 < argc)
+      tol = atof(argv[++i]);
+    else if(strcmp(argv[i],"-K") == 0 && i+1 < argc)
+      K = atoi(argv[++i]);
+    else if(strcmp(argv[i],"-json") == 0 && i+1 < argc)
+      json_fname = argv[++i];
+    else
+      usage(argv[0]);
+  }
+
+  mt19937_64 gen(seed);
+  uniform_real_distribution<double> uni(-1, 1);
+
+  if(data_fname != NULL){
+    read_nufft_data(data_fname, &M, &Nx, &Ny, &u_dx, &v_dy, &vis_r, &vis_i, &vis_std);
+
+    u   = Map<VectorXd>(u_dx, M);
+    v   = Map<VectorXd>(v_dy, M);
+    vis = VectorXcd::Zero(M);
+    for(i = 0; i < M; i++) vis(i) = complex<double>(vis_r[i], vis_i[i]);
+
+    delete [] u_dx;
+    delete [] v_dy;
+    delete [] vis_r;
+    delete [] vis_i;
+    delete [] vis_std;
+  }
+  else{
+    u   = VectorXd::Zero(M);
+    v   = VectorXd::Zero(M);
+    vis = VectorXcd::Zero(M);
+
+    for(i = 0; i < M; i++){
+      u(i) = 0.5*M_PI*uni(gen);
+      v(i) = 0.5*M_PI*uni(gen);
+      vis(i) = complex<double>(uni(gen), uni(gen));
+    }
+  }
+
+  if(M < 1 || Nx < 2 || Ny < 2){
+    cerr << "M, Nx and Ny must be positive." << endl;
+    exit(1);
+  }
+
+  NN = Nx*Ny;
+
+  xvec = VectorXd::Zero(NN);
+  for(i = 0; i < NN; i++) xvec(i) = uni(gen);
+
+  cout << "M = " << M << ", " << Nx << "x" << Ny << ", MSP = " << MSP << endl;
+
+  // exact transforms
+
+  vis_dft = VectorXcd::Zero(M);
+  x_dft   = VectorXd::Zero(NN);
+
+  get_current_time(&t0);
+  dft_forward(Nx, Ny, u, v, xvec, vis_dft);
+  dft_adjoint(Nx, Ny, u, v, vis, x_dft);
+  sec_dft = elapsed(&t0)/2;
+
+  cout << "exact DFT: " << sec_dft << " sec" << endl;
+
+  // nufft in double and in float
+
+  mx    = VectorXi::Zero(M);
+  my    = VectorXi::Zero(M);
+  E1    = VectorXd::Zero(M);
+  E2x   = MatrixXd::Zero(M,2*MSP);
+  E2y   = MatrixXd::Zero(M,2*MSP);
+  E4mat = MatrixXd::Zero(Nx,Ny);
+
+  preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);
+
+  out[0].prec = "double";
+  out[0].tol  = tol;
+  out[0].dot_tol = CHECKDOT;
+  check_config<double>(&out[0], Nx, Ny, E1, E2x, E2y, E4mat, mx, my, xvec, vis, vis_dft, x_dft);
+
+  out[1].prec = "float";
+  out[1].tol  = tol;
+  out[1].dot_tol = CHECKDOTF;
+  check_config<float>(&out[1], Nx, Ny, E1, E2x, E2y, E4mat, mx, my, xvec, vis, vis_dft, x_dft);
+
+  for(i = 0; i < 2; i++){
+    cout << out[i].prec << ", MSP = " << MSP << ":" << endl;
+    cout << "  forward error:  " << out[i].err_fwd << ", " << out[i].sec_fwd << " sec" << endl;
+    cout << "  adjoint error:  " << out[i].err_adj << ", " << out[i].sec_adj << " sec" << endl;
+    cout << "  dot-test:       " << out[i].dot << endl;
+    cout << "  " << (out[i].pass ? "pass" : "FAIL") << " (tol = " << out[i].tol
+	 << ", dot-test tol = " << out[i].dot_tol << ")" << endl;
+
+    if(!out[i].pass) fail = 1;
+  }
+
+  // batched solve of K streams against K single solves
+
+  if(K > 0){
+    struct MFISTA_OPT mfista_opt;
+    vector<struct RESULT> res(2*K);
+    vector<double> b_r(K*M), b_i(K*M), b_std(K*M, 1.0), x0(K*NN, 0.0), x_b(K*NN), x_s(K*NN);
+    VectorXd u_c = u, v_c = v;
+
+    init_opt(&mfista_opt);
+    mfista_opt.verbose = 0;
+
+    for(s = 0; s < K; s++)
+      for(i = 0; i < M; i++){
+	b_r[s*M + i] = (s == 0) ? real(vis(i)) : uni(gen);
+	b_i[s*M + i] = (s == 0) ? imag(vis(i)) : uni(gen);
+      }
+
+    get_current_time(&t0);
+    mfista_imaging_core_nufft_batch(u_c.data(), v_c.data(), K, b_r.data(), b_i.data(), b_std.data(),
+				    M, Nx, Ny, CHECKITER, EPS, CHECKL1, 0, 0, CHECKC, x0.data(), x_b.data(),
+				    0, 0, NULL, &mfista_opt, res.data());
+    sec_batch = elapsed(&t0);
+
+    get_current_time(&t0);
+    for(s = 0; s < K; s++)
+      mfista_imaging_core_nufft_opt(u_c.data(), v_c.data(), &b_r[s*M], &b_i[s*M], &b_std[s*M],
+				    M, Nx, Ny, CHECKITER, EPS, CHECKL1, 0, 0, CHECKC, &x0[s*NN], &x_s[s*NN],
+				    0, 0, NULL, &mfista_opt, &res[K + s]);
+    sec_single = elapsed(&t0);
+
+    for(s = 0; s < K; s++){
+      Map<VectorXd> xb(&x_b[s*NN], NN), xs(&x_s[s*NN], NN);
+
+      batch_diff = max(batch_diff, (xb - xs).norm()/xs.norm());
+      if(res[s].ITER != res[K + s].ITER) batch_pass = 0;
+    }
+
+    batch_pass = (batch_pass && batch_diff <= CHECKBATCH);
+
+    cout << "batched solve of " << K << " streams:" << endl;
+    cout << "  difference:     " << batch_diff << endl;
+    cout << "  time:           " << sec_batch << " sec (single solves " << sec_single << " sec)" << endl;
+    cout << "  " << (batch_pass ? "pass" : "FAIL") << " (tol = " << CHECKBATCH << ")" << endl;
+
+    if(!batch_pass) fail = 1;
+  }
+
+  if(json_fname != NULL){
+    ofstream ofs(json_fname);
+
+    if(ofs.fail()){
+      cerr << "Cannot open \"" << json_fname << ".\"\n";
+      exit(1);
+    }
+
+    ofs << "{\"M\": " << M << ", \"Nx\": " << Nx << ", \"Ny\": " << Ny
+	<< ", \"MSP\": " << MSP << ", \"dft_sec\": " << sec_dft << ", \"configs\": [";
+
+    for(i = 0; i < 2; i++)
+      ofs << ((i == 0) ? "\n" : ",\n")
+	  << "  {\"precision\": \"" << out[i].prec << "\", \"err_fwd\": " << out[i].err_fwd
+	  << ", \"err_adj\": " << out[i].err_adj << ", \"dot\": " << out[i].dot
+	  << ", \"sec_fwd\": " << out[i].sec_fwd << ", \"sec_adj\": " << out[i].sec_adj
+	  << ", \"tol\": " << out[i].tol << ", \"pass\": " << out[i].pass << "}";
+
+    ofs << "\n]";
+
+    if(K > 0)
+      ofs << ", \"batch\": {\"K\": " << K << ", \"diff\": " << batch_diff
+	  << ", \"sec_batch\": " << sec_batch << ", \"sec_single\": " << sec_single
+	  << ", \"pass\": " << batch_pass << "}";
+
+    ofs << "}\n";
+  }
+
+  return(fail);
+}
@@ -0,0 +1,247 @@
+#include "mfista.hpp"
+
+#ifdef PTHREAD
+#include <thread>
+#include <mutex>
+#endif
+
+// mfista_nufft_cube_lib
+//
+// Spectral cube: Nch channels of the same Nx x Ny image, each with its
+// own uv coverage. The 2Nx x 2Ny fftw plans are made once and shared by
+// all the channel solves. Channels are split into contiguous blocks,
+// one block per worker, and every channel after the first of a block is
+// warm-started with the image and c of the previous channel.
+
+// grid size (Nx*Ny) handled by one fftw thread in a channel solve
+#define CUBE_NN_PER_THREAD (128*128)
+
+struct CUBE_WORK{
+  int ch_s;
+  int ch_e;
+  struct NUFFT_FFTW nufft_fftw;
+  double *xbuf;
+};
+
+struct CUBE_ARGS{
+  int *M;
+  double **u_dx;
+  double **v_dy;
+  double **vis_r;
+  double **vis_i;
+  double **vis_std;
+  int Nx;
+  int Ny;
+  int maxiter;
+  double eps;
+  double lambda_l1;
+  double lambda_tv;
+  double lambda_tsv;
+  double cinit;
+  double *xinit;
+  double *xout;
+  int nonneg_flag;
+  int box_flag;
+  float *cl_box;
+  void (*write_channel)(int ch, double *x, struct RESULT *res, void *arg);
+  void *write_arg;
+  struct MFISTA_OPT *mfista_opt;
+  struct RESULT *mfista_result;
+};
+
+#ifdef PTHREAD
+static mutex cube_write_mutex;
+#endif
+
+void cube_worker(struct CUBE_WORK *work, struct CUBE_ARGS *args)
+{
+  int ch, i, iter, NN = args->Nx*args->Ny, M;
+  double epsilon, s_t, e_t, c = args->cinit, *xin, *x;
+  struct timespec time_spec1, time_spec2;
+  struct RESULT *result;
+
+  xin = args->xinit;
+
+  for(ch = work->ch_s; ch < work->ch_e; ch++){
+
+    M      = args->M[ch];
+    result = &(args->mfista_result[ch]);
+    x      = (args->xout == NULL) ? work->xbuf : (args->xout + ch*NN);
+
+    epsilon = 0;
+    for(i = 0; i < M; i++)
+      epsilon += args->vis_r[ch][i]*args->vis_r[ch][i] + args->vis_i[ch][i]*args->vis_i[ch][i];
+
+    epsilon *= args->eps/((double)M);
+
+    get_current_time(&time_spec1);
+
+    iter = mfista_L1_TSV_core_nufft(x, M, args->Nx, args->Ny,
+				    args->u_dx[ch], args->v_dy[ch], args->maxiter, epsilon,
+				    args->vis_r[ch], args->vis_i[ch], args->vis_std[ch],
+				    args->lambda_l1, args->lambda_tsv, &c, xin,
+				    args->nonneg_flag, args->box_flag, args->cl_box,
+				    &(work->nufft_fftw), args->mfista_opt, result);
+
+    get_current_time(&time_spec2);
+
+    s_t = (double)time_spec1.tv_sec + (1.0e-9)*(double)time_spec1.tv_nsec;
+    e_t = (double)time_spec2.tv_sec + (1.0e-9)*(double)time_spec2.tv_nsec;
+
+    result->comp_time = e_t-s_t;
+    result->ITER      = iter;
+    result->nonneg    = args->nonneg_flag;
+    result->Lip_const = c;
+    result->maxiter   = args->maxiter;
+
+    calc_result_nufft(result, M, args->Nx, args->Ny, args->u_dx[ch], args->v_dy[ch],
+		      args->vis_r[ch], args->vis_i[ch], args->vis_std[ch],
+		      args->lambda_l1, args->lambda_tv, args->lambda_tsv, x,
+		      &(work->nufft_fftw));
+
+    if(args->write_channel != NULL){
+#ifdef PTHREAD
+      lock_guard<mutex> lock(cube_write_mutex);
+#endif
+      args->write_channel(ch, x, result, args->write_arg);
+    }
+
+    // warm start of the next channel
+
+    if(args->xout == NULL){
+      if(xin == args->xinit) xin = new double [NN];
+      for(i = 0; i < NN; i++) xin[i] = x[i];
+    }
+    else xin = x;
+  }
+
+  if(args->xout == NULL && xin != args->xinit) delete [] xin;
+}
+
+/* main subroutine */
+
+void mfista_imaging_core_nufft_cube(int Nch, int *M, double **u_dx, double **v_dy,
+				    double **vis_r, double **vis_i, double **vis_std,
+				    int Nx, int Ny, int maxiter, double eps,
+				    double lambda_l1, double lambda_tv, double lambda_tsv,
+				    double cinit, double *xinit, double *xout,
+				    int nonneg_flag, int box_flag, float *cl_box,
+				    void (*write_channel)(int ch, double *x, struct RESULT *res, void *arg),
+				    void *write_arg,
+				    struct MFISTA_OPT *mfista_opt,
+				    struct RESULT *mfista_result)
+{
+  int w, i, NN = Nx*Ny, MMh = 2*Nx*(Ny+1), n_worker = 1, n_thread = 1;
+  double *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_c2r, fftwplan_r2c;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+  struct CUBE_WORK *work;
+  struct CUBE_ARGS args;
+  struct MFISTA_OPT worker_opt;
+
+  if( lambda_tv != 0 ){
+    cout << "We have not implemented TV option." << endl;
+    return;
+  }
+
+  // small images: one single-threaded solve per core,
+  // large images: fewer solves with multi-threaded fftw.
+
+#ifdef PTHREAD
+  n_thread = NN/CUBE_NN_PER_THREAD;
+  if(n_thread < 1)          n_thread = 1;
+  if(n_thread > THREAD_NUM) n_thread = THREAD_NUM;
+
+  n_worker = THREAD_NUM/n_thread;
+  if(n_worker > Nch) n_worker = Nch;
+
+  if(fftw_init_threads()==0)
+    cout << "Could not initialize multi threads for fftw3." << endl;
+
+  fftw_make_planner_thread_safe();
+  fftw_plan_with_nthreads(n_thread);
+
+  if(mfista_opt->mixed == 1){
+    fftwf_init_threads();
+    fftwf_make_planner_thread_safe();
+  }
+#endif
+
+  cout << "Imaging " << Nch << " channels with " << n_worker << " solves of "
+       << n_thread << " thread(s) at a time." << endl;
+
+  // plans shared by all the workers
+
+  rvec = (double*) fftw_malloc(4*NN*sizeof(double));
+  cvec = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
+
+  fftwplan_c2r = fftw_plan_dft_c2r_2d(2*Nx,2*Ny, cvec, rvec, fftw_plan_flag);
+  fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx,2*Ny, rvec, cvec, fftw_plan_flag);
+
+  work = new struct CUBE_WORK [n_worker];
+
+  for(w = 0; w < n_worker; w++){
+    work[w].ch_s = (int)(((long)Nch*w)/n_worker);
+    work[w].ch_e = (int)(((long)Nch*(w+1))/n_worker);
+
+    work[w].nufft_fftw.rvec = (double*) fftw_malloc(4*NN*sizeof(double));
+    work[w].nufft_fftw.cvec = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
+    work[w].nufft_fftw.fftwplan_c2r = fftwplan_c2r;
+    work[w].nufft_fftw.fftwplan_r2c = fftwplan_r2c;
+
+    for(i = 0; i < 4*NN; i++) work[w].nufft_fftw.rvec[i] = 0;
+    for(i = 0; i < MMh; i++){
+      work[w].nufft_fftw.cvec[i][0] = 0;
+      work[w].nufft_fftw.cvec[i][1] = 0;
+    }
+
+    work[w].xbuf = (xout == NULL) ? new double [NN] : NULL;
+  }
+
+  worker_opt = *mfista_opt;
+  worker_opt.verbose = (n_worker == 1) ? mfista_opt->verbose : 0;
+
+  args.M = M; args.u_dx = u_dx; args.v_dy = v_dy;
+  args.vis_r = vis_r; args.vis_i = vis_i; args.vis_std = vis_std;
+  args.Nx = Nx; args.Ny = Ny; args.maxiter = maxiter; args.eps = eps;
+  args.lambda_l1 = lambda_l1; args.lambda_tv = lambda_tv; args.lambda_tsv = lambda_tsv;
+  args.cinit = cinit; args.xinit = xinit; args.xout = xout;
+  args.nonneg_flag = nonneg_flag; args.box_flag = box_flag; args.cl_box = cl_box;
+  args.write_channel = write_channel; args.write_arg = write_arg;
+  args.mfista_opt = &worker_opt; args.mfista_result = mfista_result;
+
+#ifdef PTHREAD
+  vector<thread> workers;
+
+  for(w = 0; w < n_worker; w++)
+    workers.push_back(thread(cube_worker, &work[w], &args));
+
+  for(w = 0; w < n_worker; w++) workers[w].join();
+#else
+  cube_worker(&work[0], &args);
+#endif
+
+  // free
+
+  for(w = 0; w < n_worker; w++){
+    fftw_free(work[w].nufft_fftw.rvec);
+    fftw_free(work[w].nufft_fftw.cvec);
+    if(work[w].xbuf != NULL) delete [] work[w].xbuf;
+  }
+
+  delete [] work;
+
+  fftw_free(rvec);
+  fftw_free(cvec);
+
+  fftw_destroy_plan(fftwplan_c2r);
+  fftw_destroy_plan(fftwplan_r2c);
+
+#ifdef PTHREAD
+  if(mfista_opt->mixed == 1) fftwf_cleanup_threads();
+  fftw_cleanup_threads();
+#else
+  fftw_cleanup();
+#endif
+}
@@ -1,5 +1,6 @@
 #include "mfista.hpp"
 #include <iomanip>
+#include <cstring>
 
 // mfist_nufft_lib
 
@@ -80,22 +81,25 @@ void preNUFFT(VectorXd &u, VectorXd &v,
     tmpx = taux*tmpi*tmpi;
 
     for(j = 0; j< Ny; j++){
-      tmpj = (double)(j-Nx/2);
+      tmpj = (double)(j-Ny/2);
       tmpy = tauy*tmpj*tmpj;
       E4mat(i,j) = coeff*exp(tmpx + tmpy);
     }
   }
 }
 
+template <typename T>
 void NUFFT2d1(VectorXd &Xout,
-	      VectorXd &E1, MatrixXd &E2x, MatrixXd &E2y,
-	      MatrixXd &E4mat, VectorXi &mx, VectorXi &my,
- 	      fftw_complex *in, double *out, fftw_plan *fftwplan_c2r,
+	      Matrix<T,Dynamic,1> &E1, Matrix<T,Dynamic,Dynamic> &E2x, Matrix<T,Dynamic,Dynamic> &E2y,
+	      Matrix<T,Dynamic,Dynamic> &E4mat, VectorXi &mx, VectorXi &my,
+ 	      typename FFTW_T<T>::cpx *in, T *out, typename FFTW_T<T>::plan *fftwplan_c2r,
  	      VectorXcd &Fin)
 {
   int M, Nx, Ny, Mrx, Mry, Mh, j, k, lx, ly, idx, idy, sign;
   double MM;
   complex<double> v0, vy, tmpc;
+
+  PROF_BEGIN(t_prof);
     
   M =  E1.size();
   Nx = E4mat.rows();
@@ -113,14 +117,14 @@ void NUFFT2d1(VectorXd &Xout,
 
   for(k = 0; k < M; k++){
 
-    if(NU_SIGN == 1) v0 = E1(k)*Fin(k);
-    else             v0 = E1(k)*conj(Fin(k));
+    if(NU_SIGN == 1) v0 = (double)E1(k)*Fin(k);
+    else             v0 = (double)E1(k)*conj(Fin(k));
 
     // for original
 
     for(ly = 0; ly < 2*MSP; ly++){
 
-      vy = v0*E2y(k, ly)/2.0;
+      vy = v0*(double)E2y(k, ly)/2.0;
 
       for(sign = -1; sign < 2; sign +=2){
 	idy = idx_fftw(sign*(my(k)+ly-MSP+1),Mry);
@@ -128,7 +132,7 @@ void NUFFT2d1(VectorXd &Xout,
 	if(idy < (Ny+1))
 	  for(lx = 0; lx < 2*MSP; lx++){
 	    idx = idx_fftw(sign*(mx(k)+lx-MSP+1),Mrx);
-	    tmpc = (complex<double>) vy*E2x(k,lx);
+	    tmpc = (complex<double>) vy*(double)E2x(k,lx);
 	    in[idx*Mh + idy][0] += real(tmpc);
 	    in[idx*Mh + idy][1] += sign*imag(tmpc);
 	  }
@@ -136,7 +140,12 @@ void NUFFT2d1(VectorXd &Xout,
     }
   }
 
-  fftw_execute(*fftwplan_c2r);
+  PROF_LAP(PROF_GRID, t_prof);
+
+  FFTW_T<T>::execute_c2r(*fftwplan_c2r, in, out);
+
+  PROF_LAP(PROF_ADJ, t_prof);
+  PROF_COUNT(n_adj);
 
   for(k = 0; k < Nx; k++){
     idx = m2mr(k,Nx);
@@ -145,17 +154,22 @@ void NUFFT2d1(VectorXd &Xout,
       Xout(k*Ny + j) = out[idx*Mry + idy]*E4mat(k,j)/MM;
     }
   }
+
+  PROF_LAP(PROF_GRID, t_prof);
 }
 
-void NUFFT2d2(VectorXcd &Fout, VectorXd &E1,
-	      MatrixXd &E2x, MatrixXd &E2y,
- 	      MatrixXd &E4mat, VectorXi &mx, VectorXi &my,
- 	      double *in, fftw_complex *out, fftw_plan *fftwplan_r2c,
+template <typename T>
+void NUFFT2d2(VectorXcd &Fout, Matrix<T,Dynamic,1> &E1,
+	      Matrix<T,Dynamic,Dynamic> &E2x, Matrix<T,Dynamic,Dynamic> &E2y,
+ 	      Matrix<T,Dynamic,Dynamic> &E4mat, VectorXi &mx, VectorXi &my,
+ 	      T *in, typename FFTW_T<T>::cpx *out, typename FFTW_T<T>::plan *fftwplan_r2c,
  	      VectorXd &Xin)
 {
   int M, Nx, Ny, Mrx, Mry, Mh, i, j, k, lx, ly, idx, idy, sign;
   double tmp, MM, f_r;
 
+  PROF_BEGIN(t_prof);
+
   M =  E1.size();
   Nx = E4mat.rows();
   Ny = E4mat.cols();
@@ -177,7 +191,12 @@ void NUFFT2d2(VectorXcd &Fout, VectorXd &E1,
     }
   }
 
-  fftw_execute(*fftwplan_r2c);
+  PROF_LAP(PROF_GRID, t_prof);
+
+  FFTW_T<T>::execute_r2c(*fftwplan_r2c, in, out);
+
+  PROF_LAP(PROF_FWD, t_prof);
+  PROF_COUNT(n_fwd);
 
   for(k = 0; k < M; k++){
     for(ly = 0; ly < 2*MSP; ly++){
@@ -210,14 +229,33 @@ void NUFFT2d2(VectorXcd &Fout, VectorXd &E1,
       }
     }
   }
+
+  PROF_LAP(PROF_GRID, t_prof);
 }
 
+template void NUFFT2d1<double>(VectorXd &, VectorXd &, MatrixXd &, MatrixXd &, MatrixXd &,
+			       VectorXi &, VectorXi &, fftw_complex *, double *, fftw_plan *,
+			       VectorXcd &);
+
+template void NUFFT2d2<double>(VectorXcd &, VectorXd &, MatrixXd &, MatrixXd &, MatrixXd &,
+			       VectorXi &, VectorXi &, double *, fftw_complex *, fftw_plan *,
+			       VectorXd &);
+
+template void NUFFT2d1<float>(VectorXd &, VectorXf &, MatrixXf &, MatrixXf &, MatrixXf &,
+			      VectorXi &, VectorXi &, fftwf_complex *, float *, fftwf_plan *,
+			      VectorXcd &);
+
+template void NUFFT2d2<float>(VectorXcd &, VectorXf &, MatrixXf &, MatrixXf &, MatrixXf &,
+			      VectorXi &, VectorXi &, float *, fftwf_complex *, fftwf_plan *,
+			      VectorXd &);
+
+template <typename T>
 double calc_F_part_nufft(VectorXcd &yAx,
-			 VectorXd &E1,
-			 MatrixXd &E2x, MatrixXd &E2y,
-			 MatrixXd &E4mat, VectorXi &mx, VectorXi &my,
- 			 double *in_r, fftw_complex *out_c,
-			 fftw_plan *fftwplan_r2c,
+			 Matrix<T,Dynamic,1> &E1,
+			 Matrix<T,Dynamic,Dynamic> &E2x, Matrix<T,Dynamic,Dynamic> &E2y,
+			 Matrix<T,Dynamic,Dynamic> &E4mat, VectorXi &mx, VectorXi &my,
+ 			 T *in_r, typename FFTW_T<T>::cpx *out_c,
+			 typename FFTW_T<T>::plan *fftwplan_r2c,
  			 VectorXcd &vis, VectorXd &weight, VectorXd &xvec)
 {
   NUFFT2d2(yAx, E1, E2x, E2y, E4mat, mx, my,
@@ -228,11 +266,12 @@ double calc_F_part_nufft(VectorXcd &yAx,
   return(yAx.squaredNorm()/2);
 }
 
+template <typename T>
 void dF_dx_nufft(VectorXd &dFdx,
-		 VectorXd &E1, MatrixXd &E2x, MatrixXd &E2y,
-		 MatrixXd &E4mat,
+		 Matrix<T,Dynamic,1> &E1, Matrix<T,Dynamic,Dynamic> &E2x, Matrix<T,Dynamic,Dynamic> &E2y,
+		 Matrix<T,Dynamic,Dynamic> &E4mat,
 		 VectorXi &mx, VectorXi &my,			 
-		 fftw_complex *in_c, double *out_r, fftw_plan *fftwplan_c2r,
+		 typename FFTW_T<T>::cpx *in_c, T *out_r, typename FFTW_T<T>::plan *fftwplan_c2r,
 		 VectorXd &weight, VectorXcd &yAx)
 {
   yAx.array() *= weight.array();
@@ -249,23 +288,43 @@ int mfista_L1_TSV_core_nufft(double *xout,
 			     double *vis_r, double *vis_i, double *vis_std,
 			     double lambda_l1, double lambda_tsv,
 			     double *cinit, double *xinit, 
-			     int nonneg_flag, int box_flag, float *cl_box)
+			     int nonneg_flag, int box_flag, float *cl_box,
+			     struct NUFFT_FFTW *nufft_fftw,
+			     struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
 {
   void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
   
-  int NN = Nx*Ny, MMh = 2*Nx*(Ny+1), i, iter;
-  double Qcore, Fval, Qval, c, tmpa, tmpb, l1cost, tsvcost, costtmp, 
-    mu=1, munew, *rvec;
+  int NN = Nx*Ny, MMh = 2*Nx*(Ny+1), i, iter, single = mfista_opt->mixed, iter_switch = 0, to_double,
+    verbose = mfista_opt->verbose, tsv_prox = (mfista_opt->tsv_prox == 1 && lambda_tsv > 0),
+    screen = (mfista_opt->screen == 1 && lambda_l1 > 0 && !tsv_prox), n_screen = 0, n_new,
+    use_active = 0, rebuild = 0,
+    gap_stop = (mfista_opt->gap > 0 && lambda_l1 > 0 && !tsv_prox),
+    res_stop = (mfista_opt->gap > 0 && !gap_stop),
+    chi2_stop = (mfista_opt->chi2 > 0), stop = STOP_MAXITER,
+    iter_start = 0, ckpt_on = (mfista_opt->ckpt_fname != NULL);
+  double Qcore, Fval = 0, Qval, c, tmpa, tmpb, l1cost, tsvcost = 0, costtmp, 
+    mu=1, munew, *rvec, F0 = 0, colnorm = 0, gap, resid = 0, Fdata = 0, chi2, Mdata = M;
+  float *rvec_f = NULL;
   fftw_complex *cvec;
+  fftwf_complex *cvec_f = NULL;
   fftw_plan fftwplan_c2r, fftwplan_r2c;
+  fftwf_plan fftwplan_c2r_f = NULL, fftwplan_r2c_f = NULL;
   unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
 
   VectorXi mx, my;
-  VectorXd E1, cost, xtmp, xnew, zvec, dfdx, dtmp, weight, xvec, box, u, v, buf_diff;
+  struct MFISTA_CKPT ckpt;
+  struct MFISTA_TRACE *trace;
+  VectorXd E1, cost, chi2v, xtmp, xnew, zvec, dfdx, dtmp, weight, xvec, box, box0, boxa, g0, u, v, buf_diff;
   VectorXcd yAx, vis;
   MatrixXd E2x, E2y, E4mat;
+  VectorXf E1f;
+  MatrixXf E2xf, E2yf, E4matf;
+  struct TSV_DCT tsv_dct;
+  vector<int> active;
 
-  cout << "Memory allocation and preparations." << endl << endl;
+  if(verbose) cout << "Memory allocation and preparations." << endl << endl;
+
+  PROF_BEGIN(t_setup);
   
   mx    = VectorXi::Zero(M);
   my    = VectorXi::Zero(M);
@@ -275,6 +334,7 @@ int mfista_L1_TSV_core_nufft(double *xout,
   E4mat = MatrixXd::Zero(Nx,Ny);
 
   cost   = VectorXd::Zero(maxiter);
+  chi2v  = VectorXd::Zero(maxiter);
   dfdx   = VectorXd::Zero(NN);
   xnew   = VectorXd::Zero(NN);
   xtmp   = VectorXd::Zero(NN);
@@ -302,25 +362,97 @@ int mfista_L1_TSV_core_nufft(double *xout,
     weight(i) = 1/vis_std[i];
   }
 
-  cout << "Preparation for FFT." << endl; 
+  if(verbose) cout << "Preparation for FFT." << endl; 
 
   // prepare for nufft
 
   preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);
 
   // for fftw
-  
-  rvec  = new double [4*NN];
-  cvec  = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
 
-  for(i = 0; i< MMh; i++) {cvec[i][0]=0;cvec[i][1]=0;}
-  for(i = 0; i< 4*NN; i++){rvec[i]=0;}
+  if(nufft_fftw == NULL){
+    rvec  = new double [4*NN];
+    cvec  = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
+
+    for(i = 0; i< MMh; i++) {cvec[i][0]=0;cvec[i][1]=0;}
+    for(i = 0; i< 4*NN; i++){rvec[i]=0;}
+
+    fftwplan_c2r = fftw_plan_dft_c2r_2d(2*Nx,2*Ny, cvec, rvec, fftw_plan_flag);
+    fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx,2*Ny, rvec, cvec, fftw_plan_flag);
+    fftw_execute(fftwplan_r2c);
+    fftw_execute(fftwplan_c2r);
+  }
+  else{
+    rvec = nufft_fftw->rvec;
+    cvec = nufft_fftw->cvec;
+
+    fftwplan_c2r = nufft_fftw->fftwplan_c2r;
+    fftwplan_r2c = nufft_fftw->fftwplan_r2c;
+  }
+
+  // single precision tables and transforms for the first phase
+
+  if(single == 1){
+    if(verbose)
+      cout << "Iterate in single precision until Delta_cost reaches float accuracy." << endl;
+
+    E1f    = E1.cast<float>();
+    E2xf   = E2x.cast<float>();
+    E2yf   = E2y.cast<float>();
+    E4matf = E4mat.cast<float>();
+
+    rvec_f = (float*) fftwf_malloc(4*NN*sizeof(float));
+    cvec_f = (fftwf_complex*) fftwf_malloc(MMh*sizeof(fftwf_complex));
+
+    for(i = 0; i< MMh; i++) {cvec_f[i][0]=0;cvec_f[i][1]=0;}
+    for(i = 0; i< 4*NN; i++){rvec_f[i]=0;}
+
+    fftwplan_c2r_f = fftwf_plan_dft_c2r_2d(2*Nx,2*Ny, cvec_f, rvec_f, fftw_plan_flag);
+    fftwplan_r2c_f = fftwf_plan_dft_r2c_2d(2*Nx,2*Ny, rvec_f, cvec_f, fftw_plan_flag);
+  }
+
+  // TSV in the prox
+
+  if(tsv_prox){
+    if(verbose) cout << "TSV is handled by the prox with DCT." << endl;
+    init_tsv_dct(Nx, Ny, fftw_plan_flag, &tsv_dct);
+  }
+
+  PROF_LAP(PROF_SETUP, t_setup);
+
+  // duality gap and gap safe screening: F(0), A'b and the column norm of [A; sqrt(2 lambda_tsv) D]
+
+  if(screen || gap_stop){
+    if(screen && box_flag == 0){
+      box = VectorXd::Ones(NN);
+      box_flag = 1;
+    }
+    box0 = box;
+    g0   = VectorXd::Zero(NN);
+
+    xtmp = VectorXd::Zero(NN);
+    F0 = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+			   rvec, cvec, &fftwplan_r2c, vis, weight, xtmp);
+    dF_dx_nufft(g0, E1, E2x, E2y, E4mat, mx, my,
+		cvec, rvec, &fftwplan_c2r, weight, yAx);
+  }
+
+  // every column of the exact A has the norm |weight|; the NUFFT error
+  // of a column grows toward the corners of the image (the deconvolution
+  // of the kernel is largest there), so the larger of |weight|^2 and
+  // |A e_0|^2 of the corner pixel, with a margin of SCREENCOLTOL, bounds
+  // |A e_j|^2 of all pixels
+
+  if(screen){
+    xtmp(0) = 1;
+    calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+		      rvec, cvec, &fftwplan_r2c, vis, weight, xtmp);
+    dF_dx_nufft(dtmp, E1, E2x, E2y, E4mat, mx, my,
+		cvec, rvec, &fftwplan_c2r, weight, yAx);
+    colnorm = sqrt(max(weight.squaredNorm(), xtmp.dot(g0 - dtmp))*(1+SCREENCOLTOL)
+		   + 8*lambda_tsv);
+  }
 
-  fftwplan_c2r = fftw_plan_dft_c2r_2d(2*Nx,2*Ny, cvec, rvec, fftw_plan_flag);
-  fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx,2*Ny, rvec, cvec, fftw_plan_flag);
-  fftw_execute(fftwplan_r2c);
-  fftw_execute(fftwplan_c2r);
-  
   // initialization
 
   if(nonneg_flag == 0)
@@ -332,17 +464,30 @@ int mfista_L1_TSV_core_nufft(double *xout,
     return(0);
   }
 
-  cout << "Done." << endl; 
-
   c = *cinit;
 
-  cout << "computing image with MFISTA with NUFFT." << endl;
-  cout << "stop if iter = " << maxiter << " or Delta_cost < " << eps << endl;
+  if(verbose){
+    cout << "Done." << endl; 
+
+    cout << "computing image with MFISTA with NUFFT." << endl;
+    if(gap_stop)
+      cout << "stop if iter = " << maxiter << " or duality gap < " << mfista_opt->gap << " cost" << endl;
+    else if(res_stop)
+      cout << "stop if iter = " << maxiter << " or |x - z| < " << mfista_opt->gap << " |x|" << endl;
+    else
+      cout << "stop if iter = " << maxiter << " or Delta_cost < " << eps << endl;
+  }
 
   // main
 
-  costtmp = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
-			      rvec, cvec, &fftwplan_r2c, vis, weight, xvec);
+  if(single == 1)
+    costtmp = calc_F_part_nufft(yAx, E1f, E2xf, E2yf, E4matf, mx, my,
+				rvec_f, cvec_f, &fftwplan_r2c_f, vis, weight, xvec);
+  else
+    costtmp = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+				rvec, cvec, &fftwplan_r2c, vis, weight, xvec);
+
+  chi2 = 2*costtmp/Mdata;
 
   l1cost = xvec.lpNorm<1>();
   costtmp += lambda_l1*l1cost;
@@ -352,57 +497,204 @@ int mfista_L1_TSV_core_nufft(double *xout,
     costtmp += lambda_tsv*tsvcost;
   }
 
-  for(iter = 0; iter < maxiter; iter++){
+  // checkpoint of the state at the top of an iteration
+
+  if(ckpt_on){
+    ckpt_add(&ckpt, &iter_start);
+    ckpt_add(&ckpt, &mu);
+    ckpt_add(&ckpt, &c);
+    ckpt_add(&ckpt, &costtmp);
+    ckpt_add(&ckpt, &chi2);
+    ckpt_add(&ckpt, xvec);
+    ckpt_add(&ckpt, zvec);
+    ckpt_add(&ckpt, cost);
+    ckpt_add(&ckpt, chi2v);
+    ckpt_add(&ckpt, &single);
+    ckpt_add(&ckpt, &iter_switch);
+    ckpt_add(&ckpt, &n_screen);
+    ckpt_add(&ckpt, box);
+
+    if(tsv_prox){
+      ckpt_add(&ckpt, tsv_dct.zvec);
+      ckpt_add(&ckpt, tsv_dct.vvec);
+      ckpt_add(&ckpt, &tsv_dct.lambda);
+    }
+
+    ckpt_key(&ckpt, "L1_TSV_nufft");
+    ckpt_key(&ckpt, lambda_l1);
+    ckpt_key(&ckpt, lambda_tsv);
+    ckpt_key(&ckpt, eps);
+    ckpt_key(&ckpt, M);
+    ckpt_key(&ckpt, nonneg_flag);
+    ckpt_key(&ckpt, box_flag);
+    ckpt_key(&ckpt, mfista_opt);
+
+    if(ckpt_open(&ckpt, mfista_opt->ckpt_fname, mfista_opt->ckpt_sec,
+		 mfista_opt->resume) < 0) ckpt_on = 0;
+  }
+
+  // once most pixels are screened out the prox and TSV work only on
+  // the pixels left (active); the transforms stay full size
+
+  rebuild = (n_screen > 0);
+
+  trace = trace_open(mfista_opt, "L1_TSV_nufft", iter_start+1);
+
+  for(iter = iter_start; iter < maxiter; iter++){
+
+    if(ckpt_on && iter > iter_start && ckpt_due(&ckpt)){
+      iter_start = iter;
+      ckpt_save(&ckpt);
+    }
 
     cost(iter) = costtmp;
 
-    if((iter % 10) == 0){
+    if(verbose && (iter % 10) == 0){
       cout << iter+1 << " cost = " << fixed << setprecision(5)
 	   << cost(iter) << ", c = " << c << endl;
     }
 
-    Qcore = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
- 			      rvec, cvec, &fftwplan_r2c, vis, weight, zvec);
+    if(single == 1){
+      Qcore = calc_F_part_nufft(yAx, E1f, E2xf, E2yf, E4matf, mx, my,
+				rvec_f, cvec_f, &fftwplan_r2c_f, vis, weight, zvec);
 
-    dF_dx_nufft(dfdx, E1, E2x, E2y, E4mat, mx, my,
- 		cvec, rvec, &fftwplan_c2r, weight, yAx);
+      dF_dx_nufft(dfdx, E1f, E2xf, E2yf, E4matf, mx, my,
+		  cvec_f, rvec_f, &fftwplan_c2r_f, weight, yAx);
+    }
+    else{
+      Qcore = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+				rvec, cvec, &fftwplan_r2c, vis, weight, zvec);
+
+      dF_dx_nufft(dfdx, E1, E2x, E2y, E4mat, mx, my,
+		  cvec, rvec, &fftwplan_c2r, weight, yAx);
+    }
+
+    if( lambda_tsv > 0.0 && !tsv_prox ){
+      PROF_BEGIN(t_reg);
+
+      if(use_active){
+	tsvcost = TSV_active(Nx, Ny, zvec, boxa, active);
+	Qcore += lambda_tsv*tsvcost;
 
-    if( lambda_tsv > 0.0 ){
-      tsvcost = TSV(Nx, Ny, zvec, buf_diff);
-      Qcore += lambda_tsv*tsvcost;
+	d_TSV_active(dtmp, Nx, Ny, zvec, active);
+	for(int p : active) dfdx(p) -= lambda_tsv*dtmp(p);
+      }
+      else{
+	tsvcost = TSV(Nx, Ny, zvec, buf_diff);
+	Qcore += lambda_tsv*tsvcost;
+
+	d_TSV(dtmp, Nx, Ny, zvec);
+	dfdx.array() -= lambda_tsv*dtmp.array();
+      }
 
-      d_TSV(dtmp, Nx, Ny, zvec);
-      dfdx.array() -= lambda_tsv*dtmp.array();
+      PROF_LAP(PROF_REG, t_reg);
     }
 
-    for(i = 0; i < maxiter; i++){
-      xtmp.array() = zvec.array() + dfdx.array()/c;
-      soft_th_box(xnew, xtmp, lambda_l1/c, box_flag, box);
+    // zvec has to be 0 outside of the CLEAN box for the bound of the gap
 
-      Fval = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
- 			       rvec, cvec, &fftwplan_r2c, vis, weight, xnew);
+    if(screen && single == 0 && (iter % SCREENITER) == 0 &&
+       (zvec.array()*(box0.array() == 0).cast<double>()).abs().maxCoeff() == 0){
+      n_new = gap_safe_screen(box, zvec, dfdx, Qcore, F0, g0, colnorm,
+			      lambda_l1, nonneg_flag, use_active ? &active : NULL);
+      if(n_new > 0) rebuild = 1;
+      n_screen += n_new;
+    }
 
-      if( lambda_tsv > 0.0 ){
-	tsvcost = TSV(Nx, Ny, xnew, buf_diff);
+    // stop when the duality gap certifies zvec (and xvec if it is better)
+
+    if(gap_stop && single == 0 && (iter % GAPITER) == 0 &&
+       (box_flag == 0 ||
+	(zvec.array()*(box.array() == 0).cast<double>()).abs().maxCoeff() == 0)){
+      gap  = dual_gap(zvec, dfdx, Qcore, F0, g0, lambda_l1, nonneg_flag,
+		      box_flag, box, NULL, use_active ? &active : NULL);
+      Fval = Qcore + lambda_l1*(use_active ? l1_active(zvec, active) : zvec.lpNorm<1>());
+
+      if(gap <= mfista_opt->gap*Fval){
+	if(Fval < cost(iter)){
+	  xvec = zvec;
+	  cost(iter) = Fval;
+	}
+	stop = STOP_GAP;
+	break;
+      }
+    }
+
+    for(i = 0; i < maxiter; i++){
+      PROF_BEGIN(t_trial);
+      PROF_COUNT(n_trial);
+
+      if(use_active)
+	for(int p : active) xtmp(p) = zvec(p) + dfdx(p)/c;
+      else
+	xtmp.array() = zvec.array() + dfdx.array()/c;
+
+      PROF_BEGIN(t_prox);
+
+      if(tsv_prox)
+	prox_TSV_L1_box(xnew, xtmp, lambda_l1/c, lambda_tsv/c, TSVITER,
+			nonneg_flag, box_flag, box, &tsv_dct);
+      else if(use_active)
+	soft_threshold_active(xnew, xtmp, lambda_l1/c, nonneg_flag, box, active);
+      else
+	soft_th_box(xnew, xtmp, lambda_l1/c, box_flag, box);
+
+      PROF_LAP(PROF_PROX, t_prox);
+
+      if(single == 1)
+	Fval = calc_F_part_nufft(yAx, E1f, E2xf, E2yf, E4matf, mx, my,
+				 rvec_f, cvec_f, &fftwplan_r2c_f, vis, weight, xnew);
+      else
+	Fval = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+				 rvec, cvec, &fftwplan_r2c, vis, weight, xnew);
+
+      Fdata = Fval;
+
+      if( lambda_tsv > 0.0 && !tsv_prox ){
+	PROF_BEGIN(t_reg);
+	if(use_active)
+	  tsvcost = TSV_active(Nx, Ny, xnew, boxa, active);
+	else
+	  tsvcost = TSV(Nx, Ny, xnew, buf_diff);
 	Fval += lambda_tsv*tsvcost;
+	PROF_LAP(PROF_REG, t_reg);
       }
 
-      Qval = calc_Q_part(xnew, zvec, c, dfdx, xtmp);
+      if(use_active)
+	Qval = calc_Q_part_active(xnew, zvec, c, dfdx, active);
+      else
+	Qval = calc_Q_part(xnew, zvec, c, dfdx, xtmp);
       Qval += Qcore;
 
-      if(Fval<=Qval) break;
+      // in float a step smaller than the rounding of F cannot be told
+      // from a failed one; accepting it keeps c from growing without end
+
+      if(Fval <= Qval + ((single == 1) ? FLOAT_NOISE*fabs(Qval) : 0)) break;
+
+      PROF_LAP(PROF_BT, t_trial);
       
       c *= ETA;
     }
 
     c /= ETA;
 
+    if(res_stop && (iter % GAPITER) == 0) resid = (xnew - zvec).norm();
+
     munew = (1+sqrt(1+4*mu*mu))/2;
     
-    l1cost = xnew.lpNorm<1>();
+    l1cost = use_active ? l1_active(xnew, active) : xnew.lpNorm<1>();
     Fval += lambda_l1*l1cost;
 
-    zvec = xvec;
+    if(tsv_prox){
+      PROF_BEGIN(t_reg);
+      tsvcost = TSV(Nx, Ny, xnew, buf_diff);
+      Fval += lambda_tsv*tsvcost;
+      PROF_LAP(PROF_REG, t_reg);
+    }
+
+    trace_iter(trace, iter+1, Fval, Fdata, l1cost, "tsv", tsvcost, c, i+1,
+	       Fval >= cost(iter));
+
+    if(!use_active) zvec = xvec;
 
     if(Fval < cost(iter)){
 
@@ -411,74 +703,208 @@ int mfista_L1_TSV_core_nufft(double *xout,
       tmpa = 1+((mu-1)/munew);
       tmpb = ((1-mu)/munew);
 
-      zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+      if(use_active)
+	for(int p : active){
+	  zvec(p) = tmpa*xnew(p) + tmpb*xvec(p);
+	  xvec(p) = xnew(p);
+	}
+      else{
+	zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+	xvec = xnew;
+      }
 
-      xvec = xnew;
+      chi2 = 2*Fdata/Mdata;
     }
     else{
 
       tmpa = mu/munew;
       tmpb = 1-(mu/munew);
 
-      zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+      if(use_active)
+	for(int p : active) zvec(p) = tmpa*xnew(p) + tmpb*xvec(p);
+      else
+	zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+
+      // another stopping rule (in double, see the switch below)
+      if(single == 0 && (iter>iter_switch+1) && (xvec.lpNorm<1>() == 0)){
+	stop = STOP_ZERO;
+	break;
+      }
+    }
+
+    // the list (and the vectors off it) change only when x, z and the
+    // trial are 0 on the pixels screened out
+
+    if(rebuild &&
+       ((xvec.array().abs() + zvec.array().abs() + xnew.array().abs())*
+	(box.array() == 0).cast<double>()).maxCoeff() == 0){
+      active_set(box, boxa, active);
+      use_active = (active.size() <= SCREENACTIVE*NN);
+      rebuild = 0;
+    }
+
+    // proximal gradient residual relative to the image
+
+    if(res_stop && single == 0 && (iter % GAPITER) == 0 &&
+       resid <= mfista_opt->gap*xnew.norm()){
+      stop = STOP_RESID;
+      break;
+    }
 
-      // another stopping rule 
-      if((iter>1) && (xvec.lpNorm<1>() == 0)) break;
+    // discrepancy principle: Mean SE in the band of the target and stable
+
+    chi2v(iter) = chi2;
+
+    if(chi2_stop && single == 0 && (iter>=iter_switch+TD) &&
+       (chi2v(iter) <= mfista_opt->chi2*(1+CHI2TOL)) &&
+       (chi2v(iter-TD)-chi2v(iter) < CHI2TOL*mfista_opt->chi2)){
+      stop = STOP_CHI2;
+      break;
+    }
+
+    // time budget: xvec has the lowest cost so far
+
+    if((iter % DEADLINEITER) == 0 && past_deadline(mfista_opt)){
+      stop = STOP_DEADLINE;
+      break;
     }
 
-    if((iter>=MINITER) && ((cost(iter-TD)-cost(iter))< eps )) break;
+    if(single == 1){
+
+      // switch to double precision when float cannot resolve Delta_cost.
+      // Only the time budget stops in float: with a large c the first
+      // steps in float may not decrease the cost at all (x stays 0), so
+      // that also switches, and the last MINITER iterations are kept
+      // for double.
+
+      to_double = (iter>=MINITER) &&
+	((cost(iter-TD)-cost(iter)) < eps + FLOAT_NOISE*fabs(cost(iter)));
+
+      to_double = to_double || (iter+1 >= maxiter-MINITER) ||
+	((iter>1) && (xvec.lpNorm<1>() == 0));
+
+      if(to_double){
+
+	single = 0;
+	iter_switch = iter+1;
+
+	if(verbose) cout << iter+1 << " switch to double precision." << endl;
+
+	trace_event(trace, "double", iter+1);
+
+	costtmp = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+				    rvec, cvec, &fftwplan_r2c, vis, weight, xvec);
+	costtmp += lambda_l1*xvec.lpNorm<1>();
+	if( lambda_tsv > 0 ) costtmp += lambda_tsv*TSV(Nx, Ny, xvec, buf_diff);
+
+	// the float tables are not used again
+
+	E1f.resize(0);
+	E2xf.resize(0,0);
+	E2yf.resize(0,0);
+	E4matf.resize(0,0);
+      }
+    }
+    else if((mfista_opt->gap == 0) && (iter>=MINITER) && (iter>=iter_switch+TD) &&
+	    ((cost(iter-TD)-cost(iter))< eps )){
+      stop = STOP_COST;
+      break;
+    }
 
     mu = munew;
   }
   if(iter == maxiter){
-    cout << iter << " cost = " << cost(iter-1) << endl;
+    if(verbose) cout << iter << " cost = " << cost(iter-1) << endl;
     iter = iter -1;
   }
-  else
+  else if(verbose)
     cout << iter+1 << " cost = "  << cost(iter) << endl;
 
-  printf("\n");
+  if(tsv_prox){
+    if(verbose)
+      cout << "average DCT passes: "
+	   << (double)tsv_dct.iter_sum/tsv_dct.ncall << endl;
+    free_tsv_dct(&tsv_dct);
+  }
+
+  if(screen && verbose)
+    cout << "screened pixels: " << n_screen << " of " << NN << endl;
+
+  if(verbose) printf("\n");
+
+  if(ckpt_on) ckpt_close(&ckpt);
+
+  trace_close(trace, stop, iter+1);
 
   *cinit = c;
 
+  mfista_result->stop_rule = stop;
+
+  mfista_result->ITER_float = (mfista_opt->mixed == 1 && iter_switch == 0) ? iter+1 : iter_switch;
+
   for(i = 0; i < NN; i++) xout[i] = xvec(i);
 
   // free memory
-  
-  delete cvec;
-  delete rvec;
 
-  fftw_destroy_plan(fftwplan_c2r);
-  fftw_destroy_plan(fftwplan_r2c);
+  if(nufft_fftw == NULL){
+    delete cvec;
+    delete rvec;
 
-  fftw_cleanup();
+    fftw_destroy_plan(fftwplan_c2r);
+    fftw_destroy_plan(fftwplan_r2c);
+
+    fftw_cleanup();
+  }
+
+  if(mfista_opt->mixed == 1){
+    fftwf_free(rvec_f);
+    fftwf_free(cvec_f);
+
+    fftwf_destroy_plan(fftwplan_c2r_f);
+    fftwf_destroy_plan(fftwplan_r2c_f);
+
+    // plans of other solves sharing the planner may still be alive
+    if(nufft_fftw == NULL) fftwf_cleanup();
+  }
 
   cout << resetiosflags(ios_base::floatfield);
 
   return(iter+1);
 }
 
-/* results */
+/* TV */
 
-void calc_result_nufft(struct RESULT *mfista_result,
-		       int M, int Nx, int Ny, double *u_dx, double *v_dy,
-		       double *vis_r, double *vis_i, double *vis_std,
-		       double lambda_l1, double lambda_tv, double lambda_tsv, 
-		       double *xvec)
+int mfista_L1_TV_core_nufft(double *xout,
+			    int M, int Nx, int Ny, double *u_dx, double *v_dy,
+			    int maxiter, double eps,
+			    double *vis_r, double *vis_i, double *vis_std,
+			    double lambda_l1, double lambda_tv,
+			    double *cinit, double *xinit,
+			    int nonneg_flag, int box_flag, float *cl_box,
+			    struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
 {
-  int i, NN = Nx*Ny;
-  double tmp, *rvec;
+  int NN = Nx*Ny, MMh = 2*Nx*(Ny+1), i, iter, aniso = mfista_opt->tv_aniso,
+    res_stop = (mfista_opt->gap > 0), chi2_stop = (mfista_opt->chi2 > 0), stop = STOP_MAXITER,
+    iter_start = 0, ckpt_on = (mfista_opt->ckpt_fname != NULL);
+  double Qcore, Fval = 0, Qval, c, tmpa, tmpb, l1cost, tvcost, costtmp,
+    mu=1, munew, *rvec, resid = 0, Fdata = 0, chi2, Mdata = M;
   fftw_complex *cvec;
-  fftw_plan fftwplan_r2c;
+  fftw_plan fftwplan_c2r, fftwplan_r2c;
   unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+  struct FGP_DUAL fgp_dual;
+  struct TV_ANISO tv_aniso;
 
   VectorXi mx, my;
-  VectorXd E1, weight, x, u, v, buf_diff;
+  struct MFISTA_CKPT ckpt;
+  struct MFISTA_TRACE *trace;
+  VectorXd E1, cost, chi2v, xtmp, xnew, zvec, dfdx, weight, xvec, box, u, v;
   VectorXcd yAx, vis;
   MatrixXd E2x, E2y, E4mat;
 
-  cout << "Memory allocation and preparations." << endl; 
-  
+  cout << "Memory allocation and preparations." << endl << endl;
+
+  PROF_BEGIN(t_setup);
+
   mx    = VectorXi::Zero(M);
   my    = VectorXi::Zero(M);
   E1    = VectorXd::Zero(M);
@@ -486,10 +912,38 @@ void calc_result_nufft(struct RESULT *mfista_result,
   E2y   = MatrixXd::Zero(M,2*MSP);
   E4mat = MatrixXd::Zero(Nx,Ny);
 
-  buf_diff = VectorXd::Zero(Nx-1);
+  cost   = VectorXd::Zero(maxiter);
+  chi2v  = VectorXd::Zero(maxiter);
+  dfdx   = VectorXd::Zero(NN);
+  xnew   = VectorXd::Zero(NN);
+  xtmp   = VectorXd::Zero(NN);
+  box    = VectorXd::Zero(NN);
+
+  yAx    = VectorXcd::Zero(M);
+  vis    = VectorXcd::Zero(M);
+  weight = VectorXd::Zero(M);
+
   u = Map<VectorXd>(u_dx,M);
   v = Map<VectorXd>(v_dy,M);
-  x = Map<VectorXd>(xvec,NN);
+  xvec = Map<VectorXd>(xinit,NN);
+  zvec = xvec;
+
+  if(box_flag == 1){
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+  }
+  else box = VectorXd::Zero(NN);
+
+  for(i = 0; i < M; i++){
+    vis(i) = complex<double>(vis_r[i],vis_i[i]);
+    weight(i) = 1/vis_std[i];
+  }
+
+  // preparation for TV
+
+  if(aniso == 1) init_tv_aniso(Nx, Ny, &tv_aniso);
+  else           init_fgp_dual(Nx, Ny, &fgp_dual);
+
+  cout << "Preparation for FFT." << endl;
 
   // prepare for nufft
 
@@ -497,90 +951,704 @@ void calc_result_nufft(struct RESULT *mfista_result,
 
   // for fftw
 
-  cvec  = (fftw_complex*) fftw_malloc(2*Nx*(Ny+1)*sizeof(fftw_complex));
-  rvec  = new double [4*NN];
+  rvec  = (double*) fftw_malloc(4*NN*sizeof(double));
+  cvec  = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
+
+  for(i = 0; i< MMh; i++) {cvec[i][0]=0;cvec[i][1]=0;}
+  for(i = 0; i< 4*NN; i++){rvec[i]=0;}
 
+  fftwplan_c2r = fftw_plan_dft_c2r_2d(2*Nx,2*Ny, cvec, rvec, fftw_plan_flag);
   fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx,2*Ny, rvec, cvec, fftw_plan_flag);
 
-  // complex malloc
+  PROF_LAP(PROF_SETUP, t_setup);
 
-  yAx    = VectorXcd::Zero(M);
-  vis    = VectorXcd::Zero(M);
-  weight = VectorXd::Zero(M);
+  // initialization
 
-  for(i = 0; i < M; i++){
-    vis(i) = complex<double>(vis_r[i],vis_i[i]);
-    weight(i) = 1/vis_std[i];
+  if(nonneg_flag != 0 && nonneg_flag != 1){
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
   }
 
-  // computing results
-  
-  tmp = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
- 			  rvec, cvec, &fftwplan_r2c, vis, weight, x);
+  c = *cinit;
 
-//   /* saving results */
+  cout << "Done." << endl;
 
-  mfista_result->sq_error = 2*tmp;
+  cout << "computing image with MFISTA with NUFFT." << endl;
+  if(res_stop)
+    cout << "stop if iter = " << maxiter << " or |x - z| < " << mfista_opt->gap << " |x|" << endl;
+  else
+    cout << "stop if iter = " << maxiter << " or Delta_cost < " << eps << endl;
 
-  mfista_result->M  = (int)(M/2);
-  mfista_result->N  = NN;
-  mfista_result->NX = Nx;
-  mfista_result->NY = Ny;
-	    
-  mfista_result->lambda_l1  = lambda_l1;
-  mfista_result->lambda_tv  = lambda_tv;
-  mfista_result->lambda_tsv = lambda_tsv;
-  
-  mfista_result->mean_sq_error = mfista_result->sq_error/((double)M);
+  // main
 
-  mfista_result->l1cost   = 0;
-  mfista_result->N_active = 0;
+  costtmp = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+			      rvec, cvec, &fftwplan_r2c, vis, weight, xvec);
 
-  for(i = 0; i < NN; i++){
-    tmp = fabs(x(i));
-    if(tmp > 0){
-      mfista_result->l1cost += tmp;
-      ++ mfista_result->N_active;
-    }
-  }
+  chi2 = 2*costtmp/Mdata;
 
-  mfista_result->finalcost = (mfista_result->sq_error)/2;
+  l1cost = xvec.lpNorm<1>();
+  costtmp += lambda_l1*l1cost;
 
-  if(lambda_l1 > 0)
-    mfista_result->finalcost += lambda_l1*(mfista_result->l1cost);
+  tvcost = (aniso == 1) ? TV_aniso(Nx, Ny, xvec) : TV(Nx, Ny, xvec);
+  costtmp += lambda_tv*tvcost;
+
+  // checkpoint of the state at the top of an iteration
+
+  if(ckpt_on){
+    ckpt_add(&ckpt, &iter_start);
+    ckpt_add(&ckpt, &mu);
+    ckpt_add(&ckpt, &c);
+    ckpt_add(&ckpt, &costtmp);
+    ckpt_add(&ckpt, &chi2);
+    ckpt_add(&ckpt, xvec);
+    ckpt_add(&ckpt, zvec);
+    ckpt_add(&ckpt, cost);
+    ckpt_add(&ckpt, chi2v);
+
+    if(aniso == 1){
+      ckpt_add(&ckpt, tv_aniso.zvec);
+      ckpt_add(&ckpt, tv_aniso.vvec);
+      ckpt_add(&ckpt, &tv_aniso.lambda);
+    }
+    else{
+      ckpt_add(&ckpt, fgp_dual.pmat);
+      ckpt_add(&ckpt, fgp_dual.qmat);
+    }
 
-  if(lambda_tsv > 0){
-    mfista_result->tsvcost = TSV(Nx, Ny, x, buf_diff);
-    mfista_result->finalcost += lambda_tsv*(mfista_result->tsvcost);
+    ckpt_key(&ckpt, "L1_TV_nufft");
+    ckpt_key(&ckpt, lambda_l1);
+    ckpt_key(&ckpt, lambda_tv);
+    ckpt_key(&ckpt, eps);
+    ckpt_key(&ckpt, M);
+    ckpt_key(&ckpt, nonneg_flag);
+    ckpt_key(&ckpt, box_flag);
+    ckpt_key(&ckpt, mfista_opt);
+
+    if(ckpt_open(&ckpt, mfista_opt->ckpt_fname, mfista_opt->ckpt_sec,
+		 mfista_opt->resume) < 0) ckpt_on = 0;
   }
-  //  else if (lambda_tv > 0){
-  //    mfista_result->tvcost = TV(Nx, Ny, x);
-  //    mfista_result->finalcost += lambda_tv*(mfista_result->tvcost);
-  //  }
-
-  // free 
 
-  delete cvec;
-  delete rvec;
+  trace = trace_open(mfista_opt, "L1_TV_nufft", iter_start+1);
 
-  fftw_destroy_plan(fftwplan_r2c);
+  for(iter = iter_start; iter < maxiter; iter++){
 
-}
+    if(ckpt_on && iter > iter_start && ckpt_due(&ckpt)){
+      iter_start = iter;
+      ckpt_save(&ckpt);
+    }
 
-/* main subroutine */
+    cost(iter) = costtmp;
 
-void mfista_imaging_core_nufft(double *u_dx, double *v_dy, 
-			       double *vis_r, double *vis_i, double *vis_std,
-			       int M, int Nx, int Ny, int maxiter, double eps,
-			       double lambda_l1, double lambda_tv, double lambda_tsv,
-			       double cinit, double *xinit, double *xout,
+    if((iter % 10) == 0){
+      cout << iter+1 << " cost = " << fixed << setprecision(5)
+	   << cost(iter) << ", c = " << c << endl;
+    }
+
+    Qcore = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+			      rvec, cvec, &fftwplan_r2c, vis, weight, zvec);
+
+    dF_dx_nufft(dfdx, E1, E2x, E2y, E4mat, mx, my,
+		cvec, rvec, &fftwplan_c2r, weight, yAx);
+
+    for(i = 0; i < maxiter; i++){
+      PROF_BEGIN(t_trial);
+      PROF_COUNT(n_trial);
+
+      xtmp.array() = zvec.array() + dfdx.array()/c;
+
+      PROF_BEGIN(t_prox);
+
+      if(aniso == 1)
+	prox_TV_aniso(xnew, xtmp, lambda_l1/c, lambda_tv/c, ANISOITER,
+		      Nx, Ny, nonneg_flag, box_flag, box, &tv_aniso);
+      else
+	FGP_L1_box(xnew, xtmp, lambda_l1/c, lambda_tv/c, FGPITER,
+		   Nx, Ny, nonneg_flag, box_flag, box, &fgp_dual);
+
+      PROF_LAP(PROF_PROX, t_prox);
+
+      Fval = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+			       rvec, cvec, &fftwplan_r2c, vis, weight, xnew);
+
+      Fdata = Fval;
+
+      Qval = calc_Q_part(xnew, zvec, c, dfdx, xtmp);
+      Qval += Qcore;
+
+      if(Fval<=Qval) break;
+
+      PROF_LAP(PROF_BT, t_trial);
+
+      c *= ETA;
+    }
+
+    c /= ETA;
+
+    if(res_stop && (iter % GAPITER) == 0) resid = (xnew - zvec).norm();
+
+    munew = (1+sqrt(1+4*mu*mu))/2;
+
+    l1cost = xnew.lpNorm<1>();
+    Fval += lambda_l1*l1cost;
+
+    PROF_BEGIN(t_reg);
+
+    tvcost = (aniso == 1) ? TV_aniso(Nx, Ny, xnew) : TV(Nx, Ny, xnew);
+    Fval += lambda_tv*tvcost;
+
+    PROF_LAP(PROF_REG, t_reg);
+
+    trace_iter(trace, iter+1, Fval, Fdata, l1cost, "tv", tvcost, c, i+1,
+	       Fval >= cost(iter));
+
+    zvec = xvec;
+
+    if(Fval < cost(iter)){
+
+      costtmp = Fval;
+
+      tmpa = 1+((mu-1)/munew);
+      tmpb = ((1-mu)/munew);
+
+      zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+
+      xvec = xnew;
+      chi2 = 2*Fdata/Mdata;
+    }
+    else{
+
+      tmpa = mu/munew;
+      tmpb = 1-(mu/munew);
+
+      zvec.array() = tmpa * xnew.array() + tmpb * zvec.array();
+
+      // another stopping rule
+      if((iter>1) && (xvec.lpNorm<1>() == 0)){
+	stop = STOP_ZERO;
+	break;
+      }
+    }
+
+    // proximal gradient residual relative to the image
+
+    if(res_stop && (iter % GAPITER) == 0 &&
+       resid <= mfista_opt->gap*xnew.norm()){
+      stop = STOP_RESID;
+      break;
+    }
+
+    // discrepancy principle: Mean SE in the band of the target and stable
+
+    chi2v(iter) = chi2;
+
+    if(chi2_stop && (iter>=TD) && (chi2v(iter) <= mfista_opt->chi2*(1+CHI2TOL)) &&
+       (chi2v(iter-TD)-chi2v(iter) < CHI2TOL*mfista_opt->chi2)){
+      stop = STOP_CHI2;
+      break;
+    }
+
+    // time budget: xvec has the lowest cost so far
+
+    if((iter % DEADLINEITER) == 0 && past_deadline(mfista_opt)){
+      stop = STOP_DEADLINE;
+      break;
+    }
+
+    if((!res_stop) && (iter>=MINITER) && ((cost(iter-TD)-cost(iter))< eps )){
+      stop = STOP_COST;
+      break;
+    }
+
+    mu = munew;
+  }
+  if(iter == maxiter){
+    cout << iter << " cost = " << cost(iter-1) << endl;
+    iter = iter -1;
+  }
+  else
+    cout << iter+1 << " cost = "  << cost(iter) << endl;
+
+  if(aniso == 1)
+    cout << "average Dykstra passes: "
+	 << (double)tv_aniso.iter_sum/tv_aniso.ncall << endl;
+  else
+    cout << "average FGP iterations: "
+	 << (double)fgp_dual.iter_sum/fgp_dual.ncall << endl;
+
+  cout << endl;
+
+  if(ckpt_on) ckpt_close(&ckpt);
+
+  trace_close(trace, stop, iter+1);
+
+  *cinit = c;
+
+  mfista_result->stop_rule = stop;
+
+  for(i = 0; i < NN; i++) xout[i] = xvec(i);
+
+  // free memory
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan_c2r);
+  fftw_destroy_plan(fftwplan_r2c);
+
+  fftw_cleanup();
+
+  cout << resetiosflags(ios_base::floatfield);
+
+  return(iter+1);
+}
+
+/* TV by the primal-dual splitting */
+
+int mfista_L1_TV_core_nufft_pd(double *xout,
+			       int M, int Nx, int Ny, double *u_dx, double *v_dy,
+			       int maxiter, double eps,
+			       double *vis_r, double *vis_i, double *vis_std,
+			       double lambda_l1, double lambda_tv,
+			       double *cinit, double *xinit,
 			       int nonneg_flag, int box_flag, float *cl_box,
-			       struct RESULT *mfista_result)
+			       struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
+{
+  int NN = Nx*Ny, MMh = 2*Nx*(Ny+1), i, iter;
+  double *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_c2r, fftwplan_r2c;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  VectorXi mx, my;
+  VectorXd E1, weight, xvec, box, u, v;
+  VectorXcd yAx, vis;
+  MatrixXd E2x, E2y, E4mat;
+
+  cout << "Memory allocation and preparations." << endl << endl;
+
+  mx    = VectorXi::Zero(M);
+  my    = VectorXi::Zero(M);
+  E1    = VectorXd::Zero(M);
+  E2x   = MatrixXd::Zero(M,2*MSP);
+  E2y   = MatrixXd::Zero(M,2*MSP);
+  E4mat = MatrixXd::Zero(Nx,Ny);
+
+  box    = VectorXd::Zero(NN);
+  yAx    = VectorXcd::Zero(M);
+  vis    = VectorXcd::Zero(M);
+  weight = VectorXd::Zero(M);
+
+  u = Map<VectorXd>(u_dx,M);
+  v = Map<VectorXd>(v_dy,M);
+  xvec = Map<VectorXd>(xinit,NN);
+
+  if(box_flag == 1)
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+
+  for(i = 0; i < M; i++){
+    vis(i) = complex<double>(vis_r[i],vis_i[i]);
+    weight(i) = 1/vis_std[i];
+  }
+
+  cout << "Preparation for FFT." << endl;
+
+  // prepare for nufft
+
+  preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);
+
+  // for fftw
+
+  rvec  = (double*) fftw_malloc(4*NN*sizeof(double));
+  cvec  = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
+
+  for(i = 0; i< MMh; i++) {cvec[i][0]=0;cvec[i][1]=0;}
+  for(i = 0; i< 4*NN; i++){rvec[i]=0;}
+
+  fftwplan_c2r = fftw_plan_dft_c2r_2d(2*Nx,2*Ny, cvec, rvec, fftw_plan_flag);
+  fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx,2*Ny, rvec, cvec, fftw_plan_flag);
+
+  // initialization
+
+  if(nonneg_flag != 0 && nonneg_flag != 1){
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
+  }
+
+  cout << "Done." << endl;
+
+  // main
+
+  iter = L1_TV_primal_dual(xvec, Nx, Ny, maxiter, eps, lambda_l1, lambda_tv,
+			   nonneg_flag, box_flag, box,
+			   [&](VectorXd &x, VectorXd &dfdx){
+			     double F = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+							  rvec, cvec, &fftwplan_r2c, vis, weight, x);
+			     dF_dx_nufft(dfdx, E1, E2x, E2y, E4mat, mx, my,
+					 cvec, rvec, &fftwplan_c2r, weight, yAx);
+			     return(F);
+			   }, cinit, mfista_opt, mfista_result);
+
+  for(i = 0; i < NN; i++) xout[i] = xvec(i);
+
+  // free memory
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan_c2r);
+  fftw_destroy_plan(fftwplan_r2c);
+
+  fftw_cleanup();
+
+  return(iter+1);
+}
+
+/* TSV (lambda_l1 = 0) by L-BFGS */
+
+int mfista_TSV_core_nufft_lbfgs(double *xout,
+				int M, int Nx, int Ny, double *u_dx, double *v_dy,
+				int maxiter, double eps,
+				double *vis_r, double *vis_i, double *vis_std,
+				double lambda_tsv,
+				double *cinit, double *xinit,
+				int nonneg_flag, int box_flag, float *cl_box,
+				struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
+{
+  int NN = Nx*Ny, MMh = 2*Nx*(Ny+1), i, iter;
+  double *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_c2r, fftwplan_r2c;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  VectorXi mx, my;
+  VectorXd E1, weight, xvec, box, u, v;
+  VectorXcd yAx, vis;
+  MatrixXd E2x, E2y, E4mat;
+
+  cout << "Memory allocation and preparations." << endl << endl;
+
+  mx    = VectorXi::Zero(M);
+  my    = VectorXi::Zero(M);
+  E1    = VectorXd::Zero(M);
+  E2x   = MatrixXd::Zero(M,2*MSP);
+  E2y   = MatrixXd::Zero(M,2*MSP);
+  E4mat = MatrixXd::Zero(Nx,Ny);
+
+  box    = VectorXd::Zero(NN);
+  yAx    = VectorXcd::Zero(M);
+  vis    = VectorXcd::Zero(M);
+  weight = VectorXd::Zero(M);
+
+  u = Map<VectorXd>(u_dx,M);
+  v = Map<VectorXd>(v_dy,M);
+  xvec = Map<VectorXd>(xinit,NN);
+
+  if(box_flag == 1)
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+
+  for(i = 0; i < M; i++){
+    vis(i) = complex<double>(vis_r[i],vis_i[i]);
+    weight(i) = 1/vis_std[i];
+  }
+
+  cout << "Preparation for FFT." << endl;
+
+  // prepare for nufft
+
+  preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);
+
+  // for fftw
+
+  rvec  = (double*) fftw_malloc(4*NN*sizeof(double));
+  cvec  = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
+
+  for(i = 0; i< MMh; i++) {cvec[i][0]=0;cvec[i][1]=0;}
+  for(i = 0; i< 4*NN; i++){rvec[i]=0;}
+
+  fftwplan_c2r = fftw_plan_dft_c2r_2d(2*Nx,2*Ny, cvec, rvec, fftw_plan_flag);
+  fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx,2*Ny, rvec, cvec, fftw_plan_flag);
+
+  // initialization
+
+  if(nonneg_flag != 0 && nonneg_flag != 1){
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
+  }
+
+  cout << "Done." << endl;
+
+  // main
+
+  iter = TSV_lbfgs_box(xvec, Nx, Ny, maxiter, eps, lambda_tsv,
+		       nonneg_flag, box_flag, box,
+		       [&](VectorXd &x, VectorXd &dfdx){
+			 double F = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+						      rvec, cvec, &fftwplan_r2c, vis, weight, x);
+			 dF_dx_nufft(dfdx, E1, E2x, E2y, E4mat, mx, my,
+				     cvec, rvec, &fftwplan_c2r, weight, yAx);
+			 return(F);
+		       }, nullptr, *cinit, mfista_opt, mfista_result);
+
+  for(i = 0; i < NN; i++) xout[i] = xvec(i);
+
+  // free memory
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan_c2r);
+  fftw_destroy_plan(fftwplan_r2c);
+
+  fftw_cleanup();
+
+  return(iter+1);
+}
+
+/* Newton polish of L1+TSV */
+
+int mfista_L1_TSV_core_nufft_newton(double *xout,
+				     int M, int Nx, int Ny, double *u_dx, double *v_dy,
+				     int maxiter, double eps,
+				     double *vis_r, double *vis_i, double *vis_std,
+				     double lambda_l1, double lambda_tsv,
+				     double *cinit, double *xinit,
+				     int nonneg_flag, int box_flag, float *cl_box,
+				     int iter_start, struct MFISTA_OPT *mfista_opt, struct RESULT *mfista_result)
+{
+  int NN = Nx*Ny, MMh = 2*Nx*(Ny+1), i, iter;
+  double *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_c2r, fftwplan_r2c;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  VectorXi mx, my;
+  VectorXd E1, weight, xvec, box, u, v;
+  VectorXcd yAx, vis;
+  MatrixXd E2x, E2y, E4mat;
+
+  cout << "Memory allocation and preparations." << endl << endl;
+
+  mx    = VectorXi::Zero(M);
+  my    = VectorXi::Zero(M);
+  E1    = VectorXd::Zero(M);
+  E2x   = MatrixXd::Zero(M,2*MSP);
+  E2y   = MatrixXd::Zero(M,2*MSP);
+  E4mat = MatrixXd::Zero(Nx,Ny);
+
+  box    = VectorXd::Zero(NN);
+  yAx    = VectorXcd::Zero(M);
+  vis    = VectorXcd::Zero(M);
+  weight = VectorXd::Zero(M);
+
+  u = Map<VectorXd>(u_dx,M);
+  v = Map<VectorXd>(v_dy,M);
+  xvec = Map<VectorXd>(xinit,NN);
+
+  if(box_flag == 1)
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+
+  for(i = 0; i < M; i++){
+    vis(i) = complex<double>(vis_r[i],vis_i[i]);
+    weight(i) = 1/vis_std[i];
+  }
+
+  cout << "Preparation for FFT." << endl;
+
+  // prepare for nufft
+
+  preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);
+
+  // for fftw
+
+  rvec  = (double*) fftw_malloc(4*NN*sizeof(double));
+  cvec  = (fftw_complex*) fftw_malloc(MMh*sizeof(fftw_complex));
+
+  for(i = 0; i< MMh; i++) {cvec[i][0]=0;cvec[i][1]=0;}
+  for(i = 0; i< 4*NN; i++){rvec[i]=0;}
+
+  fftwplan_c2r = fftw_plan_dft_c2r_2d(2*Nx,2*Ny, cvec, rvec, fftw_plan_flag);
+  fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx,2*Ny, rvec, cvec, fftw_plan_flag);
+
+  // initialization
+
+  if(nonneg_flag != 0 && nonneg_flag != 1){
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
+  }
+
+  cout << "Done." << endl;
+
+  // main
+
+  iter = L1_TSV_newton(xvec, Nx, Ny, maxiter, eps, lambda_l1, lambda_tsv,
+		       nonneg_flag, box_flag, box,
+		       [&](VectorXd &x, VectorXd &dfdx){
+			 double F = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+				  		      rvec, cvec, &fftwplan_r2c, vis, weight, x);
+			 dF_dx_nufft(dfdx, E1, E2x, E2y, E4mat, mx, my,
+				       cvec, rvec, &fftwplan_c2r, weight, yAx);
+			 return(F);
+		       }, cinit, iter_start, mfista_opt, mfista_result);
+
+  for(i = 0; i < NN; i++) xout[i] = xvec(i);
+
+  // free memory
+
+  fftw_free(cvec);
+  fftw_free(rvec);
+
+  fftw_destroy_plan(fftwplan_c2r);
+  fftw_destroy_plan(fftwplan_r2c);
+
+  fftw_cleanup();
+
+  return(iter+1);
+}
+
+/* results */
+
+void calc_result_nufft(struct RESULT *mfista_result,
+		       int M, int Nx, int Ny, double *u_dx, double *v_dy,
+		       double *vis_r, double *vis_i, double *vis_std,
+		       double lambda_l1, double lambda_tv, double lambda_tsv, 
+		       double *xvec, struct NUFFT_FFTW *nufft_fftw)
+{
+  int i, NN = Nx*Ny;
+  double tmp, *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_r2c;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  VectorXi mx, my;
+  VectorXd E1, weight, x, u, v, buf_diff;
+  VectorXcd yAx, vis;
+  MatrixXd E2x, E2y, E4mat;
+
+  if(nufft_fftw == NULL)
+    cout << "Memory allocation and preparations." << endl; 
+  
+  mx    = VectorXi::Zero(M);
+  my    = VectorXi::Zero(M);
+  E1    = VectorXd::Zero(M);
+  E2x   = MatrixXd::Zero(M,2*MSP);
+  E2y   = MatrixXd::Zero(M,2*MSP);
+  E4mat = MatrixXd::Zero(Nx,Ny);
+
+  buf_diff = VectorXd::Zero(Nx-1);
+  u = Map<VectorXd>(u_dx,M);
+  v = Map<VectorXd>(v_dy,M);
+  x = Map<VectorXd>(xvec,NN);
+
+  // prepare for nufft
+
+  preNUFFT(u, v, E1, E2x, E2y, E4mat, mx, my);
+
+  // for fftw
+
+  if(nufft_fftw == NULL){
+    cvec  = (fftw_complex*) fftw_malloc(2*Nx*(Ny+1)*sizeof(fftw_complex));
+    rvec  = new double [4*NN];
+
+    fftwplan_r2c = fftw_plan_dft_r2c_2d(2*Nx,2*Ny, rvec, cvec, fftw_plan_flag);
+  }
+  else{
+    cvec = nufft_fftw->cvec;
+    rvec = nufft_fftw->rvec;
+
+    fftwplan_r2c = nufft_fftw->fftwplan_r2c;
+  }
+
+  // complex malloc
+
+  yAx    = VectorXcd::Zero(M);
+  vis    = VectorXcd::Zero(M);
+  weight = VectorXd::Zero(M);
+
+  for(i = 0; i < M; i++){
+    vis(i) = complex<double>(vis_r[i],vis_i[i]);
+    weight(i) = 1/vis_std[i];
+  }
+
+  // computing results
+  
+  tmp = calc_F_part_nufft(yAx, E1, E2x, E2y, E4mat, mx, my,
+ 			  rvec, cvec, &fftwplan_r2c, vis, weight, x);
+
+//   /* saving results */
+
+  mfista_result->sq_error = 2*tmp;
+
+  mfista_result->M  = (int)(M/2);
+  mfista_result->N  = NN;
+  mfista_result->NX = Nx;
+  mfista_result->NY = Ny;
+	    
+  mfista_result->lambda_l1  = lambda_l1;
+  mfista_result->lambda_tv  = lambda_tv;
+  mfista_result->lambda_tsv = lambda_tsv;
+  
+  mfista_result->mean_sq_error = mfista_result->sq_error/((double)M);
+
+  mfista_result->l1cost   = 0;
+  mfista_result->N_active = 0;
+
+  for(i = 0; i < NN; i++){
+    tmp = fabs(x(i));
+    if(tmp > 0){
+      mfista_result->l1cost += tmp;
+      ++ mfista_result->N_active;
+    }
+  }
+
+  mfista_result->finalcost = (mfista_result->sq_error)/2;
+
+  if(lambda_l1 > 0)
+    mfista_result->finalcost += lambda_l1*(mfista_result->l1cost);
+
+  if(lambda_tsv > 0){
+    mfista_result->tsvcost = TSV(Nx, Ny, x, buf_diff);
+    mfista_result->finalcost += lambda_tsv*(mfista_result->tsvcost);
+  }
+  else if (lambda_tv > 0){
+    if(mfista_result->tv_aniso == 1)
+      mfista_result->tvcost = TV_aniso(Nx, Ny, x);
+    else
+      mfista_result->tvcost = TV(Nx, Ny, x);
+    mfista_result->finalcost += lambda_tv*(mfista_result->tvcost);
+  }
+
+  // free 
+
+  if(nufft_fftw == NULL){
+    delete cvec;
+    delete rvec;
+
+    fftw_destroy_plan(fftwplan_r2c);
+  }
+
+}
+
+/* main subroutine */
+
+void mfista_imaging_core_nufft_opt(double *u_dx, double *v_dy, 
+				   double *vis_r, double *vis_i, double *vis_std,
+				   int M, int Nx, int Ny, int maxiter, double eps,
+				   double lambda_l1, double lambda_tv, double lambda_tsv,
+				   double cinit, double *xinit, double *xout,
+				   int nonneg_flag, int box_flag, float *cl_box,
+				   struct MFISTA_OPT *mfista_opt,
+				   struct RESULT *mfista_result)
 {
-  int i, iter = 0;
+  int i, iter = 0, newton;
   double epsilon, s_t, e_t, c = cinit;
   struct timespec time_spec1, time_spec2;
 
+  // the time budget includes the preparations
+
+  get_current_time(&mfista_opt->t_start);
+
+  prof_reset();
+
   // start main part */
 
   epsilon = 0;
@@ -590,32 +1658,82 @@ void mfista_imaging_core_nufft(double *u_dx, double *v_dy,
 
   get_current_time(&time_spec1);
 
-  if( lambda_tv == 0 ){
-    iter = mfista_L1_TSV_core_nufft(xout, M, Nx, Ny, u_dx, v_dy, maxiter, epsilon, vis_r, vis_i, vis_std,
-				    lambda_l1, lambda_tsv, &c, xinit, nonneg_flag, box_flag, cl_box);
+  if( lambda_tv == 0 && lambda_l1 == 0 && mfista_opt->lbfgs == 1 &&
+      !opt_mfista_only(mfista_opt, "L-BFGS", 1) ){
+    iter = mfista_TSV_core_nufft_lbfgs(xout, M, Nx, Ny, u_dx, v_dy, maxiter, epsilon, vis_r, vis_i, vis_std,
+				       lambda_tsv, &c, xinit, nonneg_flag, box_flag, cl_box,
+				       mfista_opt, mfista_result);
+  }
+  else if( lambda_tv == 0 ){
+    newton = (mfista_opt->newton == 1 && !opt_mfista_only(mfista_opt, "-newton", 0));
+
+    iter = mfista_L1_TSV_core_nufft(xout, M, Nx, Ny, u_dx, v_dy, maxiter,
+				    (newton == 1) ? NEWTONWARM*epsilon : epsilon,
+				    vis_r, vis_i, vis_std,
+				    lambda_l1, lambda_tsv, &c, xinit, nonneg_flag, box_flag, cl_box,
+				    NULL, mfista_opt, mfista_result);
+
+    if(newton == 1 && !past_deadline(mfista_opt))
+      iter += mfista_L1_TSV_core_nufft_newton(xout, M, Nx, Ny, u_dx, v_dy, maxiter, epsilon,
+					      vis_r, vis_i, vis_std,
+					      lambda_l1, lambda_tsv, &c, xout, nonneg_flag, box_flag, cl_box,
+					      iter+1, mfista_opt, mfista_result);
+  }
+  else if( lambda_tv != 0  && lambda_tsv == 0 && mfista_opt->primal_dual == 1 &&
+	   !opt_mfista_only(mfista_opt, "-pd", 1) ){
+    iter = mfista_L1_TV_core_nufft_pd(xout, M, Nx, Ny, u_dx, v_dy, maxiter, epsilon, vis_r, vis_i, vis_std,
+				      lambda_l1, lambda_tv, &c, xinit, nonneg_flag, box_flag, cl_box,
+				      mfista_opt, mfista_result);
+  }
+  else if( lambda_tv != 0  && lambda_tsv == 0 ){
+    iter = mfista_L1_TV_core_nufft(xout, M, Nx, Ny, u_dx, v_dy, maxiter, epsilon, vis_r, vis_i, vis_std,
+				   lambda_l1, lambda_tv, &c, xinit, nonneg_flag, box_flag, cl_box,
+				   mfista_opt, mfista_result);
   }
-  //  else if( lambda_tv != 0  && lambda_tsv == 0 ){
-  //    iter = mfista_L1_TV_core_nufft(xout, M, Nx, Ny, u_dx, v_dy, maxiter, epsilon, vis_r, vis_i, vis_std,
-  //                                   lambda_l1, lambda_tv, &c, xinit, nonneg_flag, box_flag, cl_box);
-  //}
   else{
-    cout << "We have not implemented TV option." << endl;
-    // printf("You cannot set both of lambda_TV and lambda_TSV positive.\n");
+    cout << "You cannot set both of lambda_TV and lambda_TSV positive." << endl;
     return;
   }
 
   get_current_time(&time_spec2);
 
-  s_t = (double)time_spec1.tv_sec + (10e-10)*(double)time_spec1.tv_nsec;
-  e_t = (double)time_spec2.tv_sec + (10e-10)*(double)time_spec2.tv_nsec;
+  s_t = (double)time_spec1.tv_sec + (1.0e-9)*(double)time_spec1.tv_nsec;
+  e_t = (double)time_spec2.tv_sec + (1.0e-9)*(double)time_spec2.tv_nsec;
 
   mfista_result->comp_time = e_t-s_t;
   mfista_result->ITER      = iter;
   mfista_result->nonneg    = nonneg_flag;
+  mfista_result->tv_aniso  = mfista_opt->tv_aniso;
   mfista_result->Lip_const = c;
   mfista_result->maxiter   = maxiter;
+  mfista_result->prof      = mfista_prof;
 
   calc_result_nufft(mfista_result, M, Nx, Ny, u_dx, v_dy, vis_r, vis_i, vis_std,
-		    lambda_l1, lambda_tv, lambda_tsv, xout);
+		    lambda_l1, lambda_tv, lambda_tsv, xout, NULL);
+
+}
+
+void mfista_imaging_core_nufft(double *u_dx, double *v_dy, 
+			       double *vis_r, double *vis_i, double *vis_std,
+			       int M, int Nx, int Ny, int maxiter, double eps,
+			       double lambda_l1, double lambda_tv, double lambda_tsv,
+			       double cinit, double *xinit, double *xout,
+			       int nonneg_flag, int box_flag, float *cl_box,
+			       struct RESULT *mfista_result)
+{
+  struct MFISTA_OPT mfista_opt;
+  struct RESULT result;
+
+  init_opt(&mfista_opt);
+
+  // the caller's RESULT may end at Lip_const
+
+  memcpy(&result, mfista_result, RESULT_LEGACY);
+
+  mfista_imaging_core_nufft_opt(u_dx, v_dy, vis_r, vis_i, vis_std,
+				M, Nx, Ny, maxiter, eps, lambda_l1, lambda_tv, lambda_tsv,
+				cinit, xinit, xout, nonneg_flag, box_flag, cl_box,
+				&mfista_opt, &result);
 
+  memcpy(mfista_result, &result, RESULT_LEGACY);
 }
@@ -0,0 +1,643 @@
+#include "mfista.hpp"
+#include <iomanip>
+
+#ifdef PTHREAD
+#include <thread>
+#endif
+
+// mfista_nufft_movie_lib
+//
+// Movie (time-series) imaging, ported from matlab/MFISTA_movie_eht.m.
+// Nt frames of Nx x Ny are solved together and coupled by
+//
+//   lambda_t sum_t |x_t - x_{t+1}|^2/(t_{t+1} - t_t).
+//
+// Every frame has its own uv coverage and gridding tables, but the Nt
+// 2Nx x 2Ny transforms are done with one fftw_plan_many_dft plan, and
+// the gridding of the frames runs in parallel.
+//
+// Visibilities of frame t are stored at offset sum_{s<t} M[s] and the
+// image of frame t at offset t*Nx*Ny.
+
+struct MOVIE_NUFFT{
+  int Nt;
+  int Nx;
+  int Ny;
+  vector<VectorXd> E1;
+  vector<MatrixXd> E2x;
+  vector<MatrixXd> E2y;
+  vector<VectorXi> mx;
+  vector<VectorXi> my;
+  MatrixXd E4mat;
+  double *rvec;
+  fftw_complex *cvec;
+  fftw_plan fftwplan_c2r;
+  fftw_plan fftwplan_r2c;
+};
+
+// run func(t) for all the frames, split over THREAD_NUM threads
+
+template <typename F>
+void for_each_frame(int Nt, F func)
+{
+#ifdef PTHREAD
+  int w, n_thread = (Nt < THREAD_NUM) ? Nt : THREAD_NUM;
+  vector<thread> workers;
+
+  for(w = 0; w < n_thread; w++)
+    workers.push_back(thread([=, &func](){
+	  for(int s = (Nt*w)/n_thread; s < (Nt*(w+1))/n_thread; s++) func(s);
+	}));
+
+  for(w = 0; w < n_thread; w++) workers[w].join();
+#else
+  for(int t = 0; t < Nt; t++) func(t);
+#endif
+}
+
+void NUFFT2d1_movie(vector<VectorXd> &Xout, struct MOVIE_NUFFT *mnufft,
+		    vector<VectorXcd> &Fin)
+{
+  int Nx = mnufft->Nx, Ny = mnufft->Ny,
+    Mrx = 2*Nx, Mry = 2*Ny, Mh = Ny+1, MMh = Mrx*Mh, MM4 = Mrx*Mry;
+  double MM = (double)(Mrx*Mry);
+
+  // gridding of every frame into its own slab
+
+  for_each_frame(mnufft->Nt, [&](int t){
+      int j, k, lx, ly, idx, idy, sign;
+      complex<double> v0, vy, tmpc;
+      fftw_complex *in = mnufft->cvec + t*MMh;
+      VectorXd &E1  = mnufft->E1[t];
+      MatrixXd &E2x = mnufft->E2x[t];
+      MatrixXd &E2y = mnufft->E2y[t];
+      VectorXi &mx  = mnufft->mx[t];
+      VectorXi &my  = mnufft->my[t];
+
+      for(j = 0; j < MMh; j++){
+	in[j][0] = 0;
+	in[j][1] = 0;
+      }
+
+      for(k = 0; k < E1.size(); k++){
+
+	if(NU_SIGN == 1) v0 = E1(k)*Fin[t](k);
+	else             v0 = E1(k)*conj(Fin[t](k));
+
+	for(ly = 0; ly < 2*MSP; ly++){
+
+	  vy = v0*E2y(k, ly)/2.0;
+
+	  for(sign = -1; sign < 2; sign +=2){
+	    idy = idx_fftw(sign*(my(k)+ly-MSP+1),Mry);
+
+	    if(idy < (Ny+1))
+	      for(lx = 0; lx < 2*MSP; lx++){
+		idx = idx_fftw(sign*(mx(k)+lx-MSP+1),Mrx);
+		tmpc = vy*E2x(k,lx);
+		in[idx*Mh + idy][0] += real(tmpc);
+		in[idx*Mh + idy][1] += sign*imag(tmpc);
+	      }
+	  }
+	}
+      }
+    });
+
+  fftw_execute(mnufft->fftwplan_c2r);
+
+  for_each_frame(mnufft->Nt, [&](int t){
+      int j, k, idx, idy;
+      double *out = mnufft->rvec + t*MM4;
+
+      for(k = 0; k < Nx; k++){
+	idx = m2mr(k,Nx);
+	for(j = 0; j < Ny; j++){
+	  idy = m2mr(j,Ny);
+	  Xout[t](k*Ny + j) = out[idx*Mry + idy]*mnufft->E4mat(k,j)/MM;
+	}
+      }
+    });
+}
+
+void NUFFT2d2_movie(vector<VectorXcd> &Fout, struct MOVIE_NUFFT *mnufft,
+		    vector<VectorXd> &Xin)
+{
+  int Nx = mnufft->Nx, Ny = mnufft->Ny,
+    Mrx = 2*Nx, Mry = 2*Ny, Mh = Ny+1, MMh = Mrx*Mh, MM4 = Mrx*Mry;
+  double MM = (double)(Mrx*Mry);
+
+  for_each_frame(mnufft->Nt, [&](int t){
+      int i, j, idx, idy;
+      double *in = mnufft->rvec + t*MM4;
+
+      for(i = 0; i < MM4; i++) in[i] = 0;
+
+      for(i = 0; i < Nx; i++){
+	idx = m2mr(i,Nx);
+	for(j = 0; j < Ny; j++){
+	  idy = m2mr(j,Ny);
+	  in[idx*Mry + idy] = Xin[t](i*Ny + j)*mnufft->E4mat(i,j);
+	}
+      }
+    });
+
+  fftw_execute(mnufft->fftwplan_r2c);
+
+  // degridding of every frame from its own slab
+
+  for_each_frame(mnufft->Nt, [&](int t){
+      int j, k, lx, ly, idx, idy, sign = 1;
+      double tmp, f_r;
+      fftw_complex *out = mnufft->cvec + t*MMh;
+      VectorXd &E1  = mnufft->E1[t];
+      MatrixXd &E2x = mnufft->E2x[t];
+      MatrixXd &E2y = mnufft->E2y[t];
+      VectorXi &mx  = mnufft->mx[t];
+      VectorXi &my  = mnufft->my[t];
+
+      Fout[t].setZero();
+
+      for(k = 0; k < E1.size(); k++){
+	for(ly = 0; ly < 2*MSP; ly++){
+
+	  idy = -1;
+
+	  j = idx_fftw((my(k)+ly-MSP+1),Mry);
+	  if(j < (Ny+1)){
+	    idy = j;
+	    sign = 1;
+	  }
+	  else{
+	    j = idx_fftw(-(my(k)+ly-MSP+1),Mry);
+	    if(j < (Ny+1)){
+	      idy = j;
+	      sign = -1;
+	    }
+	  }
+
+	  if( idy >= 0){
+	    f_r = E1(k)*E2y(k,ly)/MM;
+	    for(lx = 0; lx < 2*MSP; lx++){
+
+	      idx = idx_fftw(sign*(mx(k)+lx-MSP+1),Mrx);
+	      tmp = f_r*E2x(k,lx);
+
+	      Fout[t](k) += complex<double>
+		(out[idx*Mh + idy][0], sign*(NU_SIGN)*out[idx*Mh + idy][1])*tmp;
+	    }
+	  }
+	}
+      }
+    });
+}
+
+double calc_F_part_nufft_movie(vector<VectorXcd> &yAx, struct MOVIE_NUFFT *mnufft,
+			       vector<VectorXcd> &vis, vector<VectorXd> &weight,
+			       vector<VectorXd> &xvec)
+{
+  int t;
+  double Fval = 0;
+
+  NUFFT2d2_movie(yAx, mnufft, xvec);
+
+  for(t = 0; t < mnufft->Nt; t++){
+    yAx[t] = (vis[t].array() - yAx[t].array())*weight[t].array();
+    Fval += yAx[t].squaredNorm()/2;
+  }
+
+  return(Fval);
+}
+
+void dF_dx_nufft_movie(vector<VectorXd> &dFdx, struct MOVIE_NUFFT *mnufft,
+		       vector<VectorXd> &weight, vector<VectorXcd> &yAx)
+{
+  int t;
+
+  for(t = 0; t < mnufft->Nt; t++) yAx[t].array() *= weight[t].array();
+
+  NUFFT2d1_movie(dFdx, mnufft, yAx);
+}
+
+/* TSV and temporal smoothness */
+
+// lambda_tsv sum_t TSV(x_t) + lambda_t sum_t |x_t - x_{t+1}|^2 inv_dt(t)
+
+double TSV_movie(int Nx, int Ny, int Nt, vector<VectorXd> &xvec, VectorXd &inv_dt,
+		 double lambda_tsv, double lambda_t, double *tcost)
+{
+  int t;
+  VectorXd tsv = VectorXd::Zero(Nt), dX = VectorXd::Zero(Nt);
+
+  for_each_frame(Nt, [&](int t){
+      VectorXd buf_diff = VectorXd::Zero(Nx-1);
+
+      if(lambda_tsv > 0) tsv(t) = TSV(Nx, Ny, xvec[t], buf_diff);
+      if(lambda_t > 0 && t < Nt-1)
+	dX(t) = (xvec[t] - xvec[t+1]).squaredNorm()*inv_dt(t);
+    });
+
+  for(t = 0, *tcost = 0; t < Nt; t++) *tcost += dX(t);
+
+  return(lambda_tsv*tsv.sum() + lambda_t*(*tcost));
+}
+
+// dFdx -= d/dx of the above, with the spatial and the temporal
+// differences of a pixel taken in the same pass.
+
+void d_TSV_movie(vector<VectorXd> &dFdx, int Nx, int Ny, int Nt,
+		 vector<VectorXd> &xvec, VectorXd &inv_dt,
+		 double lambda_tsv, double lambda_t)
+{
+  for_each_frame(Nt, [&](int t){
+      int i, j, k;
+      double xk, ds, dt, wp = 0, wm = 0;
+      double *x = xvec[t].data(), *xp = NULL, *xm = NULL, *df = dFdx[t].data();
+
+      if(t < Nt-1){ xp = xvec[t+1].data(); wp = 2*lambda_t*inv_dt(t);}
+      if(t > 0)   { xm = xvec[t-1].data(); wm = 2*lambda_t*inv_dt(t-1);}
+
+      for(j = 0; j < Ny; j++)
+	for(i = 0; i < Nx; i++){
+	  k  = Nx*j + i;
+	  xk = x[k];
+	  ds = 0;
+	  dt = 0;
+
+	  if(lambda_tsv > 0){
+	    if(i < Nx-1) ds += xk - x[k+1];
+	    if(i > 0)    ds += xk - x[k-1];
+	    if(j < Ny-1) ds += xk - x[k+Nx];
+	    if(j > 0)    ds += xk - x[k-Nx];
+	  }
+
+	  if(xp != NULL) dt += wp*(xk - xp[k]);
+	  if(xm != NULL) dt += wm*(xk - xm[k]);
+
+	  df[k] -= 2*lambda_tsv*ds + dt;
+	}
+    });
+}
+
+int mfista_L1_TSV_core_nufft_movie(double *xout, int Nt, int *M, int Nx, int Ny,
+				   double *u_dx, double *v_dy,
+				   int maxiter, double eps,
+				   double *vis_r, double *vis_i, double *vis_std,
+				   double lambda_l1, double lambda_tsv, double lambda_t,
+				   VectorXd &inv_dt, double *cinit, double *xinit,
+				   int nonneg_flag, int box_flag, float *cl_box,
+				   struct RESULT *mfista_result)
+{
+  void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
+
+  int NN = Nx*Ny, MMh = 2*Nx*(Ny+1), n[2] = {2*Nx, 2*Ny},
+    i, t, iter, offset;
+  double Qval, Qcore, Fval, tmpa, tmpb, costtmp, tcost, c = *cinit, mu = 1, munew;
+  unsigned int fftw_plan_flag = FFTW_ESTIMATE | FFTW_DESTROY_INPUT;
+
+  VectorXd box, cost, u, v;
+  vector<VectorXd> xvec(Nt), zvec(Nt), xnew(Nt), xtmp(Nt), dfdx(Nt), weight(Nt);
+  vector<VectorXcd> yAx(Nt), vis(Nt);
+  struct MOVIE_NUFFT mnufft;
+
+  cout << "Memory allocation and preparations for " << Nt << " frames." << endl << endl;
+
+  cost = VectorXd::Zero(maxiter);
+  box  = VectorXd::Zero(NN);
+
+  mnufft.Nt = Nt;
+  mnufft.Nx = Nx;
+  mnufft.Ny = Ny;
+  mnufft.E1.resize(Nt);
+  mnufft.E2x.resize(Nt);
+  mnufft.E2y.resize(Nt);
+  mnufft.mx.resize(Nt);
+  mnufft.my.resize(Nt);
+  mnufft.E4mat = MatrixXd::Zero(Nx,Ny);
+
+  for(t = 0, offset = 0; t < Nt; offset += M[t], t++){
+    xvec[t] = Map<VectorXd>(xinit + t*NN, NN);
+    zvec[t] = xvec[t];
+    xnew[t] = VectorXd::Zero(NN);
+    xtmp[t] = VectorXd::Zero(NN);
+    dfdx[t] = VectorXd::Zero(NN);
+
+    yAx[t]    = VectorXcd::Zero(M[t]);
+    vis[t]    = VectorXcd::Zero(M[t]);
+    weight[t] = VectorXd::Zero(M[t]);
+
+    for(i = 0; i < M[t]; i++){
+      vis[t](i)    = complex<double>(vis_r[offset + i], vis_i[offset + i]);
+      weight[t](i) = 1/vis_std[offset + i];
+    }
+
+    mnufft.mx[t]  = VectorXi::Zero(M[t]);
+    mnufft.my[t]  = VectorXi::Zero(M[t]);
+    mnufft.E1[t]  = VectorXd::Zero(M[t]);
+    mnufft.E2x[t] = MatrixXd::Zero(M[t],2*MSP);
+    mnufft.E2y[t] = MatrixXd::Zero(M[t],2*MSP);
+  }
+
+  if(box_flag == 1){
+    for(i = 0; i < NN; i++) box(i) = (double)cl_box[i];
+  }
+  else box = VectorXd::Zero(NN);
+
+  cout << "Preparation for FFT." << endl;
+
+  // gridding tables of every frame
+
+  for(t = 0, offset = 0; t < Nt; offset += M[t], t++){
+    u = Map<VectorXd>(u_dx + offset, M[t]);
+    v = Map<VectorXd>(v_dy + offset, M[t]);
+
+    preNUFFT(u, v, mnufft.E1[t], mnufft.E2x[t], mnufft.E2y[t], mnufft.E4mat,
+	     mnufft.mx[t], mnufft.my[t]);
+  }
+
+  // Nt transforms with one plan
+
+  mnufft.rvec = (double*) fftw_malloc(Nt*4*NN*sizeof(double));
+  mnufft.cvec = (fftw_complex*) fftw_malloc(Nt*MMh*sizeof(fftw_complex));
+
+  for(i = 0; i< Nt*MMh; i++) {mnufft.cvec[i][0]=0;mnufft.cvec[i][1]=0;}
+  for(i = 0; i< Nt*4*NN; i++){mnufft.rvec[i]=0;}
+
+#ifdef PTHREAD
+  if(fftw_init_threads()==0)
+    cout << "Could not initialize multi threads for fftw3." << endl;
+
+  fftw_plan_with_nthreads(THREAD_NUM);
+#endif
+
+  mnufft.fftwplan_c2r = fftw_plan_many_dft_c2r(2, n, Nt, mnufft.cvec, NULL, 1, MMh,
+					       mnufft.rvec, NULL, 1, 4*NN, fftw_plan_flag);
+  mnufft.fftwplan_r2c = fftw_plan_many_dft_r2c(2, n, Nt, mnufft.rvec, NULL, 1, 4*NN,
+					       mnufft.cvec, NULL, 1, MMh, fftw_plan_flag);
+
+  // initialization
+
+  if(nonneg_flag == 0)
+    soft_th_box =soft_threshold_box;
+  else if(nonneg_flag == 1)
+    soft_th_box =soft_threshold_nonneg_box;
+  else {
+    cout << "nonneg_flag must be chosen properly." << endl;
+    return(0);
+  }
+
+  cout << "Done." << endl;
+
+  cout << "computing " << Nt << " frames with MFISTA with NUFFT." << endl;
+  cout << "stop if iter = " << maxiter << ", or Delta_cost < " << eps << endl;
+
+  // main
+
+  costtmp = calc_F_part_nufft_movie(yAx, &mnufft, vis, weight, xvec);
+
+  for(t = 0; t < Nt; t++) costtmp += lambda_l1*xvec[t].lpNorm<1>();
+
+  costtmp += TSV_movie(Nx, Ny, Nt, xvec, inv_dt, lambda_tsv, lambda_t, &tcost);
+
+  for(iter = 0; iter < maxiter; iter++){
+
+    cost(iter) = costtmp;
+
+    if((iter % 10) == 0)
+      cout << iter+1 << " cost = " << fixed << setprecision(5)
+	   << cost(iter) << ", c = " << c << endl;
+
+    Qcore = calc_F_part_nufft_movie(yAx, &mnufft, vis, weight, zvec);
+
+    dF_dx_nufft_movie(dfdx, &mnufft, weight, yAx);
+
+    Qcore += TSV_movie(Nx, Ny, Nt, zvec, inv_dt, lambda_tsv, lambda_t, &tcost);
+
+    d_TSV_movie(dfdx, Nx, Ny, Nt, zvec, inv_dt, lambda_tsv, lambda_t);
+
+    // backtracking with one c for all the frames
+
+    for(i = 0; i < maxiter; i++){
+
+      for(t = 0; t < Nt; t++){
+	xtmp[t].array() = zvec[t].array() + dfdx[t].array()/c;
+	soft_th_box(xnew[t], xtmp[t], lambda_l1/c, box_flag, box);
+      }
+
+      Fval = calc_F_part_nufft_movie(yAx, &mnufft, vis, weight, xnew);
+
+      Fval += TSV_movie(Nx, Ny, Nt, xnew, inv_dt, lambda_tsv, lambda_t, &tcost);
+
+      Qval = Qcore;
+      for(t = 0; t < Nt; t++)
+	Qval += calc_Q_part(xnew[t], zvec[t], c, dfdx[t], xtmp[t]);
+
+      if(Fval<=Qval) break;
+
+      c *= ETA;
+    }
+
+    c /= ETA;
+
+    munew = (1+sqrt(1+4*mu*mu))/2;
+
+    for(t = 0; t < Nt; t++) Fval += lambda_l1*xnew[t].lpNorm<1>();
+
+    if(Fval < cost(iter)){
+
+      costtmp = Fval;
+
+      tmpa = 1+((mu-1)/munew);
+      tmpb = ((1-mu)/munew);
+
+      for(t = 0; t < Nt; t++){
+	zvec[t].array() = tmpa * xnew[t].array() + tmpb * xvec[t].array();
+	xvec[t] = xnew[t];
+      }
+    }
+    else{
+
+      tmpa = mu/munew;
+      tmpb = 1-(mu/munew);
+
+      for(t = 0; t < Nt; t++)
+	zvec[t].array() = tmpa * xnew[t].array() + tmpb * xvec[t].array();
+    }
+
+    // stopping rule
+
+    if((iter>=MINITER) && ((cost(iter-TD)-cost(iter))< eps )) break;
+
+    mu = munew;
+  }
+  if(iter == maxiter) iter--;
+
+  cout << "converged after " << iter+1 << " iterations. cost = "
+       << cost(iter) << endl;
+
+  *cinit = c;
+
+  for(t = 0; t < Nt; t++)
+    for(i = 0; i < NN; i++) xout[t*NN + i] = xvec[t](i);
+
+  // squared error of the result while the transforms are at hand
+
+  mfista_result->sq_error = 2*calc_F_part_nufft_movie(yAx, &mnufft, vis, weight, xvec);
+
+  // free memory
+
+  fftw_free(mnufft.cvec);
+  fftw_free(mnufft.rvec);
+
+  fftw_destroy_plan(mnufft.fftwplan_c2r);
+  fftw_destroy_plan(mnufft.fftwplan_r2c);
+
+#ifdef PTHREAD
+  fftw_cleanup_threads();
+#else
+  fftw_cleanup();
+#endif
+
+  cout << resetiosflags(ios_base::floatfield);
+
+  return(iter+1);
+}
+
+/* results */
+
+void calc_result_nufft_movie(struct RESULT *mfista_result, int Nt, int *M,
+			     int Nx, int Ny,
+			     double lambda_l1, double lambda_tv, double lambda_tsv,
+			     double lambda_t, VectorXd &inv_dt, double *xout)
+{
+  int i, t, M_all = 0, NN = Nx*Ny;
+  double tmp, tcost;
+  VectorXd buf_diff;
+  vector<VectorXd> x(Nt);
+
+  buf_diff = VectorXd::Zero(Nx-1);
+
+  for(t = 0; t < Nt; t++){
+    x[t] = Map<VectorXd>(xout + t*NN, NN);
+    M_all += M[t];
+  }
+
+  mfista_result->M  = (int)(M_all/2);
+  mfista_result->N  = Nt*NN;
+  mfista_result->NX = Nx;
+  mfista_result->NY = Ny;
+
+  mfista_result->lambda_l1  = lambda_l1;
+  mfista_result->lambda_tv  = lambda_tv;
+  mfista_result->lambda_tsv = lambda_tsv;
+  mfista_result->lambda_t   = lambda_t;
+
+  mfista_result->mean_sq_error = mfista_result->sq_error/((double)M_all);
+
+  mfista_result->l1cost   = 0;
+  mfista_result->tsvcost  = 0;
+  mfista_result->N_active = 0;
+
+  for(t = 0; t < Nt; t++){
+    for(i = 0; i < NN; i++){
+      tmp = fabs(x[t](i));
+      if(tmp > 0){
+	mfista_result->l1cost += tmp;
+	++ mfista_result->N_active;
+      }
+    }
+
+    if(lambda_tsv > 0) mfista_result->tsvcost += TSV(Nx, Ny, x[t], buf_diff);
+  }
+
+  TSV_movie(Nx, Ny, Nt, x, inv_dt, 0, lambda_t, &tcost);
+
+  mfista_result->tcost     = tcost;
+  mfista_result->finalcost = (mfista_result->sq_error)/2;
+
+  if(lambda_l1 > 0)
+    mfista_result->finalcost += lambda_l1*(mfista_result->l1cost);
+
+  if(lambda_tsv > 0)
+    mfista_result->finalcost += lambda_tsv*(mfista_result->tsvcost);
+
+  if(lambda_t > 0)
+    mfista_result->finalcost += lambda_t*tcost;
+}
+
+/* main subroutine */
+
+void mfista_imaging_core_nufft_movie(int Nt, int *M, double *t_frame,
+				     double *u_dx, double *v_dy,
+				     double *vis_r, double *vis_i, double *vis_std,
+				     int Nx, int Ny, int maxiter, double eps,
+				     double lambda_l1, double lambda_tv, double lambda_tsv,
+				     double lambda_t, double cinit, double *xinit, double *xout,
+				     int nonneg_flag, int box_flag, float *cl_box,
+				     struct RESULT *mfista_result)
+{
+  int i, t, M_all = 0, iter = 0;
+  double epsilon, s_t, e_t, c = cinit, t_min, t_max;
+  struct timespec time_spec1, time_spec2;
+  VectorXd t_list, inv_dt;
+
+  // frame times: 1, ..., Nt or t_frame rescaled to a span of Nt
+
+  t_list = VectorXd::LinSpaced(Nt, 1, Nt);
+
+  if(t_frame != NULL && Nt > 1){
+    t_min = t_frame[0];
+    t_max = t_frame[0];
+
+    for(t = 1; t < Nt; t++){
+      if(t_frame[t] < t_min) t_min = t_frame[t];
+      if(t_frame[t] > t_max) t_max = t_frame[t];
+    }
+
+    for(t = 0; t < Nt; t++) t_list(t) = Nt*t_frame[t]/(t_max-t_min);
+  }
+
+  inv_dt = VectorXd::Zero(Nt);
+
+  for(t = 0; t < Nt-1; t++){
+    if(t_list(t+1) <= t_list(t)){
+      cout << "Frame times must be increasing." << endl;
+      return;
+    }
+    inv_dt(t) = 1/(t_list(t+1)-t_list(t));
+  }
+
+  // start main part */
+
+  epsilon = 0;
+  for(t = 0; t < Nt; t++) M_all += M[t];
+  for(i = 0; i < M_all; i++) epsilon += vis_r[i]*vis_r[i] + vis_i[i]*vis_i[i];
+
+  epsilon *= eps/((double)M_all);
+
+  get_current_time(&time_spec1);
+
+  if( lambda_tv == 0 ){
+    iter = mfista_L1_TSV_core_nufft_movie(xout, Nt, M, Nx, Ny, u_dx, v_dy, maxiter, epsilon,
+					  vis_r, vis_i, vis_std, lambda_l1, lambda_tsv, lambda_t,
+					  inv_dt, &c, xinit, nonneg_flag, box_flag, cl_box,
+					  mfista_result);
+  }
+  else{
+    cout << "We have not implemented TV option." << endl;
+    return;
+  }
+
+  get_current_time(&time_spec2);
+
+  s_t = (double)time_spec1.tv_sec + (1.0e-9)*(double)time_spec1.tv_nsec;
+  e_t = (double)time_spec2.tv_sec + (1.0e-9)*(double)time_spec2.tv_nsec;
+
+  mfista_result->comp_time = e_t-s_t;
+  mfista_result->ITER      = iter;
+  mfista_result->nonneg    = nonneg_flag;
+  mfista_result->Lip_const = c;
+  mfista_result->maxiter   = maxiter;
+
+  calc_result_nufft_movie(mfista_result, Nt, M, Nx, Ny,
+			  lambda_l1, lambda_tv, lambda_tsv, lambda_t, inv_dt, xout);
+}
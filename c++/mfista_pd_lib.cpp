@@ -0,0 +1,175 @@
+#include "mfista.hpp"
+#include <iomanip>
+
+// mfista_pd_lib
+//
+// L1+TV by the primal-dual splitting of Condat (2013, J. Optim. Theory
+// Appl. 158, 460) and Vu (2013, Adv. Comput. Math. 38, 667)
+//
+//   x_new = P(x + tau (-grad F(x) - lambda_tv L'w))
+//   w     = P_w(w + sigma/lambda_tv L(2 x_new - x))
+//
+// where P is the soft thresholding with tau lambda_l1 (and nonneg, box),
+// L the difference operator of TV and P_w the projection to the unit
+// ball of the dual of TV (isotropic or anisotropic). Every iteration
+// needs one forward and one adjoint transform and no inner loop. The
+// step sizes satisfy 1/tau - 8 sigma = Lip/2, where Lip bounds |A'A|
+// and 8 bounds |L'L|. The power method approaches |A'A| from below, so
+// its estimate is enlarged by PDLIPSAFE.
+
+// power method for Lip = |A'A|, using A'A v = grad F(v) - grad F(0)
+
+double est_Lip_pd(int NN, function<double(VectorXd&, VectorXd&)> F_dF)
+{
+  int k;
+  double Lip = 0;
+  VectorXd zero = VectorXd::Zero(NN), dfdx0(NN), dfdx(NN), vvec;
+
+  F_dF(zero, dfdx0);
+
+  srand(1);
+  vvec = VectorXd::Random(NN);
+  vvec.normalize();
+
+  for(k = 0; k < PDPOWITER; ++k){
+    F_dF(vvec, dfdx);
+
+    vvec = dfdx0 - dfdx;
+    Lip  = vvec.norm();
+
+    if(Lip == 0) break;
+
+    vvec /= Lip;
+  }
+
+  return(Lip);
+}
+
+// unit ball of the dual of the anisotropic TV
+
+static void P_pqaniso(VectorXd &pmat, VectorXd &qmat)
+{
+  pmat = pmat.cwiseMax(-1).cwiseMin(1);
+  qmat = qmat.cwiseMax(-1).cwiseMin(1);
+}
+
+int L1_TV_primal_dual(VectorXd &xvec, int Nx, int Ny, int maxiter, double eps,
+		      double lambda_l1, double lambda_tv,
+		      int nonneg_flag, int box_flag, VectorXd &box,
+		      function<double(VectorXd&, VectorXd&)> F_dF,
+		      double *Lip, struct MFISTA_OPT *mfista_opt,
+		      struct RESULT *mfista_result)
+{
+  int iter, NN = Nx*Ny, aniso = mfista_opt->tv_aniso, verbose = mfista_opt->verbose,
+    stop = STOP_MAXITER, keep_best = (mfista_opt->deadline > 0);
+  double tau, sigma, costtmp, Fval, l1cost, tvcost, costbest = 0;
+
+  VectorXd cost, dfdx, xnew, xtmp, xbest, pmat, qmat, npmat, nqmat;
+  struct MFISTA_TRACE *trace;
+
+  void (*soft_th_box)(VectorXd &newvec, VectorXd &vector, double eta, int box_flag, VectorXd &box);
+
+  if(nonneg_flag == 1) soft_th_box = soft_threshold_nonneg_box;
+  else                 soft_th_box = soft_threshold_box;
+
+  cost  = VectorXd::Zero(maxiter);
+  dfdx  = VectorXd::Zero(NN);
+  xnew  = VectorXd::Zero(NN);
+  xtmp  = VectorXd::Zero(NN);
+  pmat  = VectorXd::Zero((Nx-1)*Ny);
+  qmat  = VectorXd::Zero(Nx*(Ny-1));
+  npmat = VectorXd::Zero((Nx-1)*Ny);
+  nqmat = VectorXd::Zero(Nx*(Ny-1));
+
+  // step sizes
+
+  *Lip  = PDLIPSAFE*est_Lip_pd(NN, F_dF);
+  sigma = PDSIGMA*(*Lip);
+  tau   = 1/((*Lip)/2 + 8*sigma);
+
+  if(verbose){
+    cout << "computing image with the primal-dual splitting." << endl;
+    cout << "Lipschitz constant = " << *Lip
+	 << ", tau = " << tau << ", sigma = " << sigma << endl;
+    cout << "stop if iter = " << maxiter << ", or Delta_cost < " << eps << endl;
+  }
+
+  // main
+
+  trace = trace_open(mfista_opt, "L1_TV_pd", 1);
+
+  for(iter = 0; iter < maxiter; iter++){
+
+    Fval   = F_dF(xvec, dfdx);
+    l1cost = xvec.lpNorm<1>();
+    tvcost = (aniso == 1) ? TV_aniso(Nx, Ny, xvec) : TV(Nx, Ny, xvec);
+
+    costtmp = Fval + lambda_l1*l1cost + lambda_tv*tvcost;
+
+    cost(iter) = costtmp;
+
+    if(keep_best && (iter == 0 || costtmp < costbest)){
+      xbest    = xvec;
+      costbest = costtmp;
+    }
+
+    trace_iter(trace, iter+1, costtmp, Fval, l1cost, "tv", tvcost, *Lip, 1, 0);
+
+    if(verbose && (iter % 100) == 0)
+      cout << iter+1 << " cost = " << fixed << setprecision(5)
+	   << cost(iter) << endl;
+
+    if((iter>=MINITER) && (fabs(cost(iter-TD)-cost(iter)) < eps)){
+      stop = STOP_COST;
+      break;
+    }
+
+    // time budget: the iterations are not monotone, so the image of
+    // the lowest cost so far is returned
+
+    if((iter % DEADLINEITER) == 0 && past_deadline(mfista_opt)){
+      xvec.swap(xbest);
+      cost(iter) = costbest;
+      stop = STOP_DEADLINE;
+      break;
+    }
+
+    // primal
+
+    Lpq(Nx, Ny, pmat, qmat, xtmp);
+    xtmp = xvec + tau*(dfdx - lambda_tv*xtmp);
+    soft_th_box(xnew, xtmp, tau*lambda_l1, box_flag, box);
+
+    // dual
+
+    xtmp = 2*xnew - xvec;
+    Lx(Nx, Ny, xtmp, npmat, nqmat);
+
+    pmat += (sigma/lambda_tv)*npmat;
+    qmat += (sigma/lambda_tv)*nqmat;
+
+    if(aniso == 1)
+      P_pqaniso(pmat, qmat);
+    else{
+      P_pqiso(Nx, Ny, pmat, qmat, npmat, nqmat);
+      pmat.swap(npmat);
+      qmat.swap(nqmat);
+    }
+
+    xvec.swap(xnew);
+  }
+
+  if(iter == maxiter) iter = iter-1;
+
+  trace_close(trace, stop, iter+1);
+
+  mfista_result->stop_rule = stop;
+
+  if(verbose){
+    cout << iter+1 << " cost = " << cost(iter) << endl;
+    cout << endl;
+    cout << resetiosflags(ios_base::floatfield);
+  }
+
+  return(iter);
+}
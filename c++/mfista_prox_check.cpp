@@ -0,0 +1,85 @@
+#include "mfista.hpp"
+
+// Proxes of the regularizers on small images whose answer is known.
+//
+// For each case the prox is compared with the exact x, and the value
+//
+//   |x-b|^2/2 + lambda_l1 |x|_1 + lambda_tv TV_aniso(x)
+//
+// of both is printed. A case fails when max |x - x_exact| is above
+// CHECKPROX, and the exit status is 1 when any case fails.
+
+// threshold of the error of the prox
+#define CHECKPROX 1.0e-4
+
+struct PROX_CASE{
+  const char *name;
+  int Nx;
+  int Ny;
+  double lambda_l1;
+  double lambda_tv;
+  int nonneg_flag;
+  int box_flag;
+  vector<double> b;
+  vector<double> box;
+  vector<double> x;
+};
+
+static double prox_cost(VectorXd &xvec, VectorXd &bvec, struct PROX_CASE *pc)
+{
+  return((xvec - bvec).squaredNorm()/2 + pc->lambda_l1*xvec.lpNorm<1>() +
+	 pc->lambda_tv*TV_aniso(pc->Nx, pc->Ny, xvec));
+}
+
+int main(int argc, char *argv[]){
+
+  int k, iter, pass, fail = 0;
+  double err;
+  struct TV_ANISO aniso;
+  VectorXd xvec, bvec, box, x_exact;
+
+  // a pixel next to one outside of the CLEAN box is pulled to 0 by the
+  // TV; clipping the prox of TV to the box gives [1, 0] (cost 51.5)
+
+  vector<struct PROX_CASE> cases = {
+    {"TV_aniso",           2, 1, 0, 1, 0, 0, {0, 10}, {1, 1}, {1, 9}},
+    {"TV_aniso + l1",      2, 1, 2, 1, 0, 0, {0, 10}, {1, 1}, {0, 7}},
+    {"TV_aniso + box",     2, 1, 0, 1, 0, 1, {0, 10}, {1, 0}, {0, 0}},
+    {"TV_aniso + box (3)", 3, 1, 0, 1, 0, 1, {5, 5, 5}, {1, 0, 1}, {4, 0, 4}},
+    {"TV_aniso + box + nonneg", 1, 3, 0, 1, 1, 1, {-5, 5, 5}, {1, 1, 0}, {0, 3, 0}},
+  };
+
+  if(argc > 1){
+    cerr << argv[0] << " takes no arguments." << endl;
+    exit(1);
+  }
+
+  for(auto &pc : cases){
+    bvec    = Map<VectorXd>(pc.b.data(), pc.b.size());
+    box     = Map<VectorXd>(pc.box.data(), pc.box.size());
+    x_exact = Map<VectorXd>(pc.x.data(), pc.x.size());
+    xvec    = VectorXd::Zero(pc.Nx*pc.Ny);
+
+    init_tv_aniso(pc.Nx, pc.Ny, &aniso);
+
+    iter = prox_TV_aniso(xvec, bvec, pc.lambda_l1, pc.lambda_tv, 100*ANISOITER,
+			 pc.Nx, pc.Ny, pc.nonneg_flag, pc.box_flag, box, &aniso);
+
+    err  = (xvec - x_exact).lpNorm<Infinity>();
+    pass = (err <= CHECKPROX);
+
+    cout << pc.name << ":" << endl;
+    cout << "  x =";
+    for(k = 0; k < xvec.size(); k++) cout << " " << xvec(k);
+    cout << " (exact";
+    for(k = 0; k < x_exact.size(); k++) cout << " " << x_exact(k);
+    cout << "), " << iter << " passes" << endl;
+    cout << "  cost: " << prox_cost(xvec, bvec, &pc)
+	 << " (exact " << prox_cost(x_exact, bvec, &pc) << ")" << endl;
+    cout << "  " << (pass ? "pass" : "FAIL") << " (tol = " << CHECKPROX << ")" << endl;
+
+    if(!pass) fail = 1;
+  }
+
+  return(fail);
+}
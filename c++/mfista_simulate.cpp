@@ -0,0 +1,243 @@
+#include "mfista.hpp"
+#include <cstdio>
+#include <random>
+
+// Synthetic observations for scaling tests.
+//
+// An array of antennas tracks a source while the Earth rotates; every
+// baseline traces an ellipse in the uv plane. The sky is a set of point
+// sources or circular Gaussians. Visibilities get Gaussian noise and
+// are written in the format of nufft_data.txt, or gridded to the format
+// of fft_data.txt. Everything is drawn from one seeded generator in a
+// fixed order, so the same arguments give the same file.
+//
+// The NUFFT rows are written as they are generated and never kept, so
+// M is limited only by the disk. The FFT output accumulates on the
+// Nx x Ny grid.
+
+// largest |u|, |v| in rad/pixel (the NUFFT grid ends at pi)
+#define SIM_UVMAX 0.8
+
+void usage(char *s)
+{
+  cerr << s
+       << " <out fname> <int M> <int Nx> <int Ny>"
+       << " {-fft} {-seed n} {-nant n} {-lat deg} {-dec deg} {-hours h}"
+       << " {-gauss} {-nsrc n} {-flux f} {-noise sigma}"
+       << "\n\n";
+
+  cerr << "  <out fname>:         file to write the visibilities." << endl;
+  cerr << "  <int M>:             number of visibilities." << endl;
+  cerr << "  <int Nx>:            X-dim of image." << endl;
+  cerr << "  <int Ny>:            Y-dim of image." << "\n\n";
+
+  cerr << " Options." << "\n\n";
+
+  cerr << "  {-fft}:              grid to the format of fft_data.txt." << endl;
+  cerr << "  {-seed n}:           seed of the random numbers (default 1)." << endl;
+  cerr << "  {-nant n}:           number of antennas (default 20)." << endl;
+  cerr << "  {-lat deg}:          latitude of the array (default 35)." << endl;
+  cerr << "  {-dec deg}:          declination of the source (default 20)." << endl;
+  cerr << "  {-hours h}:          length of the track in hours (default 8)." << endl;
+  cerr << "  {-gauss}:            circular Gaussians instead of point sources." << endl;
+  cerr << "  {-nsrc n}:           number of sources (default 5)." << endl;
+  cerr << "  {-flux f}:           flux of the brightest source (default 1)." << endl;
+  cerr << "  {-noise sigma}:      noise of each visibility (default 0.1)." << "\n\n";
+
+  cerr << " The sources lie in the central half of the image. u_rad and v_rad" << endl;
+  cerr << " reach " << SIM_UVMAX << " rad/pixel on the longest baseline." << endl;
+  cerr << " With {-fft}, the visibilities and their conjugates are averaged" << endl;
+  cerr << " with inverse-variance weights on the uv cells, and M in the file is" << endl;
+  cerr << " the number of cells with data." << "\n\n";
+
+  exit(1);
+}
+
+struct SIM_SKY{
+  vector<double> x, y, flux, width;
+};
+
+// visibility of the sky at (u, v) in rad/pixel, with the sign of NUFFT2d2
+
+static complex<double> sky_vis(struct SIM_SKY *sky, double u, double v)
+{
+  int s;
+  complex<double> vis = 0;
+
+  for(s = 0; s < (int)sky->x.size(); s++)
+    vis += sky->flux[s]*exp(-0.5*sky->width[s]*sky->width[s]*(u*u + v*v))
+      *exp(complex<double>(0, u*sky->x[s] + v*sky->y[s]));
+
+  return(vis);
+}
+
+// adds vis at the cell of (u, v) and its conjugate at the mirrored cell.
+// FFT cell k is u = -2 pi k/Nx, and the FFT engine puts the image center
+// at (Nx/2, Ny/2) and scales by 1/sqrt(Nx Ny).
+
+static void grid_vis(int Nx, int Ny, double u, double v, complex<double> vis, double sigma,
+		     vector<double> &sum_r, vector<double> &sum_i, vector<double> &sum_w)
+{
+  int k, l, idx;
+  double w, sqNN = sqrt((double)(Nx*Ny));
+
+  k = (int)lround(-u*Nx/(2*M_PI));
+  l = (int)lround(-v*Ny/(2*M_PI));
+
+  vis *= (((k + l) % 2 == 0) ? 1.0 : -1.0)/sqNN;
+  w = sqNN*sqNN/(sigma*sigma);
+
+  idx = Ny*((k + Nx) % Nx) + (l + Ny) % Ny;
+  sum_r[idx] += w*vis.real();
+  sum_i[idx] += w*vis.imag();
+  sum_w[idx] += w;
+
+  idx = Ny*((Nx - k) % Nx) + (Ny - l) % Ny;
+  sum_r[idx] += w*vis.real();
+  sum_i[idx] -= w*vis.imag();
+  sum_w[idx] += w;
+}
+
+int main(int argc, char *argv[]){
+
+  int i, j, s, t, M, Nx, Ny, n_ant = 20, n_src = 5, n_base, n_time, n_cell, m = 0,
+    fft_flag = 0, gauss_flag = 0;
+  unsigned long seed = 1;
+  double lat = 35, dec = 20, hours = 8, flux = 1, noise = 0.1,
+    H, X, Y, Z, u, v, b_max = 0, scale;
+  complex<double> vis;
+  vector<double> east, north, sum_r, sum_i, sum_w;
+  struct SIM_SKY sky;
+  FILE *fp;
+
+  if(argc < 5) usage(argv[0]);
+
+  M  = atoi(argv[2]);
+  Nx = atoi(argv[3]);
+  Ny = atoi(argv[4]);
+
+  for(i = 5; i < argc; i++){
+    if(strcmp(argv[i],"-fft") == 0)
+      fft_flag = 1;
+    else if(strcmp(argv[i],"-gauss") == 0)
+      gauss_flag = 1;
+    else if(strcmp(argv[i],"-seed") == 0 && i+1 < argc)
+      seed = strtoul(argv[++i], NULL, 10);
+    else if(strcmp(argv[i],"-nant") == 0 && i+1 < argc)
+      n_ant = atoi(argv[++i]);
+    else if(strcmp(argv[i],"-lat") == 0 && i+1 < argc)
+      lat = atof(argv[++i]);
+    else if(strcmp(argv[i],"-dec") == 0 && i+1 < argc)
+      dec = atof(argv[++i]);
+    else if(strcmp(argv[i],"-hours") == 0 && i+1 < argc)
+      hours = atof(argv[++i]);
+    else if(strcmp(argv[i],"-nsrc") == 0 && i+1 < argc)
+      n_src = atoi(argv[++i]);
+    else if(strcmp(argv[i],"-flux") == 0 && i+1 < argc)
+      flux = atof(argv[++i]);
+    else if(strcmp(argv[i],"-noise") == 0 && i+1 < argc)
+      noise = atof(argv[++i]);
+    else
+      usage(argv[0]);
+  }
+
+  if(M < 1 || Nx < 2 || Ny < 2 || n_ant < 2 || n_src < 1 || noise <= 0){
+    cerr << "M, Nx, Ny, nant, nsrc and noise must be positive." << endl;
+    exit(1);
+  }
+
+  mt19937_64 gen(seed);
+  uniform_real_distribution<double> uni(0, 1);
+  normal_distribution<double> gauss(0, 1);
+
+  lat *= M_PI/180;
+  dec *= M_PI/180;
+
+  // antennas: uniform in a disk of radius 1 on the ground (east, north)
+
+  for(i = 0; i < n_ant; i++){
+    double r = sqrt(uni(gen)), phi = 2*M_PI*uni(gen);
+    east.push_back(r*cos(phi));
+    north.push_back(r*sin(phi));
+  }
+
+  for(i = 0; i < n_ant; i++)
+    for(j = i+1; j < n_ant; j++)
+      b_max = fmax(b_max, hypot(east[j]-east[i], north[j]-north[i]));
+
+  scale  = SIM_UVMAX/b_max;
+  n_base = n_ant*(n_ant-1)/2;
+  n_time = (M + n_base - 1)/n_base;
+
+  // sky: the first source is the brightest, widths in pixels
+
+  for(s = 0; s < n_src; s++){
+    sky.x.push_back((uni(gen) - 0.5)*Nx/2);
+    sky.y.push_back((uni(gen) - 0.5)*Ny/2);
+    sky.flux.push_back((s == 0) ? flux : flux*(0.1 + 0.9*uni(gen)));
+    sky.width.push_back(gauss_flag ? (1 + uni(gen)*Nx/32.0) : 0);
+  }
+
+  fp = fopen(argv[1], "w");
+  if(fp == NULL){
+    cerr << "Cannot open \"" << argv[1] << ".\"\n";
+    exit(0);
+  }
+
+  if(fft_flag){
+    sum_r.assign(Nx*Ny, 0);
+    sum_i.assign(Nx*Ny, 0);
+    sum_w.assign(Nx*Ny, 0);
+  }
+  else{
+    setvbuf(fp, NULL, _IOFBF, 1 << 22);
+    fprintf(fp, "M  = %d\nNX = %d\nNY = %d\n\nu_rad, v_rad, vis_r, vis_i, noise_std_dev\n\n",
+	    M, Nx, Ny);
+  }
+
+  // Earth rotation: baseline (east, north) on the ground at latitude lat
+  // is (X, Y, Z) in the equatorial frame, and at hour angle H
+  //   u = sin H X + cos H Y
+  //   v = -sin dec cos H X + sin dec sin H Y + cos dec Z
+
+  for(t = 0; t < n_time && m < M; t++){
+    H = (n_time == 1) ? 0 : (hours*(t/(double)(n_time-1) - 0.5))*M_PI/12;
+
+    for(i = 0; i < n_ant && m < M; i++)
+      for(j = i+1; j < n_ant && m < M; j++, m++){
+	X = -sin(lat)*(north[j]-north[i]);
+	Y = east[j]-east[i];
+	Z = cos(lat)*(north[j]-north[i]);
+
+	u = scale*(sin(H)*X + cos(H)*Y);
+	v = scale*(-sin(dec)*cos(H)*X + sin(dec)*sin(H)*Y + cos(dec)*Z);
+
+	vis = sky_vis(&sky, u, v) + complex<double>(noise*gauss(gen), noise*gauss(gen));
+
+	if(fft_flag)
+	  grid_vis(Nx, Ny, u, v, vis, noise, sum_r, sum_i, sum_w);
+	else
+	  fprintf(fp, "%e, %e, %e, %e, %e\n", u, v, vis.real(), vis.imag(), noise);
+      }
+  }
+
+  if(fft_flag){
+    for(n_cell = 0, i = 0; i < Nx*Ny; i++) if(sum_w[i] > 0) n_cell++;
+
+    fprintf(fp, "M  = %d\nNX = %d\nNY = %d\n\nu, v, y_r, y_i, noise_std_dev\n\n",
+	    n_cell, Nx, Ny);
+
+    for(i = 0; i < Nx; i++)
+      for(j = 0; j < Ny; j++)
+	if(sum_w[Ny*i+j] > 0)
+	  fprintf(fp, "%d, %d, %e, %e, %e\n", i, j,
+		  sum_r[Ny*i+j]/sum_w[Ny*i+j], sum_i[Ny*i+j]/sum_w[Ny*i+j],
+		  1/sqrt(sum_w[Ny*i+j]));
+
+    cout << m << " visibilities gridded to " << n_cell << " cells." << endl;
+  }
+  else
+    cout << m << " visibilities written." << endl;
+
+  fclose(fp);
+}
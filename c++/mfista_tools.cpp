@@ -1,5 +1,6 @@
 #include "mfista.hpp"
 
+#include <string.h>
 #include <time.h>
 
 #ifdef __APPLE__
@@ -40,7 +41,7 @@ void soft_threshold_box(VectorXd &nvec, VectorXd &vec, double eta,
 			int box_flag, VectorXd &box)
 {
   soft_threshold(nvec, vec, eta);
-  if(box_flag == 1) nvec = vec.array()*box.array();
+  if(box_flag == 1) nvec = nvec.array()*box.array();
 }
 
 void soft_threshold_nonneg(VectorXd &nvec, VectorXd &vec, double eta)
@@ -70,6 +71,73 @@ void soft_threshold_nonneg_box(VectorXd &nvec, VectorXd &vec, double eta,
   else soft_threshold_nonneg(nvec, vec, eta);
 }
 
+// duality gap of L1+TSV
+//
+// F + lambda_tsv TSV is |b - Bx|^2/2 with B = [A; sqrt(2 lambda_tsv) D],
+// so the problem is a Lasso and theta = (b - Bx)/s is dual feasible for
+// s = max(1, |B'(b - Bx)|_inf/lambda_l1), where B'(b - Bx) = mdfdx is
+// the negative gradient (mdfdx_i instead of |mdfdx_i| for x >= 0, and
+// only over the pixels in the box). With F0 = F(0), g0 = A'b and
+// f = f(x),
+//
+//   D(theta) = (2 F0 - x'g0)/s - f/s^2.
+//
+// x has to be 0 outside of the box. If active is not NULL, x is 0 off
+// the listed pixels and only those are visited. Returns the gap and s.
+
+double dual_gap(VectorXd &xvec, VectorXd &mdfdx, double fval,
+		double F0, VectorXd &g0, double lambda_l1, int nonneg_flag,
+		int box_flag, VectorXd &box, double *scale, vector<int> *active)
+{
+  int i, k, n = (active == NULL) ? xvec.size() : active->size();
+  double s = 1, v, dval, gap, xg0 = 0, l1 = 0;
+
+  for(k = 0; k < n; k++){
+    i = (active == NULL) ? k : (*active)[k];
+    xg0 += xvec(i)*g0(i);
+    l1  += fabs(xvec(i));
+    if(box_flag == 1 && box(i) == 0) continue;
+    v = (nonneg_flag == 1) ? mdfdx(i) : fabs(mdfdx(i));
+    if(v > s*lambda_l1) s = v/lambda_l1;
+  }
+
+  dval = (2*F0 - xg0)/s - fval/(s*s);
+  gap  = fval + lambda_l1*l1 - dval;
+
+  if(scale != NULL) *scale = s;
+
+  return(max(gap, 0.0));
+}
+
+// gap safe screening (Ndiaye et al. 2017, JMLR 18, 1)
+//
+// Pixel i is 0 at the optimum if |mdfdx_i|/s + sqrt(2 gap) |B_i| < lambda_l1
+// with s and gap of dual_gap. Such pixels are set to 0 in box. colnorm
+// bounds |B_i|. Returns the number of new zeros.
+
+int gap_safe_screen(VectorXd &box, VectorXd &xvec, VectorXd &mdfdx,
+		    double fval, double F0, VectorXd &g0, double colnorm,
+		    double lambda_l1, int nonneg_flag, vector<int> *active)
+{
+  int i, k, n = 0, m = (active == NULL) ? xvec.size() : active->size();
+  double s, v, gap;
+
+  gap = dual_gap(xvec, mdfdx, fval, F0, g0, lambda_l1, nonneg_flag, 1, box,
+		 &s, active);
+
+  for(k = 0; k < m; k++){
+    i = (active == NULL) ? k : (*active)[k];
+    if(box(i) == 0) continue;
+    v = (nonneg_flag == 1) ? mdfdx(i) : fabs(mdfdx(i));
+    if(v/s + sqrt(2*gap)*colnorm < lambda_l1){
+      box(i) = 0;
+      n++;
+    }
+  }
+
+  return(n);
+}
+
 // TSV
 
 double TSV(int Nx, int Ny, VectorXd &xvec, VectorXd &buf_diff)
@@ -112,6 +180,126 @@ void d_TSV(VectorXd &dvec, int Nx, int Ny, VectorXd &xvec)
   }
 }
 
+// the same on the pixels not screened out
+//
+// active lists the pixels with box != 0 when it was made (boxa is that
+// box). The vectors have to be 0 off the list; then the results equal
+// the full ones, and only the listed entries of the outputs are set.
+
+void active_set(VectorXd &box, VectorXd &boxa, vector<int> &active)
+{
+  int i;
+
+  boxa = box;
+  active.clear();
+
+  for(i = 0; i < box.size(); i++)
+    if(box(i) != 0) active.push_back(i);
+}
+
+double calc_Q_part_active(VectorXd &xvec1, VectorXd &xvec2,
+			  double c, VectorXd &AyAz, vector<int> &active)
+{
+  double d, term1 = 0, term2 = 0;
+
+  for(int i : active){
+    d = xvec1(i) - xvec2(i);
+    term1 += d*AyAz(i);
+    term2 += d*d;
+  }
+
+  return(-term1+c*term2/2);
+}
+
+// box may have lost pixels since the list was made
+
+void soft_threshold_active(VectorXd &nvec, VectorXd &vec, double eta,
+			   int nonneg_flag, VectorXd &box, vector<int> &active)
+{
+  for(int i : active){
+    if(box(i) == 0)         nvec(i) = 0;
+    else if(vec(i) >= eta)  nvec(i) = vec(i) - eta;
+    else if(nonneg_flag == 0 && vec(i) <= -eta)
+                            nvec(i) = vec(i) + eta;
+    else                    nvec(i) = 0;
+  }
+}
+
+double l1_active(VectorXd &xvec, vector<int> &active)
+{
+  double l1 = 0;
+
+  for(int i : active) l1 += fabs(xvec(i));
+
+  return(l1);
+}
+
+// each pair with a listed end once: right and down of a listed pixel,
+// left and up only if that neighbour is not listed
+
+double TSV_active(int Nx, int Ny, VectorXd &xvec, VectorXd &boxa,
+		  vector<int> &active)
+{
+  int i, j;
+  double tsv = 0;
+
+  for(int p : active){
+    i = p % Nx;
+    j = p / Nx;
+    if(i+1 < Nx)                   tsv += pow(xvec(p)-xvec(p+1), 2.0);
+    if(j+1 < Ny)                   tsv += pow(xvec(p)-xvec(p+Nx), 2.0);
+    if(i > 0 && boxa(p-1) == 0)    tsv += pow(xvec(p), 2.0);
+    if(j > 0 && boxa(p-Nx) == 0)   tsv += pow(xvec(p), 2.0);
+  }
+
+  return(tsv);
+}
+
+void d_TSV_active(VectorXd &dvec, int Nx, int Ny, VectorXd &xvec,
+		  vector<int> &active)
+{
+  int i, j;
+  double d;
+
+  for(int p : active){
+    i = p % Nx;
+    j = p / Nx;
+    d = 0;
+    if(i+1 < Nx) d += xvec(p)-xvec(p+1);
+    if(i > 0)    d += xvec(p)-xvec(p-1);
+    if(j+1 < Ny) d += xvec(p)-xvec(p+Nx);
+    if(j > 0)    d += xvec(p)-xvec(p-Nx);
+    dvec(p) = 2*d;
+  }
+}
+
+// solver options
+
+void init_opt(struct MFISTA_OPT *mfista_opt)
+{
+  mfista_opt->mixed       = 0;
+  mfista_opt->verbose     = 1;
+  mfista_opt->tv_aniso    = 0;
+  mfista_opt->primal_dual = 0;
+  mfista_opt->tsv_prox    = 0;
+  mfista_opt->lbfgs       = 1;
+  mfista_opt->newton      = 0;
+  mfista_opt->screen      = 0;
+  mfista_opt->gap         = 0;
+  mfista_opt->chi2        = 0;
+  mfista_opt->deadline    = 0;
+
+  mfista_opt->t_start.tv_sec  = 0;
+  mfista_opt->t_start.tv_nsec = 0;
+
+  mfista_opt->ckpt_fname  = NULL;
+  mfista_opt->ckpt_sec    = CKPTSEC;
+  mfista_opt->resume      = 0;
+  mfista_opt->trace_fname = NULL;
+  mfista_opt->trace_func  = NULL;
+  mfista_opt->trace_arg   = NULL;
+}
+
 // utility for time measurement
 
 void get_current_time(struct timespec *t) {
@@ -131,3 +319,58 @@ void get_current_time(struct timespec *t) {
 #endif
 }
 
+// per-phase timers: prof_lap adds the time since *t to the phase and restarts *t
+
+thread_local struct PROF mfista_prof;
+
+void prof_reset(void)
+{
+  memset(&mfista_prof, 0, sizeof(struct PROF));
+}
+
+void prof_lap(int phase, struct timespec *t)
+{
+  struct timespec t_now;
+
+  get_current_time(&t_now);
+
+  mfista_prof.time[phase] += (double)(t_now.tv_sec - t->tv_sec)
+    + 1.0e-9*(double)(t_now.tv_nsec - t->tv_nsec);
+
+  *t = t_now;
+}
+
+// 1 if the time budget of mfista_opt has been spent since t_start
+
+int past_deadline(struct MFISTA_OPT *mfista_opt)
+{
+  struct timespec t_now;
+
+  if(mfista_opt->deadline <= 0) return(0);
+
+  get_current_time(&t_now);
+
+  return((double)(t_now.tv_sec - mfista_opt->t_start.tv_sec)
+	 + 1.0e-9*(double)(t_now.tv_nsec - mfista_opt->t_start.tv_nsec)
+	 >= mfista_opt->deadline);
+}
+
+// 1 if mfista_opt has an option that only the MFISTA cores implement
+// (and -mixed if mixed is 1), so that solver must not be used
+
+int opt_mfista_only(struct MFISTA_OPT *mfista_opt, const char *solver, int mixed)
+{
+  const char *opt = NULL;
+
+  if(mfista_opt->gap > 0)                       opt = "-gap";
+  else if(mfista_opt->chi2 > 0)                 opt = "-chi2";
+  else if(mfista_opt->ckpt_fname != NULL)       opt = "-checkpoint";
+  else if(mixed == 1 && mfista_opt->mixed == 1) opt = "-mixed";
+
+  if(opt == NULL) return(0);
+
+  cout << solver << " does not support " << opt << "; solving with MFISTA." << endl;
+
+  return(1);
+}
+
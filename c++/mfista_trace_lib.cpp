@@ -0,0 +1,208 @@
+#include "mfista.hpp"
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// mfista_trace_lib
+//
+// Trace of the MFISTA iterations in JSON lines,
+//
+//   {"event":"start","solver":"L1_TSV_fft","iter":1}
+//   {"iter":1,"cost":..,"data":..,"l1":..,"tsv":..,"c":..,"trials":2,"dt":..,"restart":0}
+//   {"event":"double","iter":812}
+//   {"event":"stop","stop_rule":1,"iter":1530}
+//
+// cost is the cost of the new prox point, data its squared error / 2,
+// trials the number of backtracking trials and dt the time of the
+// iteration. restart is 1 when the cost did not decrease and the
+// momentum was restarted from the best point. stop_rule is that of
+// RESULT. A value that is not finite (a diverged run) is written as
+// null, since JSON has no nan or inf.
+//
+// The solver only formats a line and appends it to a buffer. A writer
+// thread takes the whole buffer when it is large or every TRACESEC
+// seconds and passes it to the file and the line callback, so the
+// iterations never wait for the output.
+
+#define TRACELINE  512
+#define TRACENUM   32
+#define TRACEFLUSH 65536
+#define TRACESEC   1
+
+struct MFISTA_TRACE{
+  FILE *fp;
+  void (*func)(const char *line, void *arg);
+  void *arg;
+  string buf;
+  mutex lock;
+  condition_variable wake;
+  thread writer;
+  int done;
+  struct timespec t_last;
+};
+
+static void trace_write(struct MFISTA_TRACE *trace, string &out)
+{
+  size_t p, q;
+
+  if(trace->fp != NULL){
+    fwrite(out.data(), 1, out.size(), trace->fp);
+    fflush(trace->fp);
+  }
+
+  if(trace->func != NULL)
+    for(p = 0; (q = out.find('\n', p)) != string::npos; p = q+1){
+      out[q] = '\0';
+      trace->func(out.data() + p, trace->arg);
+    }
+
+  out.clear();
+}
+
+static void trace_loop(struct MFISTA_TRACE *trace)
+{
+  int done = 0;
+  string out;
+  unique_lock<mutex> lk(trace->lock);
+
+  out.reserve(2*TRACEFLUSH);
+
+  while(!done){
+    trace->wake.wait_for(lk, chrono::seconds(TRACESEC),
+			 [trace]{return trace->done || trace->buf.size() >= TRACEFLUSH;});
+    out.swap(trace->buf);
+    done = trace->done;
+
+    lk.unlock();
+    trace_write(trace, out);
+    lk.lock();
+  }
+}
+
+static void trace_push(struct MFISTA_TRACE *trace, const char *line)
+{
+  int full;
+
+  {
+    lock_guard<mutex> lk(trace->lock);
+    trace->buf += line;
+    full = (trace->buf.size() >= TRACEFLUSH);
+  }
+
+  if(full) trace->wake.notify_one();
+}
+
+// NULL (no trace) unless mfista_opt has a trace file or callback.
+// The file is appended to when the run resumes from a checkpoint or
+// the solver continues another one (iter > 1).
+
+struct MFISTA_TRACE *trace_open(struct MFISTA_OPT *mfista_opt, const char *solver, int iter)
+{
+  char line[TRACELINE];
+  struct MFISTA_TRACE *trace;
+
+  if(mfista_opt->trace_fname == NULL && mfista_opt->trace_func == NULL) return(NULL);
+
+  trace = new struct MFISTA_TRACE;
+
+  trace->fp   = NULL;
+  trace->func = mfista_opt->trace_func;
+  trace->arg  = mfista_opt->trace_arg;
+  trace->done = 0;
+
+  if(mfista_opt->trace_fname != NULL){
+    trace->fp = fopen(mfista_opt->trace_fname, (mfista_opt->resume == 1 || iter > 1) ? "a" : "w");
+    if(trace->fp == NULL){
+      cout << "cannot open trace file " << mfista_opt->trace_fname << "." << endl;
+      if(trace->func == NULL){
+	delete trace;
+	return(NULL);
+      }
+    }
+  }
+
+  trace->buf.reserve(2*TRACEFLUSH);
+  get_current_time(&trace->t_last);
+
+  snprintf(line, TRACELINE, "{\"event\":\"start\",\"solver\":\"%s\",\"iter\":%d}\n",
+	   solver, iter);
+  trace_push(trace, line);
+
+  trace->writer = thread(trace_loop, trace);
+
+  return(trace);
+}
+
+// %.10g of val, or null if val is nan or inf
+
+static const char *trace_num(char *buf, double val)
+{
+  if(!isfinite(val)) return("null");
+
+  snprintf(buf, TRACENUM, "%.10g", val);
+
+  return(buf);
+}
+
+void trace_iter(struct MFISTA_TRACE *trace, int iter, double cost, double data,
+		double l1cost, const char *reg, double regcost, double c,
+		int trials, int restart)
+{
+  char line[TRACELINE], s_cost[TRACENUM], s_data[TRACENUM], s_l1[TRACENUM],
+    s_reg[TRACENUM], s_c[TRACENUM];
+  struct timespec t_now;
+  double dt;
+
+  if(trace == NULL) return;
+
+  get_current_time(&t_now);
+
+  dt = (double)(t_now.tv_sec - trace->t_last.tv_sec)
+    + 1.0e-9*(double)(t_now.tv_nsec - trace->t_last.tv_nsec);
+
+  trace->t_last = t_now;
+
+  snprintf(line, TRACELINE,
+	   "{\"iter\":%d,\"cost\":%s,\"data\":%s,\"l1\":%s,\"%s\":%s,"
+	   "\"c\":%s,\"trials\":%d,\"dt\":%.4g,\"restart\":%d}\n",
+	   iter, trace_num(s_cost, cost), trace_num(s_data, data), trace_num(s_l1, l1cost),
+	   reg, trace_num(s_reg, regcost), trace_num(s_c, c), trials, dt, restart);
+  trace_push(trace, line);
+}
+
+void trace_event(struct MFISTA_TRACE *trace, const char *event, int iter)
+{
+  char line[TRACELINE];
+
+  if(trace == NULL) return;
+
+  snprintf(line, TRACELINE, "{\"event\":\"%s\",\"iter\":%d}\n", event, iter);
+  trace_push(trace, line);
+}
+
+// writes the stop event, flushes the buffer and frees trace
+
+void trace_close(struct MFISTA_TRACE *trace, int stop_rule, int iter)
+{
+  char line[TRACELINE];
+
+  if(trace == NULL) return;
+
+  snprintf(line, TRACELINE, "{\"event\":\"stop\",\"stop_rule\":%d,\"iter\":%d}\n",
+	   stop_rule, iter);
+
+  {
+    lock_guard<mutex> lk(trace->lock);
+    trace->buf += line;
+    trace->done = 1;
+  }
+
+  trace->wake.notify_one();
+  trace->writer.join();
+
+  if(trace->fp != NULL) fclose(trace->fp);
+
+  delete trace;
+}
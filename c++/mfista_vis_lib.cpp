@@ -0,0 +1,187 @@
+#include "mfista.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring>
+
+// mfista_vis_lib
+//
+// Binary container of the visibilities, memory mapped by the engines,
+//
+//   header (VISHEAD bytes): struct VIS_HEAD below
+//   column u:       M int32 (fft) or double (nufft)
+//   column v:       same
+//   column vis_r:   M double
+//   column vis_i:   M double
+//   column vis_std: M double
+//
+// in the byte order of the machine that wrote it. Every column starts
+// at a multiple of VISALIGN bytes given in the header, so the mapped
+// columns are passed to mfista_imaging_core_* without a copy. Readers
+// check the magic, the version and the column types, and later
+// versions may add columns after these five.
+
+#define VISMAGIC "MFISTAVB"
+#define VISVER   1
+#define VISHEAD  128
+#define VISALIGN 64
+
+#define VIS_INT32  1
+#define VIS_DOUBLE 2
+
+struct VIS_HEAD{
+  char    magic[8];
+  int32_t version;
+  int32_t fft;
+  int64_t M;
+  int32_t Nx;
+  int32_t Ny;
+  int32_t n_col;
+  int32_t col_type[VISNCOL];
+  int64_t col_offset[VISNCOL];
+};
+
+static_assert(sizeof(struct VIS_HEAD) <= VISHEAD, "VIS_HEAD does not fit in VISHEAD");
+
+static size_t col_size(int type)
+{
+  return((type == VIS_INT32) ? sizeof(int32_t) : sizeof(double));
+}
+
+// 1 if fname starts with the magic of the container
+
+int vis_is_bin(string fname)
+{
+  char magic[8];
+  int fd, is_bin = 0;
+
+  fd = open(fname.data(), O_RDONLY);
+  if(fd < 0) return(0);
+
+  if(read(fd, magic, 8) == 8 && memcmp(magic, VISMAGIC, 8) == 0) is_bin = 1;
+
+  close(fd);
+  return(is_bin);
+}
+
+// Maps fname and points the columns of vis into it. The pages are
+// private, so the columns can be written without changing the file.
+
+void vis_map(string fname, struct VIS_DATA *vis)
+{
+  int k, fd;
+  struct stat st;
+  struct VIS_HEAD *head;
+
+  fd = open(fname.data(), O_RDONLY);
+  if(fd < 0 || fstat(fd, &st) != 0){
+    cerr << "Cannot open \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  if((size_t)st.st_size < VISHEAD){
+    cerr << "\"" << fname << "\" is too short for a visibility file." << endl;
+    exit(0);
+  }
+
+  vis->size = st.st_size;
+  vis->map  = mmap(NULL, vis->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(vis->map == MAP_FAILED){
+    cerr << "cannot map \"" << fname << ".\"\n";
+    exit(0);
+  }
+
+  head = (struct VIS_HEAD*) vis->map;
+
+  if(memcmp(head->magic, VISMAGIC, 8) != 0 || head->version != VISVER ||
+     head->n_col < VISNCOL || head->M < 1 || head->M > INT32_MAX ||
+     head->Nx < 1 || head->Ny < 1){
+    cerr << "\"" << fname << "\" is not a visibility file of version " << VISVER << "." << endl;
+    exit(0);
+  }
+
+  // a column starts after the header (a negative offset would wrap in
+  // size_t) and ends in the file
+
+  for(k = 0; k < VISNCOL; k++){
+    if(head->col_type[k] != ((k < 2 && head->fft) ? VIS_INT32 : VIS_DOUBLE) ||
+       head->col_offset[k] < VISHEAD || head->col_offset[k] % VISALIGN != 0 ||
+       (size_t)head->col_offset[k] > vis->size ||
+       head->M*col_size(head->col_type[k]) > vis->size - (size_t)head->col_offset[k]){
+      cerr << "column " << k << " of \"" << fname << "\" is broken." << endl;
+      exit(0);
+    }
+  }
+
+  vis->fft = head->fft;
+  vis->M   = (int)head->M;
+  vis->Nx  = head->Nx;
+  vis->Ny  = head->Ny;
+
+  vis->u       = (char*)vis->map + head->col_offset[0];
+  vis->v       = (char*)vis->map + head->col_offset[1];
+  vis->vis_r   = (double*)((char*)vis->map + head->col_offset[2]);
+  vis->vis_i   = (double*)((char*)vis->map + head->col_offset[3]);
+  vis->vis_std = (double*)((char*)vis->map + head->col_offset[4]);
+}
+
+void vis_unmap(struct VIS_DATA *vis)
+{
+  if(vis->map != NULL) munmap(vis->map, vis->size);
+  vis->map = NULL;
+}
+
+// writes the columns of vis to fname; 0 on success
+
+int vis_write(string fname, struct VIS_DATA *vis)
+{
+  int k, ok = 1;
+  size_t offset;
+  struct VIS_HEAD head;
+  const void *col[VISNCOL] = {vis->u, vis->v, vis->vis_r, vis->vis_i, vis->vis_std};
+  char pad[VISALIGN];
+  FILE *fp;
+
+  memset(&head, 0, sizeof(head));
+  memset(pad, 0, VISALIGN);
+
+  memcpy(head.magic, VISMAGIC, 8);
+  head.version = VISVER;
+  head.fft     = vis->fft;
+  head.M       = vis->M;
+  head.Nx      = vis->Nx;
+  head.Ny      = vis->Ny;
+  head.n_col   = VISNCOL;
+
+  for(offset = VISHEAD, k = 0; k < VISNCOL; k++){
+    head.col_type[k]   = (k < 2 && vis->fft) ? VIS_INT32 : VIS_DOUBLE;
+    head.col_offset[k] = offset;
+    offset += (vis->M*col_size(head.col_type[k]) + VISALIGN - 1)/VISALIGN*VISALIGN;
+  }
+
+  fp = fopen(fname.data(), "wb");
+  if(fp == NULL){
+    cerr << "Cannot open \"" << fname << ".\"\n";
+    return(1);
+  }
+
+  ok &= (fwrite(&head, sizeof(head), 1, fp) == 1);
+  ok &= (fwrite(pad, 1, VISHEAD - sizeof(head), fp) == VISHEAD - sizeof(head));
+
+  for(k = 0; k < VISNCOL; k++){
+    size_t n = vis->M*col_size(head.col_type[k]);
+    ok &= (fwrite(col[k], 1, n, fp) == n);
+    if(n % VISALIGN != 0)
+      ok &= (fwrite(pad, 1, VISALIGN - n % VISALIGN, fp) == VISALIGN - n % VISALIGN);
+  }
+
+  ok &= (fclose(fp) == 0);
+
+  if(!ok) cerr << "cannot write \"" << fname << ".\"\n";
+
+  return(!ok);
+}
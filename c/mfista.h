@@ -40,6 +40,9 @@
 #define ETA       1.1
 #define EPS       1.0e-5
 
+/* smallest image (NX*NY) handled by each thread of FGP */
+#define FGP_NN_PER_THREAD (128*128)
+
 /* result format */
 
 struct RESULT{
@@ -92,6 +95,9 @@ extern int read_V_vector(char *fname, int length, double *vector);
 extern unsigned long read_A_matrix(char *fname, int height, int width,
 				   double *matrix);
 extern int write_X_vector(char *fname, int length, double *vector);
+extern int read_nufft_rows(char *fname, long offset, int M,
+			   double *u_dx, double *v_dy,
+			   double *vis_r, double *vis_i, double *vis_std);
 
 /* simple matrix operations */
 
@@ -25,6 +25,10 @@
 
 #include "mfista.h" 
 
+#ifdef PTHREAD
+#include <pthread.h>
+#endif
+
 /* subroutines for mfista_tv */
 
 double TV(int NX, int NY, double *xvec)
@@ -45,276 +49,310 @@ double TV(int NX, int NY, double *xvec)
   return(tv);
 }
 
-void Lx(int NX, int NY, double *xvec, double *p, double *q)
-{
-  int i, j;
-
-  for(i = 0; i < NX-1; ++i)for(j = 0; j < NY; ++j)
-      p[(NX-1)*j+i] = xvec[NX*j+i]-xvec[NX*j+i+1];
-
-  for(i = 0; i < NX; ++i)for(j = 0; j < NY-1; ++j)
-      q[NX*j+i] = xvec[NX*j+i]-xvec[NX*(j+1)+i];
-}
-
-void Lpq(int NX, int NY, double *pmat, double *qmat, double *xvec)
+/* FGP (Beck and Teboulle 2009, IEEE trans. on Image Processing)
+
+   Every iteration of FGP is
+
+     x       = P(b - lambda_tv L(r,s))
+     (np,nq) = P_pqiso((r,s) + Lx/(8 lambda_tv))
+     (r,s)   = (np,nq) + (t-1)/tnew ((np,nq) - (p,q))
+     (p,q)   = (np,nq)
+
+   where P is the soft thresholding and/or the projection to the
+   nonnegative (box) region. It is computed in two sweeps. The first
+   sweep forms x pixel by pixel, gathering L(r,s) from the neighbouring
+   dual elements. The second sweep takes the differences of x, projects
+   them and applies the momentum in place of (r,s). (p,q) and (np,nq)
+   are exchanged by swapping the pointers.
+
+   The rows of the image are split into bands, one for each thread.
+   The sweeps of a band only touch the neighbouring row of the next
+   or the previous band, so the threads meet at a barrier between the
+   sweeps. */
+
+#define FGP_PROJ_L1     0
+#define FGP_PROJ_NONNEG 1
+
+struct FGP_WORK{
+  int NX;
+  int NY;
+  int ITER;
+  int proj;
+  double *bvec;
+  double lambda_l1;
+  double lambda_tv;
+  double *pmat;
+  double *qmat;
+  double *rmat;
+  double *smat;
+  double *npmat;
+  double *nqmat;
+  double *xvec;
+  int box_flag;
+  float *cl_box;
+#ifdef PTHREAD
+  int nthread;
+  int count;
+  int generation;
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+#endif
+};
+
+struct FGP_ARGS{
+  struct FGP_WORK *work;
+  int j_start;
+  int j_end;
+};
+
+/* x = P(b - lambda_tv L(p,q)) for the rows j_start <= j < j_end */
+
+static void FGP_primal(struct FGP_WORK *w, double *pmat, double *qmat,
+		       int j_start, int j_end)
 {
-  int i, j;
-  
-  for(i = 0; i < NX*NY; ++i)
-    xvec[i] = 0;
-  
-  for(i = 0; i < NX-1; ++i)for(j = 0; j < NY; ++j){
-      xvec[NX*j+i]   += pmat[(NX-1)*j+i];
-      xvec[NX*j+i+1] -= pmat[(NX-1)*j+i];
-    }
-
-  for(i = 0; i < NX; ++i)for(j = 0; j < NY-1; ++j){
-      xvec[NX*j+i]     += qmat[NX*j+i];
-      xvec[NX*(j+1)+i] -= qmat[NX*j+i];
+  int i, j, k, NX = w->NX, NY = w->NY;
+  double tmp, eta = w->lambda_l1, *bvec = w->bvec, *xvec = w->xvec;
+
+  for(j = j_start; j < j_end; ++j) for(i = 0; i < NX; ++i){
+
+      tmp = 0;
+
+      if(i > 0)    tmp -= pmat[(NX-1)*j+i-1];
+      if(i < NX-1) tmp += pmat[(NX-1)*j+i];
+      if(j > 0)    tmp -= qmat[NX*(j-1)+i];
+      if(j < NY-1) tmp += qmat[NX*j+i];
+
+      k   = NX*j+i;
+      tmp = bvec[k] - w->lambda_tv*tmp;
+
+      if(w->box_flag == 1 && w->cl_box[k] == 0)
+	xvec[k] = 0;
+      else if(w->proj == FGP_PROJ_NONNEG)
+	xvec[k] = (tmp < 0) ? 0 : tmp;
+      else if(tmp >= eta)
+	xvec[k] = tmp - eta;
+      else if(tmp <= -eta)
+	xvec[k] = tmp + eta;
+      else
+	xvec[k] = 0;
     }
 }
 
-void P_positive(int N, double *vec)
-{
-  int i;
-  
-  for(i = 0; i< N; ++i) if(vec[i]<0) vec[i] = 0;
-}
+/* (np,nq) and (r,s) for the rows j_start <= j < j_end */
 
-void P_positive_box(int N, double *vec, int box_flag, float *cl_box)
+static void FGP_dual(struct FGP_WORK *w, double beta1, double beta2,
+		     double *pmat, double *qmat, double *npmat, double *nqmat,
+		     int j_start, int j_end)
 {
-  int i;
+  int i, j, NX = w->NX, NY = w->NY;
+  double a, b, tmp, alpha = 1/(8*w->lambda_tv),
+    *xvec = w->xvec, *rmat = w->rmat, *smat = w->smat;
 
-  if(box_flag == 0)
-    P_positive(N, vec);
-  else{
-    for(i = 0; i< N; ++i) if(cl_box[i] == 0 || vec[i] < 0) vec[i] = 0;
-  }
-}
-
-void P_pqiso(int NX, int NY,
-	     double *pmat, double *qmat,
-	     double *rmat, double *smat)
-{
-  int i,j;
-  double tmp;
+  for(j = j_start; j < j_end; ++j){
 
-  for(i = 0; i < NX-1; ++i) for(j = 0; j < NY-1; ++j){
-      tmp = sqrt(pow(pmat[(NX-1)*j+i],2.0) + pow(qmat[NX*j+i],2.0));
-
-      if(tmp<1) tmp = 1;
-      
-      rmat[(NX-1)*j+i] = pmat[(NX-1)*j+i]/tmp;
-      smat[NX*j+i]     = qmat[NX*j+i]/tmp;
-    } 
-
-  for(i = 0; i<NX-1; ++i){
-    tmp = fabs(pmat[(NX-1)*(NY-1)+i]);
-    if(tmp<1) tmp = 1;
-    rmat[(NX-1)*(NY-1)+i] = pmat[(NX-1)*(NY-1)+i]/tmp;
-  } 
-
-  for(j = 0; j<NY-1; ++j){
-    tmp = fabs(qmat[NX*j+NX-1]);
-    if(tmp<1) tmp = 1;
-    smat[NX*j+NX-1] = qmat[NX*j+NX-1]/tmp;
-  } 
-}
+    if(j < NY-1){
+      for(i = 0; i < NX-1; ++i){
+	a = rmat[(NX-1)*j+i] + alpha*(xvec[NX*j+i]-xvec[NX*j+i+1]);
+	b = smat[NX*j+i]     + alpha*(xvec[NX*j+i]-xvec[NX*(j+1)+i]);
 
-void FGP_L1(int *N, int NX, int NY,
-	    double *bvec, double lambda_l1, double lambda_tv, int ITER,
-	    double *pmat, double *qmat, double *rmat, double *smat, 
-	    double *npmat, double *nqmat, double *xvec)
-{
-  int i, iter, inc = 1, Ntmpp = (NX-1)*NY, Ntmpq = NX*(NY-1);
-  double t = 1, tnew,
-    alpha1 = -lambda_tv, alpha2 = 1, alpha3 = 1/(8*lambda_tv), beta;
+	tmp = sqrt(a*a + b*b);
+	if(tmp<1) tmp = 1;
 
-  /* initialization */
-  for(i = 0; i< Ntmpp; ++i) pmat[i]=0;
-  for(i = 0; i< Ntmpq; ++i) qmat[i]=0;
+	npmat[(NX-1)*j+i] = a/tmp;
+	nqmat[NX*j+i]     = b/tmp;
 
-  dcopy_(&Ntmpp, pmat, &inc, rmat, &inc);
-  dcopy_(&Ntmpq, qmat, &inc, smat, &inc);
+	rmat[(NX-1)*j+i] = beta1*npmat[(NX-1)*j+i] + beta2*pmat[(NX-1)*j+i];
+	smat[NX*j+i]     = beta1*nqmat[NX*j+i]     + beta2*qmat[NX*j+i];
+      }
 
-  /* iteration */
+      b = smat[NX*j+NX-1] + alpha*(xvec[NX*j+NX-1]-xvec[NX*(j+1)+NX-1]);
 
-  for(iter = 0; iter < ITER; ++iter){
-
-    tnew = (1+sqrt(1+4*t*t))/2;
+      tmp = fabs(b);
+      if(tmp<1) tmp = 1;
 
-    /* P_positive(b-lambda_tv*L_pq(r,s)) */
-   
-    Lpq(NX, NY, rmat, smat, xvec);
-    dscal_(N, &alpha1, xvec, &inc);
-    daxpy_(N, &alpha2, bvec, &inc, xvec, &inc);
-    soft_threshold(xvec, *N, lambda_l1, xvec);
-    
-    /*  [tmpr,tmps] = Lx(tmp,N); */
-    Lx(NX, NY, xvec, npmat, nqmat);
+      nqmat[NX*j+NX-1] = b/tmp;
+      smat[NX*j+NX-1]  = beta1*nqmat[NX*j+NX-1] + beta2*qmat[NX*j+NX-1];
+    }
+    else{
+      for(i = 0; i < NX-1; ++i){
+	a = rmat[(NX-1)*j+i] + alpha*(xvec[NX*j+i]-xvec[NX*j+i+1]);
 
-    /*[pnew,qnew] = P_pqiso((r+tmpr/(8*lambda)),(s+tmps/(8*lambda)),N);*/
+	tmp = fabs(a);
+	if(tmp<1) tmp = 1;
 
-    daxpy_(&Ntmpp, &alpha3, npmat, &inc, rmat, &inc);
-    daxpy_(&Ntmpq, &alpha3, nqmat, &inc, smat, &inc);
+	npmat[(NX-1)*j+i] = a/tmp;
+	rmat[(NX-1)*j+i]  = beta1*npmat[(NX-1)*j+i] + beta2*pmat[(NX-1)*j+i];
+      }
+    }
+  }
+}
 
-    P_pqiso(NX, NY, rmat, smat, npmat, nqmat);
+static void FGP_barrier(struct FGP_WORK *w)
+{
+#ifdef PTHREAD
+  int generation;
 
-    dcopy_(&Ntmpp, npmat, &inc, rmat, &inc);
-    dcopy_(&Ntmpq, nqmat, &inc, smat, &inc);
+  if(w->nthread == 1) return;
 
-    beta = 1+(t-1)/tnew;
-    dscal_(&Ntmpp, &beta, rmat, &inc);
-    dscal_(&Ntmpq, &beta, smat, &inc);
+  pthread_mutex_lock(&(w->mutex));
 
-    beta = -(t-1)/tnew;
-    daxpy_(&Ntmpp, &beta, pmat, &inc, rmat, &inc);
-    daxpy_(&Ntmpq, &beta, qmat, &inc, smat, &inc);
+  generation = w->generation;
 
-    /* update */
-    t = tnew;
-    dcopy_(&Ntmpp, npmat, &inc, pmat, &inc);
-    dcopy_(&Ntmpq, nqmat, &inc, qmat, &inc);
+  if(++(w->count) == w->nthread){
+    w->count = 0;
+    w->generation++;
+    pthread_cond_broadcast(&(w->cond));
   }
+  else
+    while(generation == w->generation)
+      pthread_cond_wait(&(w->cond), &(w->mutex));
 
-  /* P_positive(b-lambda_tv*L_pq(p,q)) */
-
-  Lpq(NX, NY, pmat, qmat, xvec);
-  dscal_(N, &alpha1, xvec, &inc);
-  daxpy_(N, &alpha2, bvec, &inc, xvec, &inc);
-  soft_threshold(xvec, *N, lambda_l1, xvec);
-
+  pthread_mutex_unlock(&(w->mutex));
+#endif
 }
 
-void FGP_L1_box(int *N, int NX, int NY,
-		double *bvec, double lambda_l1, double lambda_tv, int ITER,
-		double *pmat, double *qmat, double *rmat, double *smat, 
-		double *npmat, double *nqmat, double *xvec,
-		int box_flag, float *cl_box)
+static void *FGP_band(void *args)
 {
-  int i, iter, inc = 1, Ntmpp = (NX-1)*NY, Ntmpq = NX*(NY-1);
-  double t = 1, tnew,
-    alpha1 = -lambda_tv, alpha2 = 1, alpha3 = 1/(8*lambda_tv), beta;
-
-  /* initialization */
-  for(i = 0; i< Ntmpp; ++i) pmat[i]=0;
-  for(i = 0; i< Ntmpq; ++i) qmat[i]=0;
+  struct FGP_ARGS *a = (struct FGP_ARGS*) args;
+  struct FGP_WORK *w = a->work;
+  int iter;
+  double t = 1, tnew, *tmp,
+    *pmat = w->pmat, *qmat = w->qmat, *npmat = w->npmat, *nqmat = w->nqmat;
 
-  dcopy_(&Ntmpp, pmat, &inc, rmat, &inc);
-  dcopy_(&Ntmpq, qmat, &inc, smat, &inc);
-
-  /* iteration */
-
-  for(iter = 0; iter < ITER; ++iter){
+  for(iter = 0; iter < w->ITER; ++iter){
 
     tnew = (1+sqrt(1+4*t*t))/2;
 
-    /* P_positive(b-lambda_tv*L_pq(r,s)) */
-   
-    Lpq(NX, NY, rmat, smat, xvec);
-    dscal_(N, &alpha1, xvec, &inc);
-    daxpy_(N, &alpha2, bvec, &inc, xvec, &inc);
-    soft_threshold_box(xvec, *N, lambda_l1, xvec, box_flag, cl_box);
-    
-    /*  [tmpr,tmps] = Lx(tmp,N); */
-    Lx(NX, NY, xvec, npmat, nqmat);
-
-    /*[pnew,qnew] = P_pqiso((r+tmpr/(8*lambda)),(s+tmps/(8*lambda)),N);*/
+    FGP_primal(w, w->rmat, w->smat, a->j_start, a->j_end);
 
-    daxpy_(&Ntmpp, &alpha3, npmat, &inc, rmat, &inc);
-    daxpy_(&Ntmpq, &alpha3, nqmat, &inc, smat, &inc);
+    FGP_barrier(w);
 
-    P_pqiso(NX, NY, rmat, smat, npmat, nqmat);
+    FGP_dual(w, 1+(t-1)/tnew, -(t-1)/tnew, pmat, qmat, npmat, nqmat,
+	     a->j_start, a->j_end);
 
-    dcopy_(&Ntmpp, npmat, &inc, rmat, &inc);
-    dcopy_(&Ntmpq, nqmat, &inc, smat, &inc);
+    FGP_barrier(w);
 
-    beta = 1+(t-1)/tnew;
-    dscal_(&Ntmpp, &beta, rmat, &inc);
-    dscal_(&Ntmpq, &beta, smat, &inc);
-
-    beta = -(t-1)/tnew;
-    daxpy_(&Ntmpp, &beta, pmat, &inc, rmat, &inc);
-    daxpy_(&Ntmpq, &beta, qmat, &inc, smat, &inc);
-
-    /* update */
     t = tnew;
-    dcopy_(&Ntmpp, npmat, &inc, pmat, &inc);
-    dcopy_(&Ntmpq, nqmat, &inc, qmat, &inc);
-  }
 
-  /* P_positive(b-lambda_tv*L_pq(p,q)) */
+    tmp = pmat; pmat = npmat; npmat = tmp;
+    tmp = qmat; qmat = nqmat; nqmat = tmp;
+  }
 
-  Lpq(NX, NY, pmat, qmat, xvec);
-  dscal_(N, &alpha1, xvec, &inc);
-  daxpy_(N, &alpha2, bvec, &inc, xvec, &inc);
-  soft_threshold_box(xvec, *N, lambda_l1, xvec, box_flag, cl_box);
+  FGP_primal(w, pmat, qmat, a->j_start, a->j_end);
 
+  return(NULL);
 }
 
-void FGP_nonneg(int *N, int NX, int NY,
-		double *bvec, double lambda_tv, int ITER,
-		double *pmat, double *qmat, double *rmat, double *smat, 
-		double *npmat, double *nqmat, double *xvec)
+static void FGP_core(int NX, int NY, int proj,
+		     double *bvec, double lambda_l1, double lambda_tv, int ITER,
+		     double *pmat, double *qmat, double *rmat, double *smat,
+		     double *npmat, double *nqmat, double *xvec,
+		     int box_flag, float *cl_box)
 {
-  int i, iter, inc = 1, Ntmpp = (NX-1)*NY, Ntmpq = NX*(NY-1);
-  double t = 1, tnew,
-    alpha1 = -lambda_tv, alpha2 = 1, alpha3 = 1/(8*lambda_tv), beta;
+  int i, nthread = 1;
+  struct FGP_WORK work;
+  struct FGP_ARGS *args;
+#ifdef PTHREAD
+  pthread_t *threads;
+#endif
+
+  work.NX = NX;
+  work.NY = NY;
+  work.ITER = ITER;
+  work.proj = proj;
+  work.bvec = bvec;
+  work.lambda_l1 = lambda_l1;
+  work.lambda_tv = lambda_tv;
+  work.pmat  = pmat;
+  work.qmat  = qmat;
+  work.rmat  = rmat;
+  work.smat  = smat;
+  work.npmat = npmat;
+  work.nqmat = nqmat;
+  work.xvec  = xvec;
+  work.box_flag = box_flag;
+  work.cl_box   = cl_box;
 
   /* initialization */
-  for(i = 0; i< Ntmpp; ++i) pmat[i]=0;
-  for(i = 0; i< Ntmpq; ++i) qmat[i]=0;
 
-  dcopy_(&Ntmpp, pmat, &inc, rmat, &inc);
-  dcopy_(&Ntmpq, qmat, &inc, smat, &inc);
+  for(i = 0; i < (NX-1)*NY; ++i) pmat[i] = rmat[i] = 0;
+  for(i = 0; i < NX*(NY-1); ++i) qmat[i] = smat[i] = 0;
 
-  /* iteration */
+#ifdef PTHREAD
+  nthread = (NX*NY)/FGP_NN_PER_THREAD;
 
-  for(iter = 0; iter < ITER; ++iter){
+  if(nthread > THREAD_NUM) nthread = THREAD_NUM;
+  if(nthread > NY)         nthread = NY;
+  if(nthread < 1)          nthread = 1;
 
-    tnew = (1+sqrt(1+4*t*t))/2;
+  work.nthread    = nthread;
+  work.count      = 0;
+  work.generation = 0;
+#endif
 
-    /* P_positive(b-lambda_tv*L_pq(r,s)) */
-   
-    Lpq(NX, NY, rmat, smat, xvec);
-    dscal_(N, &alpha1, xvec, &inc);
-    daxpy_(N, &alpha2, bvec, &inc, xvec, &inc);
-    P_positive(*N, xvec);
+  args = (struct FGP_ARGS*) malloc(nthread*sizeof(struct FGP_ARGS));
 
-    /*  [tmpr,tmps] = Lx(tmp,N); */
-    Lx(NX, NY, xvec, npmat, nqmat);
+  for(i = 0; i < nthread; ++i){
+    args[i].work    = &work;
+    args[i].j_start = (NY*i)/nthread;
+    args[i].j_end   = (NY*(i+1))/nthread;
+  }
 
-    /*[pnew,qnew] = P_pqiso((r+tmpr/(8*lambda)),(s+tmps/(8*lambda)),N);*/
+#ifdef PTHREAD
+  if(nthread > 1){
+    pthread_mutex_init(&(work.mutex), NULL);
+    pthread_cond_init(&(work.cond), NULL);
 
-    daxpy_(&Ntmpp, &alpha3, npmat, &inc, rmat, &inc);
-    daxpy_(&Ntmpq, &alpha3, nqmat, &inc, smat, &inc);
+    threads = (pthread_t*) malloc(nthread*sizeof(pthread_t));
 
-    P_pqiso(NX, NY, rmat, smat, npmat, nqmat);
+    for(i = 1; i < nthread; ++i)
+      pthread_create(threads+i, NULL, FGP_band, args+i);
 
-    dcopy_(&Ntmpp, npmat, &inc, rmat, &inc);
-    dcopy_(&Ntmpq, nqmat, &inc, smat, &inc);
+    FGP_band(args);
 
-    beta = 1+(t-1)/tnew;
-    dscal_(&Ntmpp, &beta, rmat, &inc);
-    dscal_(&Ntmpq, &beta, smat, &inc);
+    for(i = 1; i < nthread; ++i)
+      pthread_join(threads[i], NULL);
 
-    beta = -(t-1)/tnew;
-    daxpy_(&Ntmpp, &beta, pmat, &inc, rmat, &inc);
-    daxpy_(&Ntmpq, &beta, qmat, &inc, smat, &inc);
+    free(threads);
 
-    /* update */
-    t = tnew;
-    dcopy_(&Ntmpp, npmat, &inc, pmat, &inc);
-    dcopy_(&Ntmpq, nqmat, &inc, qmat, &inc);
+    pthread_mutex_destroy(&(work.mutex));
+    pthread_cond_destroy(&(work.cond));
   }
+  else
+    FGP_band(args);
+#else
+  FGP_band(args);
+#endif
 
-  /* P_positive(b-lambda_tv*L_pq(p,q)) */
+  free(args);
+}
 
-  Lpq(NX, NY, pmat, qmat, xvec);
-  dscal_(N, &alpha1, xvec, &inc);
-  daxpy_(N, &alpha2, bvec, &inc, xvec, &inc);
-  P_positive(*N, xvec);
+void FGP_L1(int *N, int NX, int NY,
+	    double *bvec, double lambda_l1, double lambda_tv, int ITER,
+	    double *pmat, double *qmat, double *rmat, double *smat, 
+	    double *npmat, double *nqmat, double *xvec)
+{
+  FGP_core(NX, NY, FGP_PROJ_L1, bvec, lambda_l1, lambda_tv, ITER,
+	   pmat, qmat, rmat, smat, npmat, nqmat, xvec, 0, NULL);
+}
 
+void FGP_L1_box(int *N, int NX, int NY,
+		double *bvec, double lambda_l1, double lambda_tv, int ITER,
+		double *pmat, double *qmat, double *rmat, double *smat, 
+		double *npmat, double *nqmat, double *xvec,
+		int box_flag, float *cl_box)
+{
+  FGP_core(NX, NY, FGP_PROJ_L1, bvec, lambda_l1, lambda_tv, ITER,
+	   pmat, qmat, rmat, smat, npmat, nqmat, xvec, box_flag, cl_box);
+}
+
+void FGP_nonneg(int *N, int NX, int NY,
+		double *bvec, double lambda_tv, int ITER,
+		double *pmat, double *qmat, double *rmat, double *smat, 
+		double *npmat, double *nqmat, double *xvec)
+{
+  FGP_core(NX, NY, FGP_PROJ_NONNEG, bvec, 0, lambda_tv, ITER,
+	   pmat, qmat, rmat, smat, npmat, nqmat, xvec, 0, NULL);
 }
 
 void FGP_nonneg_box(int *N, int NX, int NY,
@@ -323,62 +361,6 @@ void FGP_nonneg_box(int *N, int NX, int NY,
 		    double *npmat, double *nqmat, double *xvec,
 		    int box_flag, float *cl_box)
 {
-  int i, iter, inc = 1, Ntmpp = (NX-1)*NY, Ntmpq = NX*(NY-1);
-  double t = 1, tnew,
-    alpha1 = -lambda_tv, alpha2 = 1, alpha3 = 1/(8*lambda_tv), beta;
-
-  /* initialization */
-  for(i = 0; i< Ntmpp; ++i) pmat[i]=0;
-  for(i = 0; i< Ntmpq; ++i) qmat[i]=0;
-
-  dcopy_(&Ntmpp, pmat, &inc, rmat, &inc);
-  dcopy_(&Ntmpq, qmat, &inc, smat, &inc);
-
-  /* iteration */
-
-  for(iter = 0; iter < ITER; ++iter){
-
-    tnew = (1+sqrt(1+4*t*t))/2;
-
-    /* P_positive(b-lambda_tv*L_pq(r,s)) */
-   
-    Lpq(NX, NY, rmat, smat, xvec);
-    dscal_(N, &alpha1, xvec, &inc);
-    daxpy_(N, &alpha2, bvec, &inc, xvec, &inc);
-    P_positive_box(*N, xvec, box_flag, cl_box);
-
-    /*  [tmpr,tmps] = Lx(tmp,N); */
-    Lx(NX, NY, xvec, npmat, nqmat);
-
-    /*[pnew,qnew] = P_pqiso((r+tmpr/(8*lambda)),(s+tmps/(8*lambda)),N);*/
-
-    daxpy_(&Ntmpp, &alpha3, npmat, &inc, rmat, &inc);
-    daxpy_(&Ntmpq, &alpha3, nqmat, &inc, smat, &inc);
-
-    P_pqiso(NX, NY, rmat, smat, npmat, nqmat);
-
-    dcopy_(&Ntmpp, npmat, &inc, rmat, &inc);
-    dcopy_(&Ntmpq, nqmat, &inc, smat, &inc);
-
-    beta = 1+(t-1)/tnew;
-    dscal_(&Ntmpp, &beta, rmat, &inc);
-    dscal_(&Ntmpq, &beta, smat, &inc);
-
-    beta = -(t-1)/tnew;
-    daxpy_(&Ntmpp, &beta, pmat, &inc, rmat, &inc);
-    daxpy_(&Ntmpq, &beta, qmat, &inc, smat, &inc);
-
-    /* update */
-    t = tnew;
-    dcopy_(&Ntmpp, npmat, &inc, pmat, &inc);
-    dcopy_(&Ntmpq, nqmat, &inc, qmat, &inc);
-  }
-
-  /* P_positive(b-lambda_tv*L_pq(p,q)) */
-
-  Lpq(NX, NY, pmat, qmat, xvec);
-  dscal_(N, &alpha1, xvec, &inc);
-  daxpy_(N, &alpha2, bvec, &inc, xvec, &inc);
-  P_positive_box(*N, xvec, box_flag, cl_box);
-
+  FGP_core(NX, NY, FGP_PROJ_NONNEG, bvec, 0, lambda_tv, ITER,
+	   pmat, qmat, rmat, smat, npmat, nqmat, xvec, box_flag, cl_box);
 }
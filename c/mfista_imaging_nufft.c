@@ -77,6 +77,7 @@ int main(int argc, char *argv[]){
   struct IO_FNAMES mfista_io;
   struct RESULT    mfista_result;
   FILE *nufftw_fp, *log_fid;
+  long offset;
 
   /* check the number of variables first. */
 
@@ -159,16 +160,14 @@ int main(int argc, char *argv[]){
   vis_i    = alloc_vector(M);
   vis_std  = alloc_vector(M);
   
-  for(i = 0;i<M;++i){
-    if(fscanf(nufftw_fp, "%le, %le, %le, %le, %le\n",
-	      u_dx+i,v_dy+i,vis_r+i,vis_i+i,vis_std+i)!=5){
-      printf("cannot read data.\n");
-      exit(0);
-    }
-  }
-
+  offset = ftell(nufftw_fp);
   fclose(nufftw_fp);
 
+  if(read_nufft_rows(nufftw_fname, offset, M, u_dx, v_dy, vis_r, vis_i, vis_std) != M){
+    printf("cannot read data.\n");
+    exit(0);
+  }
+
   /* initialize xvec */
 
   NN = NX*NY;
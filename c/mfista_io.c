@@ -1,4 +1,12 @@
 #include "mfista.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef PTHREAD
+#include <pthread.h>
+#endif
 
 /* file i_o*/
 
@@ -108,6 +116,170 @@ int write_X_vector(char *fname, int length, double *vector)
   return(n);
 }
 
+/* rows "u, v, vis_r, vis_i, noise_std_dev" of nufft_data
+
+   The file is mapped from offset (the end of the header) and split at
+   newlines into one chunk per thread of at least ROWS_BYTES_PER_THREAD
+   bytes. Every chunk counts its lines to know its first row and then
+   parses them with strtod into the columns. Only the first M lines are
+   read. Returns the number of rows read, which is M unless a line
+   cannot be read. */
+
+#define ROWS_BYTES_PER_THREAD (1 << 22)
+#define ROWS_LINEMAX 1024
+
+struct ROWS_CHUNK{
+  const char *start;
+  const char *end;
+  int first;
+  int M;
+  int fail;
+  double *col[5];
+};
+
+static void *count_chunk(void *arg)
+{
+  struct ROWS_CHUNK *c = (struct ROWS_CHUNK*) arg;
+  const char *p = c->start;
+  int n = 0;
+
+  while(p < c->end && (p = memchr(p, '\n', c->end - p)) != NULL){
+    ++n;
+    ++p;
+  }
+
+  c->first = n;
+  return(NULL);
+}
+
+static void *parse_chunk(void *arg)
+{
+  struct ROWS_CHUNK *c = (struct ROWS_CHUNK*) arg;
+  const char *p, *eol;
+  char line[ROWS_LINEMAX], *q, *r;
+  int k, row = c->first;
+
+  for(p = c->start; p < c->end && row < c->M; p = eol + 1, ++row){
+    eol = memchr(p, '\n', c->end - p);
+    if(eol == NULL) eol = c->end;
+
+    if(eol - p >= ROWS_LINEMAX){
+      c->fail = 1;
+      return(NULL);
+    }
+
+    memcpy(line, p, eol - p);
+    line[eol - p] = '\0';
+
+    for(q = line, k = 0; k < 5; ++k){
+      while(*q == ' ' || *q == ',' || *q == '\t') ++q;
+      c->col[k][row] = strtod(q, &r);
+      if(r == q){
+	c->fail = 1;
+	return(NULL);
+      }
+      q = r;
+    }
+  }
+
+  return(NULL);
+}
+
+int read_nufft_rows(char *fname, long offset, int M,
+		    double *u_dx, double *v_dy,
+		    double *vis_r, double *vis_i, double *vis_std)
+{
+  int i, k, fd, nthread = 1, n_line;
+  size_t len;
+  struct stat st;
+  const char *map, *body;
+  struct ROWS_CHUNK *chunk;
+#ifdef PTHREAD
+  pthread_t *threads;
+#endif
+
+  fd = open(fname, O_RDONLY);
+  if(fd < 0 || fstat(fd, &st) != 0 || st.st_size < offset){
+    fprintf(stderr," --- Can't open %s\n",fname);
+    exit(1);
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(map == MAP_FAILED){
+    fprintf(stderr," --- Can't mmap %s\n",fname);
+    exit(1);
+  }
+
+  body = map + offset;
+  len  = st.st_size - offset;
+
+#ifdef PTHREAD
+  nthread = len/ROWS_BYTES_PER_THREAD;
+
+  if(nthread > THREAD_NUM) nthread = THREAD_NUM;
+  if(nthread < 1)          nthread = 1;
+#endif
+
+  chunk = (struct ROWS_CHUNK*) malloc(nthread*sizeof(struct ROWS_CHUNK));
+
+  for(i = 0; i < nthread; ++i){
+    chunk[i].start = body + (len*i)/nthread;
+    if(i > 0){
+      if(chunk[i].start < chunk[i-1].start) chunk[i].start = chunk[i-1].start;
+      while(chunk[i].start < body + len && chunk[i].start[-1] != '\n') ++chunk[i].start;
+      chunk[i-1].end = chunk[i].start;
+    }
+    chunk[i].M      = M;
+    chunk[i].fail   = 0;
+    chunk[i].col[0] = u_dx;
+    chunk[i].col[1] = v_dy;
+    chunk[i].col[2] = vis_r;
+    chunk[i].col[3] = vis_i;
+    chunk[i].col[4] = vis_std;
+  }
+  chunk[nthread-1].end = body + len;
+
+#ifdef PTHREAD
+  threads = (pthread_t*) malloc(nthread*sizeof(pthread_t));
+
+  for(i = 1; i < nthread; ++i) pthread_create(threads+i, NULL, count_chunk, chunk+i);
+  count_chunk(chunk);
+  for(i = 1; i < nthread; ++i) pthread_join(threads[i], NULL);
+#else
+  for(i = 0; i < nthread; ++i) count_chunk(chunk+i);
+#endif
+
+  /* first row of each chunk; the last line may have no newline */
+
+  for(n_line = 0, i = 0; i < nthread; ++i){
+    k = chunk[i].first;
+    chunk[i].first = n_line;
+    n_line += k;
+  }
+
+  if(len > 0 && body[len-1] != '\n') ++n_line;
+
+#ifdef PTHREAD
+  for(i = 1; i < nthread; ++i) pthread_create(threads+i, NULL, parse_chunk, chunk+i);
+  parse_chunk(chunk);
+  for(i = 1; i < nthread; ++i) pthread_join(threads[i], NULL);
+
+  free(threads);
+#else
+  for(i = 0; i < nthread; ++i) parse_chunk(chunk+i);
+#endif
+
+  munmap((void*)map, st.st_size);
+
+  for(i = 0; i < nthread; ++i) if(chunk[i].fail) n_line = -1;
+
+  free(chunk);
+
+  return((n_line < M) ? n_line : M);
+}
+
 /* matrix operation*/
 
 void transpose_matrix(double *matrix, int origheight, int origwidth)
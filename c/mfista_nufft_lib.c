@@ -79,7 +79,7 @@ void preNUFFT(double *E1, double *E2x, double *E2y, double *E3x, double *E3y,
     tmpx = taux*tmpi*tmpi;
 
     for(j = 0; j< Ny; ++j){
-      tmpj = (double)(j-Nx/2);
+      tmpj = (double)(j-Ny/2);
       tmpy = tauy*tmpj*tmpj;
       E4mat[Ny*i + j] = coeff*exp(tmpx + tmpy);
     }